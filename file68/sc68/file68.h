@@ -57,6 +57,7 @@
 
 enum {
   SC68_DISK_ID   = (('d' << 24) | ('i' << 16) | ('s' << 8) | 'k'),
+  SC68_PROBE_ID  = (('p' << 24) | ('r' << 16) | ('o' << 8) | 'b'),
   SC68_LOADADDR  = SC68_DEFADDR, /**< Default load address in 68K memory. */
   SC68_MAX_TRACK = 63,           /**< Maximum track per disk. */
 };
@@ -150,8 +151,11 @@ typedef struct {
   unsigned int force_ms;    /**< Forced time in ms.                      */
 
   music68_t    mus[SC68_MAX_TRACK]; /**< Information for each music.     */
+  void        *mapaddr;     /**< mapped file data (0:not mapped).        */
+  int          mapsz;       /**< mapped file data size in byte.          */
   unsigned int datasz;      /**< data size in byte.                      */
   char        *data;        /**< points to data.                         */
+  volatile int nref;        /**< reference count (see file68_retain()).  */
   char         buffer[4];   /**< raw data. MUST be last member.          */
 } disk68_t;
 
@@ -335,6 +339,44 @@ FILE68_API
  */
 disk68_t * file68_load_mem(const void * buffer, int len);
 
+FILE68_API
+/**
+ * Probe SC68 file meta data from stream.
+ *
+ *  The file68_probe() function loads only what is needed to get the
+ *  disk and tracks information (tags, durations, hardware flags...)
+ *  but not the music data. SC68 music data chunks are skipped and
+ *  for sndh files only the header is read. Compressed streams are
+ *  inflated as far as needed and no further.
+ *
+ *  The returned disk has the SC68_PROBE_ID magic. It can be used
+ *  with the meta tag functions and must be freed with file68_free()
+ *  but it can not be played nor saved. Tracks datasz are the actual music data
+ *  size but their data pointer must not be used. The hash is only
+ *  computed when it is required to search the sndh time database.
+ *
+ * @param   is   input stream
+ *
+ * @return  pointer to allocated disk68_t disk structure
+ * @retval  0  failure
+ *
+ * @see file68_load()
+ */
+disk68_t * file68_probe(vfs68_t * is);
+
+FILE68_API
+/**
+ * Probe SC68 file meta data.
+ *
+ * @param  uri      URI to probe.
+ *
+ * @return  pointer to allocated disk68_t disk structure
+ * @retval  0  failure
+ *
+ * @see file68_probe()
+ */
+disk68_t * file68_probe_uri(const char * uri);
+
 /**
  * @}
  */
@@ -414,12 +456,29 @@ disk68_t * file68_new(int extra);
 
 FILE68_API
 /**
- * Destroy loaded or allocated disk.
+ * Add a reference to a disk.
+ *
+ *   Disks are created with a single reference. Each file68_retain()
+ *   must be balanced by a file68_free(). A disk shared this way must
+ *   be considered read-only by all its owners. Both functions are
+ *   thread safe.
+ *
+ * @param  disk  disk to retain (may be 0).
+ *
+ * @return  disk
+ * @see file68_free()
+ */
+const disk68_t * file68_retain(const disk68_t * disk);
+
+FILE68_API
+/**
+ * Release a reference to a disk and destroy it with the last one.
  *
  * @param  disk  disk to free.
  *
  * @see file68_new()
  * @see file68_load()
+ * @see file68_retain()
  */
 void file68_free(const disk68_t * disk);
 
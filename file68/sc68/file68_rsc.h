@@ -234,6 +234,50 @@ FILE68_API
  */
 vfs68_t * rsc68_create_uri(const char *uri, int mode, rsc68_info_t * info);
 
+FILE68_API
+/**
+ * Get an external replay image.
+ *
+ *   The rsc68_get_replay() function gets the decompressed image of
+ *   an external replay. Images are loaded through rsc68_open() on
+ *   first request and kept in a process-wide cache until
+ *   rsc68_shutdown(). Built-in replays are inflated only once.
+ *
+ *   The returned data are shared by all callers and threads and must
+ *   be considered read-only.
+ *
+ * @param  name  Replay name (as in sc68://replay/name).
+ * @param  data  Get pointer to replay image (0 to ignore).
+ * @param  size  Get replay image size in bytes (0 to ignore).
+ *
+ * @return error-code
+ * @retval  0 success
+ * @retval -1 failure
+ */
+int rsc68_get_replay(const char * name, const void ** data, int * size);
+
+FILE68_API
+/**
+ * Inflate all built-in replays into a shared read-only arena.
+ *
+ *   The rsc68_replay_arena() function inflates every built-in replay
+ *   once into a single contiguous block indexed by a perfect hash of
+ *   the replay names. Afterward built-in replays cost no inflate nor
+ *   allocation. It is meant to be called once after rsc68_init()
+ *   (see the --sc68-replay-arena option) before any other thread
+ *   accesses replays; the arena lives until rsc68_shutdown().
+ *
+ *   If cache is given the arena is mapped from this file if it is a
+ *   valid one for this build, else it is built and saved there.
+ *
+ * @param  cache  Arena cache file path (0 or "" for none).
+ *
+ * @return error-code
+ * @retval  0 success
+ * @retval -1 failure (replays are still inflated on demand)
+ */
+int rsc68_replay_arena(const char * cache);
+
 
 FILE68_API
 /**
@@ -0,0 +1,75 @@
+/**
+ * @ingroup  lib_file68
+ * @file     sc68/file68_vfs_mmap.h
+ * @author   Benjamin Gerard
+ * @date     2016-09-12
+ * @brief    Memory mapped file stream header.
+ */
+
+/* Copyright (c) 1998-2016 Benjamin Gerard */
+
+#ifndef FILE68_VFS_MMAP_H
+#define FILE68_VFS_MMAP_H
+
+#include "file68_vfs.h"
+
+/**
+ * @name     Memory mapped file stream
+ * @ingroup  lib_file68_vfs
+ *
+ *   Implements a read-only vfs68_t for memory mapped local files.
+ *
+ *   The whole file is mapped privately at open time. Pages modified
+ *   through the mapping are copied and never written back to the
+ *   file.
+ *
+ * @note   mmap vfs scheme is "mmap://".
+ *
+ * @{
+ */
+
+FILE68_EXTERN
+/**
+ * Init memory mapped file VFS (register mmap: scheme).
+ *
+ * @retval  0  always success
+ */
+int vfs68_mmap_init(void);
+
+FILE68_EXTERN
+/**
+ * Shutdown memory mapped file VFS (unregister mmap: scheme).
+ */
+void vfs68_mmap_shutdown(void);
+
+FILE68_EXTERN
+/**
+ * Take ownership of the mapped data of an opened mmap stream.
+ *
+ *   The vfs68_mmap_detach() function transfers the mapping to the
+ *   caller. Afterward the stream position and length are still
+ *   available but reading fails. The mapping must be released with
+ *   vfs68_mmap_free().
+ *
+ * @param  vfs   stream
+ * @param  size  Get mapped data size (0 to ignore).
+ *
+ * @return mapped data address
+ * @retval 0 not an opened mmap stream (or empty file)
+ */
+void * vfs68_mmap_detach(vfs68_t * vfs, int * size);
+
+FILE68_EXTERN
+/**
+ * Release a mapping detached by vfs68_mmap_detach().
+ *
+ * @param  addr  mapped data address
+ * @param  size  mapped data size
+ */
+void vfs68_mmap_free(void * addr, int size);
+
+/**
+ * @}
+ */
+
+#endif
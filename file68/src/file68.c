@@ -38,6 +38,7 @@
 #include "file68_vfs_def.h"
 #include "file68_vfs.h"
 #include "file68_vfs_z.h"
+#include "file68_vfs_mmap.h"
 #include "file68_ice.h"
 #include "file68_zip.h"
 #include "file68_uri.h"
@@ -64,6 +65,8 @@
 #include <stdio.h>
 #include <assert.h>
 
+void * file68_ice_load_tmp(vfs68_t *, int *); /* defined in ice68.c */
+
 #define FOURCC(A,B,C,D) ((int)( ((A)<<24) | ((B)<<16) | ((C)<<8) | (D) ))
 #define gzip_cc FOURCC('g','z','i','p')
 #define ice_cc  FOURCC('i','c','e','!')
@@ -153,14 +156,19 @@ static int is_year(const char * const s) {
   return year;
 }
 
-/* valid disk ? */
+/* valid loaded disk (with music data) ? */
 static inline int is_disk(const disk68_t * const mb) {
   return mb && mb->magic == SC68_DISK_ID;
 }
 
+/* loaded or probed disk (only usable for information) ? */
+static inline int is_info_disk(const disk68_t * const mb) {
+  return mb && (mb->magic == SC68_DISK_ID || mb->magic == SC68_PROBE_ID);
+}
+
 /* null or valid disk ? */
 static inline int null_or_disk(const disk68_t * const mb) {
-  return !mb || mb->magic == SC68_DISK_ID;
+  return !mb || is_disk(mb);
 }
 
 /* Track value in range ? */
@@ -177,7 +185,7 @@ static inline int in_disk(const disk68_t * mb, const int track) {
 static inline int is_disk_data(const disk68_t * const mb, const void * const _s)
 {
   const char * const s = (const char *) _s;
-  return is_disk(mb) && s >= mb->data && s < mb->data+mb->datasz;
+  return is_info_disk(mb) && s >= mb->data && s < mb->data+mb->datasz;
 }
 
 /* Does this memory belongs to the static string array ? */
@@ -373,6 +381,32 @@ static int sndh_decode(const char * buf, int org, int off)
   return -1;
 }
 
+/* Decode the 3 entry points at the beginning of sndh files. The
+ * lowest one is where the header ends.
+ * @return  boot->data
+ * @retval -1 on error
+ */
+static int sndh_get_boot(const char * buffer, int max,
+                         struct sndh_boot * boot)
+{
+  boot->init = boot->kill = boot->play = -1;
+  boot->data = 0x8000;
+
+  if (max < 12
+      || (boot->init = sndh_decode(buffer,0,0)) < 0
+      || (boot->kill = sndh_decode(buffer,4,4)) < 0
+      || (boot->play = sndh_decode(buffer,8,8)) < 0)
+    return -1;
+
+  if (boot->init >= 16 && boot->init < boot->data)
+    boot->data = boot->init;
+  if (boot->kill >= 16 && boot->kill < boot->data)
+    boot->data = boot->kill;
+  if (boot->play >= 16 && boot->play < boot->data)
+    boot->data = boot->play;
+  return boot->data;
+}
+
 /* @retval 0   on error
  * @retval 12  nornal 'SNDH' tag position.
  */
@@ -382,20 +416,7 @@ static int sndh_is_magic(const char *buffer, int max, struct sndh_boot * sb)
   const int start = 10;
   int i=0, v = 0;
 
-  boot->init = boot->kill = boot->play = -1;
-  boot->data = 0x8000;
-
-  if (max >= 12
-      && (boot->init = sndh_decode(buffer,0,0)) >= 0
-      && (boot->kill = sndh_decode(buffer,4,4)) >= 0
-      && (boot->play = sndh_decode(buffer,8,8)) >= 0 ) {
-
-    if (boot->init >= 16 && boot->init < boot->data)
-      boot->data = boot->init;
-    if (boot->kill >= 16 && boot->kill < boot->data)
-      boot->data = boot->kill;
-    if (boot->play >= 16 && boot->play < boot->data)
-      boot->data = boot->play;
+  if (sndh_get_boot(buffer, max, boot) >= 0) {
     if (boot->data == 0x1000)
       return 0;
     max = boot->data;
@@ -412,20 +433,25 @@ static int sndh_is_magic(const char *buffer, int max, struct sndh_boot * sb)
 }
 
 static
-int isread(vfs68_t * const is, void * data, int len, unsigned int * hptr)
+void ishash(const void * data, int len, unsigned int * hptr)
 {
-  int read = vfs68_read(is, data, len);
-  if (read > 0 && hptr) {
+  if (len > 0 && hptr) {
     uint32_t h = *hptr;
-    int n = read;
-    uint8_t * k = (uint8_t *) data;
+    const uint8_t * k = (const uint8_t *) data;
     do {
       h += *k++;
       h += h << 10;
       h ^= h >> 6;
-    } while (--n);
+    } while (--len);
     *hptr = h;
   }
+}
+
+static
+int isread(vfs68_t * const is, void * data, int len, unsigned int * hptr)
+{
+  int read = vfs68_read(is, data, len);
+  ishash(data, read, hptr);
   return read;
 }
 
@@ -838,7 +864,8 @@ static vfs68_t * uri_or_file_create(const char * uri, int mode,
   return vfs;
 }
 
-disk68_t * file68_load_uri(const char * fname)
+static disk68_t * load_uri(const char * fname,
+                           disk68_t * (*load)(vfs68_t *))
 {
   disk68_t    * d;
   vfs68_t * is;
@@ -847,7 +874,7 @@ disk68_t * file68_load_uri(const char * fname)
   TRACE68(file68_cat,"file68: load -- %s\n", strnull(fname));
 
   is = uri_or_file_create(fname, 1, &info);
-  d = file68_load(is);
+  d = load(is);
   vfs68_destroy(is);
 
   if (d && info.type == rsc68_music) {
@@ -867,6 +894,16 @@ disk68_t * file68_load_uri(const char * fname)
   return d;
 }
 
+disk68_t * file68_load_uri(const char * fname)
+{
+  return load_uri(fname, file68_load);
+}
+
+disk68_t * file68_probe_uri(const char * fname)
+{
+  return load_uri(fname, file68_probe);
+}
+
 disk68_t * file68_load_mem(const void * buffer, int len)
 {
   disk68_t * d;
@@ -1330,7 +1367,7 @@ static const char * get_tag(const disk68_t * mb, int track, const char * key)
   const char * val = 0;
   const tagset68_t * tags;
 
-  assert(is_disk(mb));
+  assert(is_info_disk(mb));
   assert(!track || in_range(mb,track));
   assert(key);
 
@@ -1352,7 +1389,7 @@ static const char * get_tag(const disk68_t * mb, int track, const char * key)
 
 const char * file68_tag_get(const disk68_t * mb, int track, const char * key)
 {
-  return (key && is_disk(mb) && (!track || in_range(mb,track)))
+  return (key && is_info_disk(mb) && (!track || in_range(mb,track)))
     ? get_tag(mb, track, key)
     : 0
     ;
@@ -1362,7 +1399,7 @@ char * file68_tag(const disk68_t * mb, int track, const char * key)
 {
   const char * val = 0;
 
-  if (key && is_disk(mb) && (!track || in_range(mb,track))) {
+  if (key && is_info_disk(mb) && (!track || in_range(mb,track))) {
     val = get_tag(mb, track, key);
     if (!val) {
       /* $$$ TODO */
@@ -1405,11 +1442,20 @@ static void free_tags(disk68_t * mb, tagset68_t *tags)
   }
 }
 
+const disk68_t * file68_retain(const disk68_t * const_disk)
+{
+  disk68_t * disk = (disk68_t *)const_disk;
+
+  if (is_info_disk(disk))
+    ADD68(&disk->nref, 1);
+  return const_disk;
+}
+
 void file68_free(const disk68_t * const_disk)
 {
   disk68_t * disk = (disk68_t *)const_disk;
 
-  if (is_disk(disk)) {
+  if (is_info_disk(disk) && ADD68(&disk->nref, -1) <= 0) {
     const int max = disk->nb_mus;
     int i;
 
@@ -1432,7 +1478,11 @@ void file68_free(const disk68_t * const_disk)
         disk->mus[i].datasz = 0;
       }
     }
-    if (disk->data != disk->buffer) {
+    if (disk->mapaddr) {
+      vfs68_mmap_free(disk->mapaddr, disk->mapsz);
+      disk->mapaddr = 0;
+      disk->data = 0;
+    } else if (disk->data != disk->buffer) {
       free(disk->data);
       disk->data = 0;
     }
@@ -1451,6 +1501,7 @@ static disk68_t * alloc_disk(int datasz)
 
     /* Set a little bit of magic */
     mb->magic = SC68_DISK_ID;
+    mb->nref  = 1;
 
     /* data points into buffer */
     mb->data = mb->buffer;
@@ -1469,6 +1520,88 @@ static disk68_t * alloc_disk(int datasz)
   return mb;
 }
 
+/* Allocate a disk referencing the len bytes at the current position
+ * of a mmap stream instead of reading them.
+ *
+ * @retval 0 not a mmap stream (or any other failure), the stream is
+ *           left untouched so that the caller can fallback to a
+ *           regular read.
+ */
+static disk68_t * map_disk(vfs68_t * is, int len, unsigned int * hptr)
+{
+  disk68_t * mb;
+  char * addr;
+  int pos, size;
+
+  pos = vfs68_tell(is);
+  if (pos < 0 || len <= 0 || len > vfs68_length(is) - pos)
+    return 0;
+  if (mb = alloc_disk(0), !mb)
+    return 0;
+  addr = vfs68_mmap_detach(is, &size);
+  if (!addr) {
+    free(mb);
+    return 0;
+  }
+  mb->mapaddr = addr;
+  mb->mapsz   = size;
+  mb->data    = addr + pos;
+  mb->datasz  = len;
+  ishash(mb->data, len, hptr);
+  TRACE68(file68_cat,"file68: zero-copy -- %d bytes at +%d\n", len, pos);
+
+  return mb;
+}
+
+/* Scratch arena for temporary decompression buffers.
+ *
+ * The last released block is kept for the next load instead of being
+ * freed. It is taken and given back with an atomic swap so that a
+ * concurrent load simply allocates its own block.
+ */
+typedef struct {
+  int size;                             /* usable size */
+  int pad;
+} arena_t;
+static arena_t * volatile arena;
+
+void * file68_arena_alloc(int size)
+{
+  arena_t * a;
+
+  do {
+    a = arena;
+  } while (a && !CAS68(&arena, a, 0));
+
+  if (a && a->size < size) {
+    free(a);
+    a = 0;
+  }
+  if (!a && (a = malloc(sizeof(*a) + size), a))
+    a->size = size;
+
+  return a ? a + 1 : 0;
+}
+
+void file68_arena_free(void * addr)
+{
+  if (addr) {
+    arena_t * a = (arena_t *) addr - 1;
+    if (!CAS68(&arena, 0, a))
+      free(a);
+  }
+}
+
+static void arena_flush(void)
+{
+  arena_t * a;
+
+  do {
+    a = arena;
+  } while (a && !CAS68(&arena, a, 0));
+  free(a);
+}
+
 disk68_t * file68_new(int extra)
 {
   disk68_t * d = 0;
@@ -1480,105 +1613,26 @@ disk68_t * file68_new(int extra)
 }
 
 
-/* Load , allocate memory and valid struct for SC68 music
+/* Parse sc68 chunks.
+ *
+ * @param  mb   disk to fill (data must be loaded)
+ * @param  b    first chunk (after the base chunk)
+ * @param  len  bytes to parse
+ * @param  chk  buffer to store the faulty chunk name
+ *
+ * @return error string
+ * @retval 0 on success
  */
-disk68_t * file68_load(vfs68_t * is)
+static const char * parse_chunks(disk68_t * mb, char * b, int len,
+                                 char chk[8])
 {
-  disk68_t *mb = 0;
-  int len;
-  unsigned int hash = 0, *h = &hash;
   int chk_size;
-  int opened = 0;
   music68_t *cursix;
   tagset68_t * tags;
-  char *b;
-  const char *fname = vfs68_filename(is);
-  const char *errorstr = 0;
-
-  fname = strnevernull68(fname);
 
-  /* Read header and get data length. */
-  if (len = read_header(is, h), len < 0) {
-    /* Verify tells it is a gzip or unice file, so we may give it a try.
-     */
-    if (1) {
-      void * buffer = 0;
-      int l;
-      switch (len) {
-      case -gzip_cc:
-        /* gzipped */
-        if (vfs68_seek_to(is,0) == 0) {
-          vfs68_t * zis;
-          zis=vfs68_z_create(is,VFS68_OPEN_READ,
-                                 vfs68_z_default_option);
-          if (!vfs68_open(zis)) {
-            mb = file68_load(zis);
-          }
-          vfs68_destroy(zis);
-          if (mb) {
-            goto already_valid;
-          }
-        }
-        break;
-
-      case -ice_cc:
-        if (vfs68_seek_to(is,0) == 0) {
-          buffer = file68_ice_load(is, &l);
-        }
-        break;
-
-      case -sndh_cc:
-        if (vfs68_seek_to(is,0) != 0) {
-          break;
-        }
-        len = vfs68_length(is);
-        if (len <= 32 || len > 1<<21) {
-          break;
-        }
-        mb = alloc_disk(len);
-        if (!mb) {
-          errorstr = "memory allocation";
-          break;
-        }
-        mb->tags.tag.genre.val = tagstr.sndh;
-        if (isread(is, mb->data, len, h) != len) {
-          break;
-        }
-        if (sndh_info(mb, len)) {
-          break;
-        }
-        goto validate;
-      }
-
-      if (buffer) {
-        mb = file68_load_mem(buffer, l);
-        free(buffer);
-        if (mb) {
-          return mb;
-        }
-      }
-    }
-    if (!errorstr)
-      errorstr = "read header";
-    goto error;
-  }
-
-  mb = alloc_disk(len);
-  if (!mb) {
-    errorstr = "memory allocation";
-    goto error;
-  }
-  mb->tags.tag.genre.val = tagstr.sc68;
-
-  if (isread(is, mb->data, len, h) != len) {
-    errorstr = "read data";
-    goto error;
-  }
-
-  for (b = mb->data, cursix = 0, tags = &mb->tags;
+  for (cursix = 0, tags = &mb->tags;
        len >= 8;
        b += chk_size, len -= chk_size) {
-    char chk[8];
     if (b[0] != 'S' || b[1] != 'C') {
       break;
     }
@@ -1626,24 +1680,21 @@ disk68_t * file68_load(vfs68_t * is)
     /* External replay */
     else if (ISCHK(chk, CH68_REPLAY)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->replay = b;
     }
     /* 68000 D0 init value */
     else if (ISCHK(chk, CH68_D0)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->d0 = LPeek(b);
     }
     /* 68000 memory load address */
     else if (ISCHK(chk, CH68_AT)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->a0 = LPeek(b);
     }
@@ -1651,8 +1702,7 @@ disk68_t * file68_load(vfs68_t * is)
     else if (ISCHK(chk, CH68_TIME)) {
       int sec;
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       sec = LPeek(b);
       /* sanity check */
@@ -1663,8 +1713,7 @@ disk68_t * file68_load(vfs68_t * is)
     /* Playing time (frames) */
     else if (ISCHK(chk, CH68_FRAME)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->first_fr = LPeek(b);
       /* $$$ Workaround some buggy musics  */
@@ -1674,16 +1723,14 @@ disk68_t * file68_load(vfs68_t * is)
     /* Replay frequency */
     else if (ISCHK(chk, CH68_FRQ)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->frq = LPeek(b);
     }
     /* Loop */
     else if (ISCHK(chk, CH68_LOOP)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->loops = LPeek(b);
       /* force sanity */
@@ -1693,8 +1740,7 @@ disk68_t * file68_load(vfs68_t * is)
     /* Loop length */
     else if (ISCHK(chk, CH68_LOOPFR)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->loops_fr = LPeek(b);
       cursix->has.loop = 1;
@@ -1702,8 +1748,7 @@ disk68_t * file68_load(vfs68_t * is)
     /* SFX flag */
     else if (ISCHK(chk, CH68_SFX)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->has.sfx = 1;
     }
@@ -1711,8 +1756,7 @@ disk68_t * file68_load(vfs68_t * is)
     else if (ISCHK(chk, CH68_TYP)) {
       int f;
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       f = LPeek(b);
 
@@ -1735,8 +1779,7 @@ disk68_t * file68_load(vfs68_t * is)
     /* music data */
     else if (ISCHK(chk, CH68_MDATA)) {
       if (!cursix) {
-        errorstr = chk;
-        goto error;
+        return chk;
       }
       cursix->data = b;
       cursix->datasz = chk_size;
@@ -1749,11 +1792,109 @@ disk68_t * file68_load(vfs68_t * is)
   }
 
   /* Check it */
-  if (len) {
-    errorstr = "prematured end of file";
+  return len ? "prematured end of file" : 0;
+}
+
+/* Load , allocate memory and valid struct for SC68 music
+ */
+disk68_t * file68_load(vfs68_t * is)
+{
+  disk68_t *mb = 0;
+  int len;
+  unsigned int hash = 0, *h = &hash;
+  int opened = 0;
+  char chk[8];
+  const char *fname = vfs68_filename(is);
+  const char *errorstr = 0;
+
+  fname = strnevernull68(fname);
+
+  /* Read header and get data length. */
+  if (len = read_header(is, h), len < 0) {
+    /* Verify tells it is a gzip or unice file, so we may give it a try.
+     */
+    if (1) {
+      void * buffer = 0;
+      int l;
+      switch (len) {
+      case -gzip_cc:
+        /* gzipped */
+        if (vfs68_seek_to(is,0) == 0) {
+          vfs68_t * zis;
+          zis=vfs68_z_create(is,VFS68_OPEN_READ,
+                                 vfs68_z_default_option);
+          if (!vfs68_open(zis)) {
+            mb = file68_load(zis);
+          }
+          vfs68_destroy(zis);
+          if (mb) {
+            goto already_valid;
+          }
+        }
+        break;
+
+      case -ice_cc:
+        if (vfs68_seek_to(is,0) == 0) {
+          buffer = file68_ice_load_tmp(is, &l);
+        }
+        break;
+
+      case -sndh_cc:
+        if (vfs68_seek_to(is,0) != 0) {
+          break;
+        }
+        len = vfs68_length(is);
+        if (len <= 32 || len > 1<<21) {
+          break;
+        }
+        mb = map_disk(is, len, h);
+        if (!mb) {
+          mb = alloc_disk(len);
+          if (!mb) {
+            errorstr = "memory allocation";
+            break;
+          }
+          if (isread(is, mb->data, len, h) != len) {
+            break;
+          }
+        }
+        mb->tags.tag.genre.val = tagstr.sndh;
+        if (sndh_info(mb, len)) {
+          break;
+        }
+        goto validate;
+      }
+
+      if (buffer) {
+        mb = file68_load_mem(buffer, l);
+        file68_arena_free(buffer);
+        if (mb) {
+          return mb;
+        }
+      }
+    }
+    if (!errorstr)
+      errorstr = "read header";
     goto error;
   }
 
+  mb = map_disk(is, len, h);
+  if (!mb) {
+    mb = alloc_disk(len);
+    if (!mb) {
+      errorstr = "memory allocation";
+      goto error;
+    }
+    if (isread(is, mb->data, len, h) != len) {
+      errorstr = "read data";
+      goto error;
+    }
+  }
+  mb->tags.tag.genre.val = tagstr.sc68;
+  errorstr = parse_chunks(mb, mb->data, len, chk);
+  if (errorstr)
+    goto error;
+
 validate:
   mb->hash = hash;
   if (valid(mb)) {
@@ -1772,12 +1913,274 @@ error:
   if (opened) {
     vfs68_close(is);
   }
+  if (mb && mb->mapaddr)
+    vfs68_mmap_free(mb->mapaddr, mb->mapsz);
   free(mb);
   msg68_error("file68: load '%s' failed [%s]\n",
               fname, errorstr ? errorstr : "no reason");
   return 0;
 }
 
+/* Skip input data. Compressed streams can not seek so data are read
+ * and dropped.
+ */
+static int isskip(vfs68_t * const is, int len, int noseek,
+                  unsigned int * hptr)
+{
+  char tmp[1024];
+
+  if (!noseek && !hptr)
+    return -(vfs68_seek(is, len) == -1);
+  while (len > 0) {
+    int n = len < (int)sizeof(tmp) ? len : (int)sizeof(tmp);
+    if (isread(is, tmp, n, hptr) != n)
+      return -1;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Grow probe header buffer. */
+static int probe_grow(char ** hdr, int * max, int need)
+{
+  if (need > *max) {
+    int size = (need + need/2 + 1023) & -1024;
+    char * tmp = realloc(*hdr, size);
+    if (!tmp)
+      return -1;
+    *hdr = tmp;
+    *max = size;
+  }
+  return 0;
+}
+
+/* Probe sc68 chunks.
+ *
+ *   All chunks but music data are read into a temporary buffer. Music
+ * data chunks are skipped and their payload replaced by the actual
+ * data size so that parse_chunks() can be used as is.
+ */
+static disk68_t * probe_sc68(vfs68_t * is, int len, int noseek,
+                             char chk[8], const char ** errorstr)
+{
+  disk68_t * mb = 0;
+  char * hdr = 0;
+  int n = 0, max = 0, i;
+
+  while (len >= 8) {
+    char * c;
+    int size, eof;
+
+    if (probe_grow(&hdr, &max, n + 12)) {
+      *errorstr = "memory allocation";
+      goto done;
+    }
+    c = hdr + n;
+    if (vfs68_read(is, c, 8) != 8) {
+      *errorstr = "read chunk";
+      goto done;
+    }
+    n   += 8;
+    len -= 8;
+    if (c[0] != 'S' || c[1] != 'C')
+      break;                     /* let parse_chunks() complain */
+    size = LPeek(c + 4);
+    if (size < 0 || size > len) {
+      *errorstr = "chunk size";
+      goto done;
+    }
+    len -= size;
+    eof = ISCHK(c+2, CH68_EOF);
+
+    if (ISCHK(c+2, CH68_MDATA)) {
+      LPoke(c + 4, 4);
+      LPoke(c + 8, size);
+      n += 4;
+      if (isskip(is, size, noseek, 0)) {
+        *errorstr = "read data";
+        goto done;
+      }
+    } else if (size > 0) {
+      if (probe_grow(&hdr, &max, n + size)) {
+        *errorstr = "memory allocation";
+        goto done;
+      }
+      if (vfs68_read(is, hdr + n, size) != size) {
+        *errorstr = "read chunk";
+        goto done;
+      }
+      n += size;
+    }
+    if (eof)
+      break;
+  }
+
+  if (mb = alloc_disk(n), !mb) {
+    *errorstr = "memory allocation";
+    goto done;
+  }
+  memcpy(mb->data, hdr, n);
+  mb->tags.tag.genre.val = tagstr.sc68;
+  if (*errorstr = parse_chunks(mb, mb->data, n, chk), *errorstr) {
+    free(mb);
+    mb = 0;
+    goto done;
+  }
+  /* Restore music data size (data are not available). */
+  for (i = 0; i < mb->nb_mus; ++i)
+    if (mb->mus[i].data)
+      mb->mus[i].datasz = LPeek(mb->mus[i].data);
+
+done:
+  free(hdr);
+  return mb;
+}
+
+/* Probe sndh header.
+ *
+ *   Only the header (up to the lowest entry point) is read. The rest
+ * of the file is read only if the sndh time database has to be
+ * looked up as it requires the hash of the whole file.
+ */
+static disk68_t * probe_sndh(vfs68_t * is, int len, int noseek,
+                             unsigned int * hptr, const char ** errorstr)
+{
+  disk68_t * mb;
+  struct sndh_boot boot;
+  char id[16];
+  int i, n;
+
+  if (isread(is, id, sizeof(id), hptr) != sizeof(id)
+      || sndh_get_boot(id, sizeof(id), &boot) < 0)
+    return 0;
+
+  n = boot.data + 4;
+  if (n > len)
+    n = len;
+  if (mb = alloc_disk(n), !mb) {
+    *errorstr = "memory allocation";
+    return 0;
+  }
+  memcpy(mb->data, id, sizeof(id));
+  if (isread(is, mb->data + sizeof(id), n - sizeof(id), hptr)
+      != n - (int)sizeof(id)) {
+    *errorstr = "read header";
+    goto error;
+  }
+  mb->tags.tag.genre.val = tagstr.sndh;
+  if (sndh_info(mb, n))
+    goto error;
+
+  /* Same test as in valid() */
+  for (i = 0; i < mb->nb_mus; ++i) {
+    music68_t * m = mb->mus + i;
+    if (!(m->first_fr || m->first_ms) || !(m->hwflags & SC68_XTD))
+      break;
+  }
+  if (i == mb->nb_mus)
+    *hptr = 0;                          /* hash is not required */
+  else if (isskip(is, len - n, noseek, hptr)) {
+    *errorstr = "read data";
+    goto error;
+  }
+  mb->mus[0].datasz = len;
+  return mb;
+
+error:
+  free(mb);
+  return 0;
+}
+
+static disk68_t * probe(vfs68_t * is, int noseek)
+{
+  disk68_t *mb = 0;
+  int len;
+  unsigned int hash = 0, *h = &hash;
+  char chk[8];
+  const char *fname = strnevernull68(vfs68_filename(is));
+  const char *errorstr = 0;
+
+  /* Read header and get data length. */
+  if (len = read_header(is, h), len < 0) {
+    switch (len) {
+    case -gzip_cc:
+      if (vfs68_seek_to(is,0) == 0) {
+        vfs68_t * zis;
+        zis=vfs68_z_create(is,VFS68_OPEN_READ,
+                           vfs68_z_default_option);
+        if (!vfs68_open(zis)) {
+          mb = probe(zis, 1);
+        }
+        vfs68_destroy(zis);
+        if (mb) {
+          return mb;
+        }
+      }
+      break;
+
+    case -ice_cc:
+      /* ICE can only be depacked as a whole. */
+      if (vfs68_seek_to(is,0) == 0) {
+        void * buffer;
+        int l;
+        if (buffer = file68_ice_load_tmp(is, &l), buffer) {
+          vfs68_t * mis = uri68_vfs("mem:", 1, 2, buffer, l);
+          if (!vfs68_open(mis)) {
+            mb = probe(mis, 0);
+          }
+          vfs68_destroy(mis);
+          file68_arena_free(buffer);
+          if (mb) {
+            return mb;
+          }
+        }
+      }
+      break;
+
+    case -sndh_cc:
+      if (vfs68_seek_to(is,0) != 0) {
+        break;
+      }
+      len = vfs68_length(is);
+      if (len <= 32 || len > 1<<21) {
+        break;
+      }
+      if (mb = probe_sndh(is, len, noseek, h, &errorstr), mb) {
+        goto validate;
+      }
+      break;
+    }
+    if (!errorstr)
+      errorstr = "read header";
+    goto error;
+  }
+
+  if (mb = probe_sc68(is, len, noseek, chk, &errorstr), !mb) {
+    goto error;
+  }
+  hash = 0;                             /* not computed */
+
+validate:
+  mb->hash = hash;
+  if (valid(mb)) {
+    errorstr = "validation test";
+    goto error;
+  }
+  mb->magic = SC68_PROBE_ID;
+  return mb;
+
+error:
+  free(mb);
+  msg68_error("file68: probe '%s' failed [%s]\n",
+              fname, errorstr ? errorstr : "no reason");
+  return 0;
+}
+
+disk68_t * file68_probe(vfs68_t * is)
+{
+  return probe(is, 0);
+}
+
 
 
 static int get_version(const int version) {
@@ -2036,7 +2439,9 @@ static const char * save_sc68(vfs68_t * os, const disk68_t * mb,
 
   /* Check disk */
   if (!is_disk(mb)) {
-    errstr = "not a sc68 disk";
+    errstr = is_info_disk(mb)
+      ? "probed disk has no music data"
+      : "not a sc68 disk";
     goto error;
   }
 
@@ -2150,6 +2555,7 @@ int file68_loader_init(void)
 
 void file68_loader_shutdown(void)
 {
+  arena_flush();
   msg68_cat_free(file68_cat);
   file68_cat = msg68_DEFAULT;
 }
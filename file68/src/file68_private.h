@@ -44,3 +44,24 @@
 #  define FILE68_API __declspec(dllexport)
 # endif
 #endif
+
+/* Atomic pointer compare and swap. Returns non zero if *P was O and
+ * has been replaced by N. */
+#if defined(__GNUC__)
+# define CAS68(P,O,N) __sync_bool_compare_and_swap((P),(O),(N))
+#elif defined(_MSC_VER)
+# include <intrin.h>
+# define CAS68(P,O,N) \
+  (_InterlockedCompareExchangePointer((void * volatile *)(P),(N),(O)) == (O))
+#else
+# define CAS68(P,O,N) (*(P) == (O) ? (*(P) = (N), 1) : 0)
+#endif
+
+/* Atomic int addition. Returns the new value of *P. */
+#if defined(__GNUC__)
+# define ADD68(P,N) __sync_add_and_fetch((P),(N))
+#elif defined(_MSC_VER)
+# define ADD68(P,N) (_InterlockedExchangeAdd((long volatile *)(P),(N))+(N))
+#else
+# define ADD68(P,N) (*(P) += (N))
+#endif
@@ -50,8 +50,15 @@ int file68_ice_is_magic(const void * buffer)
 
 #define TERROR(S) do { errstr = S; goto error; } while(0)
 
+void * file68_arena_alloc(int);         /* defined in file68.c */
+void   file68_arena_free(void *);       /* defined in file68.c */
 
-void * file68_ice_load(vfs68_t *is, int *ulen)
+/* Packed data only live during depacking and always go to the
+ * scratch arena. If depacked data are temporary (tmp != 0) both share
+ * a single arena block, packed data after depacked data, which must
+ * be released with file68_arena_free().
+ */
+static void * ice_load(vfs68_t *is, int *ulen, int tmp)
 {
   char header[12], *inbuf = 0, * outbuf = 0;
   int dsize, csize;
@@ -69,7 +76,14 @@ void * file68_ice_load(vfs68_t *is, int *ulen)
   if (dsize < 0)
     TERROR("not ICE! (not magic)");
 
-  if(inbuf = malloc(csize), !inbuf)
+  if (tmp) {
+    /* One arena block for both so that repeated loads reuse it. */
+    if (csize > 0x7FFFFFFF - dsize)
+      TERROR("too large");
+    if (outbuf = file68_arena_alloc(dsize + csize), !outbuf)
+      TERROR("alloc failed");
+    inbuf = outbuf + dsize;
+  } else if (inbuf = file68_arena_alloc(csize), !inbuf)
     TERROR("input alloc failed");
 
   csize -= 12;
@@ -77,7 +91,7 @@ void * file68_ice_load(vfs68_t *is, int *ulen)
   if (vfs68_read(is, inbuf+12, csize) != csize)
     TERROR("read error");
 
-  if (outbuf = malloc(dsize), !outbuf)
+  if (!tmp && (outbuf = malloc(dsize), !outbuf))
     TERROR("output alloc failed");
 
   if (unice68_depacker(outbuf, inbuf))
@@ -87,18 +101,32 @@ void * file68_ice_load(vfs68_t *is, int *ulen)
 
 error:
   error68("ice68: load: %s -- %s", errstr, fname);
-  free(outbuf);
+  if (tmp)
+    file68_arena_free(outbuf);
+  else
+    free(outbuf);
   outbuf = 0;
   dsize = 0;
 
 success:
-  free(inbuf);
+  if (!tmp)
+    file68_arena_free(inbuf);
   if (ulen) {
     *ulen = dsize;
   }
   return outbuf;
 }
 
+void * file68_ice_load(vfs68_t *is, int *ulen)
+{
+  return ice_load(is, ulen, 0);
+}
+
+void * file68_ice_load_tmp(vfs68_t *is, int *ulen)
+{
+  return ice_load(is, ulen, 1);
+}
+
 void * file68_ice_load_file(const char * fname, int * ulen)
 {
   void * ret = 0;
@@ -143,4 +171,9 @@ void * file68_ice_load_file(const char * fname, int * ulen)
   return 0;
 }
 
+void * file68_ice_load_tmp(vfs68_t * is, int * ulen)
+{
+  return file68_ice_load(is, ulen);
+}
+
 #endif /* #ifdef FILE68_UNICE68 */
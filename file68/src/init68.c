@@ -37,6 +37,7 @@
 #include "file68_vfs_fd.h"
 #include "file68_vfs_file.h"
 #include "file68_vfs_mem.h"
+#include "file68_vfs_mmap.h"
 #include "file68_vfs_null.h"
 #include "file68_vfs_z.h"
 #include "file68_rsc.h"
@@ -111,6 +112,8 @@ static option68_t opts[] = {
   OPT68_STRG(prefix,"remote-uri",rsccat,"online music base URI"   ,1,ocp),
   OPT68_BOOL(prefix,"no-debug"  ,dbgcat,"disable all debug output",0,0),
   OPT68_STRG(prefix,"debug"     ,dbgcat,"set debug features"      ,0,ocd),
+  OPT68_STRG(prefix,"replay-arena",rsccat,
+             "inflate all built-in replays at init <yes|cache-file>",0,0),
 };
 
 static int ocp(const option68_t * opt, value68_t * value)
@@ -223,12 +226,25 @@ int file68_init(int argc, char **argv)
   /* File */
   vfs68_file_init();
 
+  /* Memory mapped file */
+  vfs68_mmap_init();
+
   /* Resource locator */
   rsc68_init();
 
   /* Loader */
   file68_loader_init();
 
+  /* Replay arena */
+  opt = option68_get("replay-arena", opt68_ISSET);
+  if (opt && opt->val.str && strcmp68(opt->val.str,"no")) {
+    const char * cache = opt->val.str;
+    if (!strcmp68(cache,"yes") || !strcmp68(cache,"1"))
+      cache = 0;
+    if (rsc68_replay_arena(cache))
+      msg68_warning("file68: unable to create the replay arena\n");
+  }
+
 #ifdef WIN32
   /* Get share path from registry */
   opt = option68_get("share-path", opt68_ALWAYS);
@@ -323,6 +339,9 @@ void file68_shutdown(void)
     /* File */
     vfs68_file_shutdown();
 
+    /* Memory mapped file */
+    vfs68_mmap_shutdown();
+
     init = 0;
   }
 }
@@ -29,16 +29,35 @@
 #include "file68_api.h"
 #include "file68_str.h"
 #include "file68_msg.h"
+#include "file68_zip.h"
 FILE68_API
 int replay68_get(const char * name, const void ** data,
                  int * csize, int * dsize);
+int replay68_arena(const char * cache);
+int replay68_arena_get(const char * name, const void ** data, int * size);
+void replay68_arena_free(void);
+extern int rsc68_cat;                   /* in rsc68.c */
 
 #include "replay.inc.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(ISTREAM68_NO_MMAP) && defined(HAVE_SYS_MMAN_H)
+# define ARENA68_MMAP 1
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+# endif
+# ifdef HAVE_FCNTL_H
+#  include <fcntl.h>
+# endif
+#endif
+
 static int cmp(const void * pa, const void * pb)
 {
   const char
@@ -87,3 +106,395 @@ int replay68_get(const char * name, const void ** data,
                   name);
   return -!r;
 }
+
+/* Replay-ROM arena.
+ *
+ * All built-in replays inflated once in a single contiguous block
+ * that is never written after it has been built. The block is also
+ * the cache file format so that it can be mapped as is:
+ *
+ *   header | entries[count] | disp[count] | slots[nslot] | names | data
+ *
+ * Names are found with a perfect hash (hash and displace): a first
+ * hash selects a bucket whose displacement seeds a second hash that
+ * gives the slot. Slots hold an entry index (or ~0 if empty). The
+ * file is native-endian and its key depends on the built-in table
+ * (names, sizes and compressed bytes) so that a stale or foreign
+ * cache is simply rebuilt.
+ */
+
+typedef unsigned int arena_u32;
+
+typedef struct {
+  char      magic[8];                   /* "sc68rpa"                 */
+  arena_u32 key;                        /* built-in table signature  */
+  arena_u32 size;                       /* whole arena size in bytes */
+  arena_u32 count;                      /* number of replays         */
+  arena_u32 nslot;                      /* hash slots (power of 2)   */
+} arena_hdr_t;
+
+typedef struct {
+  arena_u32 name;                       /* name offset               */
+  arena_u32 data;                       /* data offset               */
+  arena_u32 size;                       /* inflated size             */
+} arena_ent_t;
+
+static const char arena_magic[8] = "sc68rpa";
+
+static struct {
+  const unsigned char * base;           /* arena (0: none)           */
+  const arena_hdr_t   * hdr;
+  const arena_ent_t   * ent;
+  const arena_u32     * disp;
+  int                   mapped;         /* base is a file mapping    */
+} arena;
+
+/* FNV-1a of the lower case name. */
+static arena_u32 arena_hash(const char * name, arena_u32 seed)
+{
+  arena_u32 h = 2166136261u ^ seed;
+  int c;
+  while (c = *name++, c) {
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    h = (h ^ c) * 16777619u;
+  }
+  return h;
+}
+
+/* Signature of the built-in table. The compressed bytes are hashed
+ * so that a rebuilt library with a modified replay of the same size
+ * does not map a stale cache.
+ */
+static arena_u32 arena_key(void)
+{
+  const int max = sizeof(replays)/sizeof(*replays);
+  arena_u32 h = arena_hash("", sizeof(arena_hdr_t) << 8 | sizeof(arena_u32));
+  int i, j;
+  for (i = 0; i < max; ++i) {
+    const unsigned char * data = replays[i].data;
+    h = arena_hash(replays[i].name, h);
+    h = (h ^ replays[i].csize) * 16777619u;
+    h = (h ^ replays[i].dsize) * 16777619u;
+    for (j = 0; j < replays[i].csize; ++j)
+      h = (h ^ data[j]) * 16777619u;
+  }
+  return h;
+}
+
+static int arena_nslot(int count)
+{
+  int n = 1;
+  while (n < count + (count >> 2))
+    n <<= 1;
+  return n;
+}
+
+static void arena_set(const unsigned char * base, int mapped)
+{
+  arena.hdr  = (const arena_hdr_t *) base;
+  arena.ent  = (const arena_ent_t *) (arena.hdr + 1);
+  arena.disp = (const arena_u32 *) (arena.ent + arena.hdr->count);
+  arena.mapped = mapped;
+  arena.base = base;
+}
+
+/* Compute the displacements. Buckets are placed by decreasing size,
+ * each one with the first seed that sends all its names to distinct
+ * free slots.
+ */
+static int arena_phash(arena_u32 * disp, arena_u32 * slot,
+                       int count, int nslot)
+{
+  int * bkt = malloc(sizeof(int) * count * 2), * nxt = bkt + count;
+  int size, b, i, err = -1;
+
+  if (!bkt)
+    return -1;
+  for (b = 0; b < count; ++b)
+    bkt[b] = -1;
+  for (i = 0; i < count; ++i) {
+    b = arena_hash(replays[i].name, 0) % count;
+    nxt[i] = bkt[b];
+    bkt[b] = i;
+  }
+  for (i = 0; i < nslot; ++i)
+    slot[i] = ~0u;
+
+  for (size = count; size > 0; --size)
+    for (b = 0; b < count; ++b) {
+      arena_u32 d;
+      int n = 0;
+
+      for (i = bkt[b]; i >= 0; i = nxt[i])
+        ++n;
+      if (n != size)
+        continue;
+      for (d = 1; d < 1u<<20; ++d) {
+        for (i = bkt[b]; i >= 0; i = nxt[i]) {
+          arena_u32 s = arena_hash(replays[i].name, d) & (nslot-1);
+          if (slot[s] != ~0u)
+            break;
+          slot[s] = i;
+        }
+        if (i < 0)
+          break;
+        /* undo this attempt */
+        for (n = bkt[b]; n != i; n = nxt[n])
+          slot[arena_hash(replays[n].name, d) & (nslot-1)] = ~0u;
+      }
+      if (i >= 0)
+        goto error;
+      disp[b] = d;
+    }
+  err = 0;
+
+error:
+  free(bkt);
+  return err;
+}
+
+/* Lay out the entries. The layout depends only on the built-in table.
+ *
+ * @return arena size in bytes
+ */
+static int arena_layout(arena_ent_t * ent, int count, int nslot)
+{
+  int i, pos;
+
+  pos = sizeof(arena_hdr_t) + sizeof(*ent) * count
+    + sizeof(arena_u32) * (count + nslot);
+  for (i = 0; i < count; ++i) {
+    ent[i].name = pos;
+    pos += strlen(replays[i].name) + 1;
+  }
+  pos = (pos + 15) & -16;
+  for (i = 0; i < count; ++i) {
+    ent[i].data = pos;
+    ent[i].size = replays[i].dsize;
+    pos += (replays[i].dsize + 3) & -4;
+  }
+  return pos;
+}
+
+static const arena_u32 * arena_lookup(const char * name, const arena_u32 * disp,
+                                      int count, int nslot)
+{
+  const arena_u32 * slot = disp + count;
+  arena_u32 h = arena_hash(name, 0) % count;
+  return slot + (arena_hash(name, disp[h]) & (nslot - 1));
+}
+
+/* Build the arena in memory. */
+static unsigned char * arena_build(int * psize)
+{
+  const int count = sizeof(replays)/sizeof(*replays);
+  const int nslot = arena_nslot(count);
+  arena_ent_t tmp[sizeof(replays)/sizeof(*replays)];
+  const int size = arena_layout(tmp, count, nslot);
+  unsigned char * base;
+  arena_hdr_t * hdr;
+  arena_ent_t * ent;
+  arena_u32 * disp;
+  int i;
+
+  base = malloc(size);
+  if (!base)
+    return 0;
+  memset(base, 0, size);
+  hdr  = (arena_hdr_t *) base;
+  ent  = (arena_ent_t *) (hdr + 1);
+  disp = (arena_u32 *) (ent + count);
+  memcpy(hdr->magic, arena_magic, sizeof(hdr->magic));
+  hdr->key   = arena_key();
+  hdr->size  = size;
+  hdr->count = count;
+  hdr->nslot = nslot;
+  memcpy(ent, tmp, sizeof(tmp));
+
+  for (i = 0; i < count; ++i) {
+    const int dsize = replays[i].dsize;
+    strcpy((char *)base + ent[i].name, replays[i].name);
+    if (gzip68_buffer(base + ent[i].data, dsize,
+                      replays[i].data, replays[i].csize) != dsize) {
+      msg68_error("rsc68: inflated size of built-in replay differs"
+                  " -- %s\n", replays[i].name);
+      goto error;
+    }
+  }
+
+  if (arena_phash(disp, disp + count, count, nslot)) {
+    msg68_error("rsc68: replay arena hash failed\n");
+    goto error;
+  }
+  *psize = size;
+  return base;
+
+error:
+  free(base);
+  return 0;
+}
+
+/* Check a cache file against this built-in table: same header, same
+ * layout and every name hashed to its own entry. Only the replay
+ * data are trusted.
+ */
+static int arena_check(const unsigned char * base, int size)
+{
+  const int count = sizeof(replays)/sizeof(*replays);
+  const int nslot = arena_nslot(count);
+  const arena_hdr_t * hdr = (const arena_hdr_t *) base;
+  const arena_ent_t * ent = (const arena_ent_t *) (hdr + 1);
+  const arena_u32 * disp = (const arena_u32 *) (ent + count);
+  arena_ent_t tmp[sizeof(replays)/sizeof(*replays)];
+  int i;
+
+  if (size != arena_layout(tmp, count, nslot)
+      || memcmp(hdr->magic, arena_magic, sizeof(hdr->magic))
+      || hdr->key != arena_key() || hdr->size != size
+      || hdr->count != count || hdr->nslot != nslot
+      || memcmp(ent, tmp, sizeof(tmp)))
+    return -1;
+  for (i = 0; i < count; ++i)
+    if (*arena_lookup(replays[i].name, disp, count, nslot) != i
+        || strcmp((const char *)base + ent[i].name, replays[i].name))
+      return -1;
+  return 0;
+}
+
+/* Map (or read) a cache file. */
+static int arena_load(const char * path)
+{
+  FILE * f = fopen(path, "rb");
+  unsigned char * base = 0;
+  long size;
+
+  if (!f)
+    return -1;
+  if (fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0 || size >= 1<<30)
+    goto error;
+
+#ifdef ARENA68_MMAP
+  base = mmap(0, size, PROT_READ, MAP_SHARED, fileno(f), 0);
+  if (base == MAP_FAILED)
+    base = 0;
+  else if (arena_check(base, size)) {
+    munmap(base, size);
+    base = 0;
+  } else {
+    fclose(f);
+    arena_set(base, 1);
+    return 0;
+  }
+#else
+  base = malloc(size);
+  if (base && !fseek(f, 0, SEEK_SET) && fread(base, 1, size, f) == (size_t)size
+      && !arena_check(base, size)) {
+    fclose(f);
+    arena_set(base, 0);
+    return 0;
+  }
+  free(base);
+#endif
+
+error:
+  fclose(f);
+  return -1;
+}
+
+/* Write a cache file. It is written aside then renamed so that other
+ * processes never map a partial file.
+ */
+static int arena_save(const char * path, const void * base, int size)
+{
+  const int len = strlen(path);
+  char * tmp = malloc(len + 5);
+  FILE * f;
+  int err = -1;
+
+  if (!tmp)
+    return -1;
+  memcpy(tmp, path, len);
+  memcpy(tmp + len, ".tmp", 5);
+  f = fopen(tmp, "wb");
+  if (f) {
+    err = -(fwrite(base, 1, size, f) != (size_t)size);
+    err |= fclose(f);
+    if (!err)
+      err = rename(tmp, path);
+    if (err)
+      remove(tmp);
+  }
+  free(tmp);
+  return err;
+}
+
+int replay68_arena(const char * cache)
+{
+  unsigned char * base;
+  int size;
+
+  if (arena.base)
+    return 0;
+
+  if (cache && *cache && !arena_load(cache)) {
+    TRACE68(rsc68_cat, "rsc68: replay arena loaded -- %s (%u bytes)\n",
+            cache, arena.hdr->size);
+    return 0;
+  }
+
+  base = arena_build(&size);
+  if (!base)
+    return -1;
+
+  if (cache && *cache) {
+    if (arena_save(cache, base, size))
+      msg68_warning("rsc68: failed to save replay arena -- %s\n", cache);
+#ifdef ARENA68_MMAP
+    else if (!arena_load(cache)) {
+      /* Prefer the shared mapping over the private copy. */
+      free(base);
+      base = 0;
+    }
+#endif
+  }
+  if (base)
+    arena_set(base, 0);
+
+  TRACE68(rsc68_cat, "rsc68: replay arena built -- %d replays in %u bytes\n",
+          arena.hdr->count, arena.hdr->size);
+  return 0;
+}
+
+int replay68_arena_get(const char * name, const void ** data, int * size)
+{
+  const arena_ent_t * ent;
+  arena_u32 s;
+
+  if (!arena.base || !name)
+    return -1;
+  s = *arena_lookup(name, arena.disp, arena.hdr->count, arena.hdr->nslot);
+  if (s == ~0u)
+    return -1;
+  ent = arena.ent + s;
+  if (strcmp68(name, (const char *)arena.base + ent->name))
+    return -1;
+  if (data)
+    *data = arena.base + ent->data;
+  if (size)
+    *size = ent->size;
+  return 0;
+}
+
+void replay68_arena_free(void)
+{
+  if (!arena.base)
+    return;
+#ifdef ARENA68_MMAP
+  if (arena.mapped)
+    munmap((void *)arena.base, arena.hdr->size);
+  else
+#endif
+    free((void *)arena.base);
+  memset(&arena, 0, sizeof(arena));
+}
@@ -56,6 +56,9 @@ static volatile int init = 0;
 
 /* in replay68.c */
 int replay68_get(const char * name, const void ** data, int * csize, int * dsize);
+int replay68_arena(const char * cache);
+int replay68_arena_get(const char * name, const void ** data, int * size);
+void replay68_arena_free(void);
 
 /* The resource pathes are context independant consequently
  * each context use the same pathes.
@@ -65,6 +68,22 @@ static const char * user_path   = 0; /* User resource path.   */
 static const char * lmusic_path = 0; /* Local music path.     */
 static const char * rmusic_path = 0; /* Remote music path.    */
 
+/* Decompressed replay images.
+ *
+ * Images are loaded on first request and published in front of a
+ * singly linked list with an atomic compare and swap. Published
+ * entries are never modified and are only freed by rsc68_shutdown()
+ * so that lookups never need a lock.
+ */
+typedef struct replay_img_s replay_img_t;
+struct replay_img_s {
+  replay_img_t * next;                  /* next entry                */
+  const char   * name;                  /* points after data[]       */
+  int            size;                  /* image size in bytes       */
+  unsigned char  data[1];               /* image data then name      */
+};
+static replay_img_t * volatile replay_imgs = 0;
+
 static vfs68_t * default_open(rsc68_t type, const char *name, int mode,
                                   rsc68_info_t * info);
 
@@ -357,6 +376,143 @@ const char * rsc68_get_music_params(rsc68_info_t *info, const char *name)
 
 
 
+static replay_img_t * replay_img_find(const char * name)
+{
+  replay_img_t * img;
+  for (img = replay_imgs; img; img = img->next)
+    if (!strcmp68(img->name, name))
+      break;
+  return img;
+}
+
+static replay_img_t * replay_img_new(const char * name, int size)
+{
+  const int len = strlen(name) + 1;
+  replay_img_t * img = malloc(sizeof(*img) + size + len);
+  if (img) {
+    img->next = 0;
+    img->size = size;
+    img->name = memcpy(img->data + size, name, len);
+  }
+  return img;
+}
+
+/* Publish a new image. If the same replay has been published
+ * meanwhile by another thread the new image is discarded and the
+ * existing one is returned instead.
+ */
+static replay_img_t * replay_img_push(replay_img_t * img)
+{
+  replay_img_t * head, * dup;
+
+  do {
+    head = replay_imgs;
+    for (dup = head; dup && strcmp68(dup->name, img->name); dup = dup->next)
+      ;
+    if (dup) {
+      free(img);
+      return dup;
+    }
+    img->next = head;
+  } while (!CAS68(&replay_imgs, head, img));
+
+  TRACE68(rsc68_cat, "rsc68: cached replay -- %s (%d bytes)\n",
+          img->name, img->size);
+  return img;
+}
+
+static void replay_img_flush(void)
+{
+  replay_img_t * img;
+
+  do {
+    img = replay_imgs;
+  } while (!CAS68(&replay_imgs, img, 0));
+
+  while (img) {
+    replay_img_t * next = img->next;
+    free(img);
+    img = next;
+  }
+}
+
+#ifdef USE_REPLAY68
+
+/* Get a built-in replay image, inflating it on first use. */
+static replay_img_t * replay_img_builtin(const char * name)
+{
+  replay_img_t * img = replay_img_find(name);
+
+  if (!img) {
+    const void * cdata;
+    int csize, dsize;
+
+    TRACE68(rsc68_cat,"rsc68: trying built-in replay -- %s\n", name);
+    if (!replay68_get(name, &cdata, &csize, &dsize)) {
+      TRACE68(rsc68_cat,"rsc68: found built-in replay -- %s %d %d\n",
+              name, csize, dsize);
+      img = replay_img_new(name, dsize);
+      if (img) {
+        int inflate = gzip68_buffer(img->data, dsize, cdata, csize);
+        if (inflate != dsize) {
+          msg68_error("rsc68: inflated size of built-in replay differs"
+                      " -- %s %d %d\n",name, inflate, dsize);
+          free(img);
+          img = 0;
+        } else {
+          img = replay_img_push(img);
+        }
+      }
+    }
+  }
+  return img;
+}
+
+#endif
+
+int rsc68_get_replay(const char * name, const void ** data, int * size)
+{
+  replay_img_t * img;
+
+  if (!name)
+    return -1;
+
+#ifdef USE_REPLAY68
+  if (!replay68_arena_get(name, data, size))
+    return 0;
+#endif
+
+  img = replay_img_find(name);
+  if (!img) {
+    vfs68_t * is = rsc68_open(rsc68_replay, name, 1, 0);
+
+    /* Built-in replays are cached by the default handler. */
+    img = replay_img_find(name);
+    if (!img && is) {
+      int len = vfs68_length(is);
+      if (len >= 0 && (img = replay_img_new(name, len), img)) {
+        if (vfs68_read(is, img->data, len) != len) {
+          free(img);
+          img = 0;
+        } else {
+          img = replay_img_push(img);
+        }
+      }
+    }
+    vfs68_destroy(is);
+  }
+
+  if (img) {
+    if (data)
+      *data = img->data;
+    if (size)
+      *size = img->size;
+  } else
+    msg68_error("rsc68: failed to load replay -- %s\n", name);
+
+  return -!img;
+}
+
 /* author/hw/title[/:track:loop:time] */
 static char * convert_music_path(char * newname, int max,
                                  const char *name,
@@ -520,35 +676,21 @@ static vfs68_t * default_open(rsc68_t type, const char *name,
 
 #elif defined (USE_REPLAY68)
 
-    /* Method using gzip68_buffer() is probably faster (less memory
-     * copy) than the previous Z stream one. It still need to allocate
-     * a temporary buffer to store deflated data whereas a proper
-     * vfs could have deflated on the fly into the 68k memory
-     * buffer. See previous method comment on that matter.
+    /* Built-in replays are inflated once in the replay arena or the
+     * replay image cache and served by a memory stream over the
+     * shared read-only data.
      */
     if (mode == 1) {
-      const void * cdata;
-      void * ddata;
-      int csize, dsize;
-
-      TRACE68(rsc68_cat,"rsc68: trying built-in replay -- %s\n", name);
-      if (!replay68_get(name, &cdata, &csize, &dsize)) {
-        TRACE68(rsc68_cat,"rsc68: found built-in replay -- %s %d %d\n",
-                name, csize, dsize);
-        ddata = malloc(dsize);
-        if (ddata) {
-          int inflate = gzip68_buffer(ddata, dsize, cdata, csize);
-          if (inflate != dsize) {
-            msg68_error("rsc68: inflated size of built-in replay differs"
-                        " -- %s %d %d\n",name, inflate, dsize);
-            err = -1;
-          } else {
-            is = vfs68_mem_create(ddata, dsize, mode|VFS68_SLAVE);
-            if ( (err = -!is) != 0) {
-              free(ddata);
-            }
-          }
-        }
+      const void * data;
+      int size;
+      replay_img_t * img;
+
+      if (!replay68_arena_get(name, &data, &size)) {
+        is = vfs68_mem_create(data, size, mode);
+        err = vfs68_open(is);
+      } else if (img = replay_img_builtin(name), img) {
+        is = vfs68_mem_create(img->data, img->size, mode);
+        err = vfs68_open(is);
       }
     }
 
@@ -750,6 +892,18 @@ vfs68_t * rsc68_open(rsc68_t type, const char *name, int mode,
   return rsc68(type, name, mode, info);
 }
 
+int rsc68_replay_arena(const char * cache)
+{
+#ifdef USE_REPLAY68
+  if (!init)
+    return -1;
+  return replay68_arena(cache);
+#else
+  msg68_warning("rsc68: no built-in replays\n");
+  return -1;
+#endif
+}
+
 int rsc68_init(void)
 {
   int err = -1;
@@ -788,6 +942,11 @@ void rsc68_shutdown(void)
     rsc68_set_user(0);
     rsc68_set_music(0);
     rsc68_set_remote_music(0);
+    /* destroy cached replays. */
+    replay_img_flush();
+#ifdef USE_REPLAY68
+    replay68_arena_free();
+#endif
     rsc68 = default_open;
     init  = 0;
   }
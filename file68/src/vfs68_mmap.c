@@ -0,0 +1,292 @@
+/*
+ * @file    vfs68_mmap.c
+ * @brief   implements vfs68 VFS for memory mapped local files
+ * @author  http://sourceforge.net/users/benjihan
+ *
+ * Copyright (c) 1998-2016 Benjamin Gerard
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include "file68_private.h"
+#include "file68_api.h"
+#include "file68_vfs_mmap.h"
+
+/* define this if you don't want memory mapped file support. */
+#if !defined(ISTREAM68_NO_MMAP) && defined(HAVE_SYS_MMAN_H)
+
+#include "file68_vfs_def.h"
+#include "file68_uri.h"
+#include "file68_str.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+/** vfs mmap structure. */
+typedef struct {
+  vfs68_t vfs;                    /**< vfs function.                */
+  char * addr;                    /**< Mapped data (0:not mapped).  */
+  int size;                       /**< Mapped data size.            */
+  int pos;                        /**< Current position.            */
+  int open;                       /**< Open flag.                   */
+
+  /* MUST BE at the end of the structure because supplemental bytes will
+   * be allocated to store filename.
+   */
+  char name[1];                   /**< filename.                    */
+
+} vfs68_mmap_t;
+
+static int mmap_ismine(const char *);
+static vfs68_t * mmap_create(const char *, int, int, va_list);
+static scheme68_t mmap_scheme = {
+  0, "vfs-mmap", mmap_ismine, mmap_create
+};
+
+static int mmap_ismine(const char * uri)
+{
+  return !strncmp68(uri, "mmap://", 7)
+    ? SCHEME68_ISMINE|SCHEME68_READ
+    : 0
+    ;
+}
+
+static const char * immname(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+
+  return (!imm->name[0])
+    ? 0
+    : imm->name;
+}
+
+static int immopen(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+  struct stat st;
+  void * addr;
+  int fd;
+
+  if (!*imm->name || imm->open)
+    return -1;
+
+  fd = open(imm->name, O_RDONLY);
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &st) || st.st_size < 0 || st.st_size >= 1<<30) {
+    close(fd);
+    return -1;
+  }
+
+  /* Mapping is private so that pages modified by the loader (such as
+   * trimmed strings) are copied and never written back to the file.
+   * Untouched pages are shared with the system file cache.
+   */
+  addr = 0;
+  if (st.st_size > 0) {
+    addr = mmap(0, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);                    /* mapping keeps its own reference */
+
+  imm->addr = addr;
+  imm->size = st.st_size;
+  imm->pos  = 0;
+  imm->open = 1;
+  return 0;
+}
+
+static int immclose(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+
+  if (!imm->open)
+    return -1;
+  vfs68_mmap_free(imm->addr, imm->size);
+  imm->addr = 0;
+  imm->size = 0;
+  imm->pos  = 0;
+  imm->open = 0;
+  return 0;
+}
+
+static int immread(vfs68_t * vfs, void * data, int n)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+
+  if (!imm->open || !imm->addr || n < 0)
+    return -1;
+  if (n > imm->size - imm->pos)
+    n = imm->size - imm->pos;
+  if (n > 0) {
+    memcpy(data, imm->addr + imm->pos, n);
+    imm->pos += n;
+  }
+  return n;
+}
+
+static int immwrite(vfs68_t * vfs, const void * data, int n)
+{
+  return -1;
+}
+
+static int immflush(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+  return -!imm->open;
+}
+
+static int immlength(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+
+  return !imm->open
+    ? -1
+    : imm->size
+    ;
+}
+
+static int immtell(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+
+  return !imm->open
+    ? -1
+    : imm->pos
+    ;
+}
+
+static int immseek(vfs68_t * vfs, int offset)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+  int pos;
+
+  if (!imm->open)
+    return -1;
+  pos = imm->pos + offset;
+  if (pos < 0 || pos > imm->size)
+    return -1;
+  imm->pos = pos;
+  return 0;
+}
+
+static void immdestroy(vfs68_t * vfs)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+
+  if (imm->open)
+    immclose(vfs);
+  free(vfs);
+}
+
+static const vfs68_t vfs68_mmap = {
+  immname,
+  immopen, immclose,
+  immread, immwrite, immflush,
+  immlength, immtell,
+  immseek, immseek,
+  immdestroy
+};
+
+static vfs68_t * mmap_create(const char * uri, int mode,
+                             int argc, va_list list)
+{
+  vfs68_mmap_t * imm;
+  int len;
+
+  if (!strncmp68(uri,"mmap://", 7))
+    uri += 7;
+
+  /* Read only */
+  if ((mode & (VFS68_OPEN_READ|VFS68_OPEN_WRITE)) != VFS68_OPEN_READ)
+    return 0;
+
+  len = strlen(uri);
+  imm = malloc(sizeof(vfs68_mmap_t) + len);
+  if (!imm)
+    return 0;
+
+  imm->vfs  = vfs68_mmap;
+  imm->addr = 0;
+  imm->size = 0;
+  imm->pos  = 0;
+  imm->open = 0;
+  strcpy(imm->name, uri);
+
+  return &imm->vfs;
+}
+
+void * vfs68_mmap_detach(vfs68_t * vfs, int * size)
+{
+  vfs68_mmap_t * imm = (vfs68_mmap_t *)vfs;
+  void * addr = 0;
+
+  if (imm && vfs->name == immname && imm->open && imm->addr) {
+    addr = imm->addr;
+    if (size)
+      *size = imm->size;
+    /* Keep position and size for tell() but prevent further reads. */
+    imm->addr = 0;
+  }
+  return addr;
+}
+
+void vfs68_mmap_free(void * addr, int size)
+{
+  if (addr && size > 0)
+    munmap(addr, size);
+}
+
+int vfs68_mmap_init(void)
+{
+  return uri68_register(&mmap_scheme);
+}
+
+void vfs68_mmap_shutdown(void)
+{
+  uri68_unregister(&mmap_scheme);
+}
+
+#else /* #if !defined(ISTREAM68_NO_MMAP) && defined(HAVE_SYS_MMAN_H) */
+
+/* vfs mmap must not be include in this package. Anyway the functions
+ * still exist but the scheme is never registered.
+ */
+
+void * vfs68_mmap_detach(vfs68_t * vfs, int * size) { return 0; }
+void vfs68_mmap_free(void * addr, int size) { }
+int vfs68_mmap_init(void) { return 0; }
+void vfs68_mmap_shutdown(void) { }
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * @ingroup   lib_emu68
+ * @file      emu68/clock68.h
+ * @brief     Monotonic clock for performance counters.
+ * @author    Benjamin Gerard
+ * @date      2016/08/02
+ */
+
+/* Copyright (c) 1998-2016 Benjamin Gerard */
+
+#ifndef EMU68_CLOCK68_H
+#define EMU68_CLOCK68_H
+
+#include "type68.h"
+
+/**
+ * @defgroup  lib_emu68_clock  Performance clock
+ * @ingroup   lib_emu68
+ *
+ *   The performance counters (see SC68_GET_STATS) are compiled only
+ *   when USE_STATS is defined (configure --enable-stats). Otherwise
+ *   clock68_ns() is a constant and every measure folds away.
+ *
+ * @{
+ */
+
+#ifndef USE_STATS
+
+# define clock68_ns() ((u64)0)  /**< Stats disabled: no clock.  */
+
+#elif defined(_WIN32)
+
+# include <windows.h>
+
+/**
+ * Get monotonic time in nanoseconds.
+ */
+static inline u64 clock68_ns(void)
+{
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER cnt;
+
+  if (!freq.QuadPart)
+    QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&cnt);
+  return (u64)cnt.QuadPart / freq.QuadPart * 1000000000u
+    + (u64)cnt.QuadPart % freq.QuadPart * 1000000000u / freq.QuadPart;
+}
+
+#else
+
+# include <time.h>
+
+/**
+ * Get monotonic time in nanoseconds.
+ */
+static inline u64 clock68_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#endif
+
+/**
+ * @}
+ */
+
+#endif
@@ -43,6 +43,22 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(HAVE_SYS_MMAN_H) && !defined(EMU68_NO_MMAP)
+# include <sys/mman.h>
+# ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+# endif
+# if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+# ifndef MAP_NORESERVE
+#  define MAP_NORESERVE 0
+# endif
+# ifdef MAP_ANONYMOUS
+#  define EMU68_LAZYMEM 1
+# endif
+#endif
+
 EMU68_EXTERN linefunc68_t *line_func[1024];
 
 /* ,-----------------------------------------------------------------.
@@ -301,6 +317,45 @@ int emu68_chkset(emu68_t * const emu68, addr68_t dst, u8 val, uint68_t sz)
   return -!ptr;
 }
 
+int emu68_memdiscard(emu68_t * const emu68, addr68_t dst, uint68_t sz)
+{
+#ifdef EMU68_LAZYMEM
+  const uintptr_t pgmsk = sysconf(_SC_PAGESIZE) - 1;
+  uintptr_t beg, end;
+  u8 * ptr;
+
+  if (!emu68)
+    return -1;
+  if (!sz)
+    sz = emu68->memmsk + 1 - dst;
+  ptr = emu68_memptr(emu68, dst, sz);
+  if (!ptr)
+    return -1;
+
+  /* Whole pages are replaced by fresh zero pages, partial ones at
+   * both ends are cleared. */
+  beg = ((uintptr_t)ptr + pgmsk) & ~pgmsk;
+  end = ((uintptr_t)ptr + sz) & ~pgmsk;
+  if (end <= beg)
+    memset(ptr, 0, sz);
+  else {
+# if defined(__linux__) && defined(MADV_DONTNEED)
+    if (madvise((void *)beg, end - beg, MADV_DONTNEED))
+# else
+    if (mmap((void *)beg, end - beg, PROT_READ|PROT_WRITE,
+             MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_FIXED, -1, 0)
+        == MAP_FAILED)
+# endif
+      memset((void *)beg, 0, end - beg);
+    memset(ptr, 0, beg - (uintptr_t)ptr);
+    memset((void *)end, 0, (uintptr_t)ptr + sz - end);
+  }
+  return 0;
+#else
+  return -1;
+#endif
+}
+
 static uint_t crc32b(uint_t crc, u8 * ptr, int len)
 {
   u8 * end = ptr + len;
@@ -547,6 +602,7 @@ int emu68_interrupt(emu68_t * const emu68, cycle68_t cycleperpass)
         break;
       emu68->cycle = t->cycle;
       if (t->level > ipl) {
+        ++emu68->nirq;
         inl_exception68(emu68, t->vector, t->level);
         if (emu68->status != EMU68_NRM)
 
@@ -671,6 +727,31 @@ extern io68_t * mem68_io(void);
 
 static emu68_parms_t def_parms;
 
+/* The 68K onboard memory is inline at the end of emu68_t. When it is
+ * possible the whole block is an anonymous private mapping whose
+ * pages are only committed on first touch. The resident memory then
+ * follows what the music actually uses rather than log2mem.
+ */
+static emu68_t * emu68_block_alloc(int size)
+{
+#ifdef EMU68_LAZYMEM
+  void * ptr = mmap(0, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  return ptr == MAP_FAILED ? 0 : ptr;
+#else
+  return emu68_alloc(size);
+#endif
+}
+
+static void emu68_block_free(emu68_t * emu68)
+{
+#ifdef EMU68_LAZYMEM
+  munmap(emu68, sizeof(emu68_t) + ((emu68->memmsk + 1) << !!emu68->chk));
+#else
+  emu68_free(emu68);
+#endif
+}
+
 emu68_t * emu68_create(emu68_parms_t * const parms)
 {
   emu68_t * emu68 = 0;
@@ -698,7 +779,7 @@ emu68_t * emu68_create(emu68_parms_t * const parms)
 
   memsize = 1 << p->log2mem;
   membyte = sizeof(emu68_t) + (memsize << !!p->debug);
-  emu68   = emu68_alloc(membyte);
+  emu68   = emu68_block_alloc(membyte);
   if (!emu68)
     goto error;
 
@@ -752,6 +833,7 @@ emu68_t * emu68_duplicate(emu68_t * emu68src, const char * dupname)
   emu68->lst_chk      = emu68src->lst_chk;
 
   emu68->instructions = emu68src->instructions;
+  emu68->nirq         = emu68src->nirq;
   emu68->finish_sp    = emu68src->finish_sp;
   emu68->status       = emu68src->status;
 
@@ -776,7 +858,7 @@ void emu68_destroy(emu68_t * const emu68)
   if (emu68) {
     emu68_ioplug_destroy_all(emu68);
     emu68_mem_destroy(emu68);
-    emu68_free(emu68);
+    emu68_block_free(emu68);
   }
 }
 
@@ -412,6 +412,25 @@ EMU68_API
 int emu68_chkset(emu68_t * const emu68,
                  addr68_t addr, u8 byte, uint68_t size);
 
+EMU68_API
+/**
+ * Clear a 68k on board memory block and give back its pages.
+ *
+ *   On systems supporting it the onboard memory is committed on
+ *   first touch. This function clears the block and gives the pages
+ *   it covers back to the system so that they no longer count in the
+ *   resident memory until touched again.
+ *
+ * @param  emu68  emulator instance
+ * @param  addr   address of 68K memory block to access
+ * @param  size   size in byte of the memory block (0: up to the end)
+ * @return error-code
+ * @retval  0 on success (block is cleared)
+ * @retval -1 on error or not supported (memory is unchanged)
+ */
+int emu68_memdiscard(emu68_t * const emu68,
+                     addr68_t addr, uint68_t size);
+
 EMU68_API
 /**
  * Push 32-bit long word.
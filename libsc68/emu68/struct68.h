@@ -202,6 +202,7 @@ struct emu68_s {
 
   int      status;                      /**< Execution status.      */
   uint68_t instructions;                /**< Instruction countdown. */
+  uint68_t nirq;                        /**< Interrupts taken.      */
   addr68_t finish_sp;                   /**< Finish Stack Pointer.  */
 
   /* IO chips. */
@@ -578,3 +578,11 @@ io68_t * mfpio_create(emu68_t * const emu68)
   }
   return &mfpio->io;
 }
+
+mfp_t * mfpio_emulator(io68_t * const io)
+{
+  return io
+    ? &((mfp_io68_t*)io)->mfp
+    : 0
+    ;
+}
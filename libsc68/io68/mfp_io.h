@@ -12,7 +12,7 @@
 #define IO68_MFP_IO_H
 
 #include "io68_api.h"
-#include "emu68/struct68.h"
+#include "mfpemul.h"
 
 /**
  * @addtogroup  lib_io68_mfp
@@ -48,6 +48,12 @@ IO68_EXTERN
  */
 io68_t * mfpio_create(emu68_t * const emu68);
 
+IO68_EXTERN
+/**
+ * Get MFP emulator instance.
+ */
+mfp_t * mfpio_emulator(io68_t * const io);
+
 /**
  * @}
  */
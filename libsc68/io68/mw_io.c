@@ -59,7 +59,7 @@ static int68_t _mw_readB(mw_io68_t * const mwio, const u8 addr)
     return ct & 0xFE;
   }
   return (addr >= 0 && addr < 64)
-    ? mwio->mw.map[addr]
+    ? mwio->mw.shadow[addr]
     : 0
     ;
 }
@@ -68,7 +68,7 @@ static int68_t _mw_readW(mw_io68_t * const mwio, const u8 addr)
 {
   switch (addr) {
   case MW_DATA: case MW_CTRL:
-    return ( mwio->mw.map[addr+0] << 8 ) + mwio->mw.map[addr+1];
+    return ( mwio->mw.shadow[addr+0] << 8 ) + mwio->mw.shadow[addr+1];
     break;
   }
   return _mw_readB(mwio, mwio->io.emu68->bus_addr+1);
@@ -110,44 +110,13 @@ static void _mw_writeB(mw_io68_t * const mwio, const u8 addr, int68_t v)
   assert(addr != MW_DATA);
   assert(addr != MW_CTRL);
 
-  /* Skip even line in any case. */
-  if ( ! ( addr & 1 ) ) {
-    return;
-  }
-
-  switch (addr) {
-
-  case MW_ACTI:
-    v &= 3;                             /* ??? should we ? */
-
-    /* Reload internal counters
-     *
-     * $$$ Should we do this whatever the value or only if dma is
-     * started ? This is probably not a great deal !
-     */
-    mwio->mw.ct  = mw_counter_read(&mwio->mw,MW_BASH);
-    mwio->mw.end = mw_counter_read(&mwio->mw,MW_ENDH);
-    break;
-
-  case MW_CTH: case MW_CTM: case MW_CTL:
-    /* write to counter register does nothing */
-    return;
-
-  }
-
-  if (addr >= 0 && addr < 64)
-    mwio->mw.map[addr] = v;
+  mw_writereg(&mwio->mw, addr, (u8) v, mwio->io.emu68->cycle);
 }
 
 static void _mw_writeW(mw_io68_t * const mwio, const u8 addr, int68_t v)
 {
-  if (addr == MW_CTRL) {
-    mwio->mw.map[MW_CTRL+0] = v >> 8;
-    mwio->mw.map[MW_CTRL+1] = v;
-  } else if (addr == MW_DATA) {
-    mwio->mw.map[MW_DATA+0] = v >> 8;
-    mwio->mw.map[MW_DATA+1] = v;
-    mw_command(&mwio->mw);
+  if (addr == MW_CTRL || addr == MW_DATA) {
+    mw_writereg(&mwio->mw, addr, (u16) v, mwio->io.emu68->cycle);
   } else if ( !(addr & 1) ) {
     _mw_writeB(mwio, addr+1, v);
   }
@@ -161,11 +130,9 @@ static void _mw_writeL(mw_io68_t * const mwio, const u8 addr, int68_t v)
      * proper way to do it in the real world. Anyway we'll do as if it
      * works.
      */
-    mwio->mw.map[MW_DATA+0] = v >> 24;
-    mwio->mw.map[MW_DATA+1] = v >> 16;
-    mwio->mw.map[MW_CTRL+2] = v >>  8;
-    mwio->mw.map[MW_CTRL+3] = v;
-    mw_command(&mwio->mw);
+    mwio->mw.shadow[MW_CTRL+2] = v >>  8;
+    mwio->mw.shadow[MW_CTRL+3] = v;
+    mw_writereg(&mwio->mw, MW_DATA, (u16) ( v >> 16 ), mwio->io.emu68->cycle);
   } else if ( !(addr & 1) ) {
     /* Any other (even) long access are translate to word access */
     _mw_writeW(mwio, addr+0, v >> 16);
@@ -212,6 +179,7 @@ static cycle68_t mwio_next_interrupt(io68_t * const io, cycle68_t cycle)
 
 static void mwio_adjust_cycle(io68_t * const io, cycle68_t cycle)
 {
+  mw_adjust_cycle(&((mw_io68_t *)io)->mw, cycle);
 }
 
 static int mwio_reset(io68_t * const io)
@@ -265,6 +233,7 @@ io68_t * mwio_create(emu68_t * const emu68, mw_parms_t * const parms)
       }
       setup.mem     = emu68->mem;
       setup.log2mem = emu68->log2mem;
+      setup.clock   = emu68->clock;
       mwio->io      = mw_io;
       mw_setup(&mwio->mw, &setup);
     }
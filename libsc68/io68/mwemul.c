@@ -42,6 +42,7 @@
 
 #include "emu68/assert68.h"
 #include <sc68/file68_msg.h>
+#include <string.h>
 
 #ifndef DEBUG_MW_O
 # define DEBUG_MW_O 0
@@ -58,7 +59,9 @@ enum {
   MW_N_DECIBEL = 121,
   MW_MIX_FIX   = 10,
   MW_STE_MULT  = ((1<<MW_MIX_FIX)/4),
-  MW_YM_MULT   = ((1<<MW_MIX_FIX)-MW_STE_MULT)
+  MW_YM_MULT   = ((1<<MW_MIX_FIX)-MW_STE_MULT),
+  MW_MIX_BLOCK = 512,                   /* samples mixed per block */
+  MW_BQ_FIX    = 27                     /* biquad coefficients */
 };
 
 /* $$$/XXX THIS IS WRONG AND NEEDS TO BE FIXED */
@@ -171,6 +174,8 @@ int mw_sampling_rate(mw_t * const mw, int hz)
     else if (hz > SPR_MAX)
       hz = SPR_MAX;
     *(mw ? &mw->hz : &default_parms.hz) = hz;
+    if (mw)
+      mw->tone_hz = 0;
     TRACE68(mw_cat, MWHD "%s sampling rate -- *%dhz*\n",
             mw ? "select" : "default", hz);
     break;
@@ -247,12 +252,12 @@ static int lmc_lr(mw_t * const mw, const int lr, int n)
 
 int mw_lmc_left(mw_t * const mw, int n)
 {
-  return lmc_lr(mw,0,n);
+  return lmc_lr(mw,1,n);
 }
 
 int mw_lmc_right(mw_t * const mw, int n)
 {
-  return lmc_lr(mw,1,n);
+  return lmc_lr(mw,0,n);
 }
 
 /* range [0..12] -> [12..0] (-dB) */
@@ -266,20 +271,21 @@ static int lmc_hl(mw_t * const mw, const int hl, int n)
     if (n <  0) n = 0;
     if (n > 12) n = 12;
     *pval = 12 - n;
-    TRACE68(mw_cat, MWHD "LMC -- %s pass filter -- *-%02ddB*\n",
-            hl ? "high" : "low", *pval);
+    mw->tone_hz = 0;
+    TRACE68(mw_cat, MWHD "LMC -- %s -- *%+02ddB*\n",
+            hl ? "treble" : "bass", 12 - 2 * *pval);
   }
   return n;
 }
 
 int mw_lmc_high(mw_t * const mw, int n)
 {
-  return lmc_hl(mw,0,n);
+  return lmc_hl(mw,1,n);
 }
 
 int mw_lmc_low(mw_t * const mw, int n)
 {
-  return lmc_hl(mw,1,n);
+  return lmc_hl(mw,0,n);
 }
 
 static int command_dispatcher(mw_t * const mw, int n)
@@ -314,21 +320,10 @@ static int command_dispatcher(mw_t * const mw, int n)
   return 0;
 }
 
-int mw_command(mw_t * const mw)
+/* Decode a microwire command (-1 on error). */
+static int decode_command(const uint_t data, const uint_t ctrl)
 {
-  uint_t ctrl, data, comm, bits, mask;
-
-  if (!mw)
-    return -1;
-
-  ctrl = ( mw->map[MW_CTRL] << 8 ) + mw->map[MW_CTRL+1];
-  data = ( mw->map[MW_DATA] << 8 ) + mw->map[MW_DATA+1];
-
-  /* Clear data, keep control.
-   * Normally data is shifted left until it clears whereas control
-   * rotated left until it's back to its orginal value.
-   */
-  mw->map[MW_DATA] = mw->map[MW_DATA+1] = 0;
+  uint_t comm, bits, mask;
 
   TRACE68(mw_cat, MWHD "shifting -- %04x/%04x\n", data, ctrl);
 
@@ -354,8 +349,38 @@ int mw_command(mw_t * const mw)
     return -1;
   }
 
-  return
-    command_dispatcher(mw, comm & 0777);
+  return comm & 0777;
+}
+
+/* Read the command in the CPU side registers. */
+static int shift_command(mw_t * const mw)
+{
+  uint_t ctrl, data;
+
+  ctrl = ( mw->shadow[MW_CTRL] << 8 ) + mw->shadow[MW_CTRL+1];
+  data = ( mw->shadow[MW_DATA] << 8 ) + mw->shadow[MW_DATA+1];
+
+  /* Clear data, keep control.
+   * Normally data is shifted left until it clears whereas control
+   * rotated left until it's back to its orginal value.
+   */
+  mw->shadow[MW_DATA] = mw->shadow[MW_DATA+1] = 0;
+
+  return decode_command(data, ctrl);
+}
+
+int mw_command(mw_t * const mw)
+{
+  int comm;
+
+  if (!mw)
+    return -1;
+
+  comm = shift_command(mw);
+  return comm < 0
+    ? -1
+    : command_dispatcher(mw, comm)
+    ;
 }
 
 
@@ -379,16 +404,29 @@ int mw_reset(mw_t * const mw)
   int i;
 
   for ( i=0; i<sizeof(mw->map); i++ ) {
-    mw->map[i] = 0;
+    mw->map[i] = mw->shadow[i] = 0;
   }
   mw->ct = mw->end = 0;
   lmc_reset(mw);
 
+  /* Clear tone filters history */
+  memset(mw->tone, 0, sizeof(mw->tone));
+  mw->tone_hz = 0;
+
+  /* Discard pending accesses */
+  mw->event_ptr = mw->event_buf;
+  mw->event_ovf = 0;
+
   TRACE68(mw_cat, MWHD "%s\n", "chip reset");
   return 0;
 }
 
-void mw_cleanup(mw_t * const mw) {}
+void mw_cleanup(mw_t * const mw)
+{
+  if (mw && mw->event_ovf)
+    TRACE68(mw_cat, MWHD "write access buffer has overflow -- *%u*\n",
+            mw->event_ovf);
+}
 
 int mw_setup(mw_t * const mw,
              mw_setup_t * const setup)
@@ -408,6 +446,7 @@ int mw_setup(mw_t * const mw,
   mw->mem     = setup->mem;
   mw->log2mem = setup->log2mem;
   mw->ct_fix  = ( sizeof(mwct_t) << 3 ) - mw->log2mem;
+  mw->clock   = setup->clock;
 
   TRACE68(mw_cat, MWHD "%d-bit memory, %d-bit precision\n",
           setup->log2mem, mw->ct_fix);
@@ -442,26 +481,236 @@ void mw_shutdown(void)
   mw_cat = msg68_DEFAULT;
 }
 
-/* Rescale n sample of b with f ( << MW_MIX_FIX ) */
-static void rescale(s32 * b, int f, int n)
+/* ,-----------------------------------------------------------------.
+ * |                     Write microwire register                    |
+ * `-----------------------------------------------------------------'
+ */
+
+#define ELTOF(A) ( sizeof(A) / sizeof(*A) )
+
+/* Apply a write access to the emulated hardware. */
+static void write_hw(mw_t * const mw, const mw_event_t * const ev)
 {
-  if (!f) {
-    do { *b++ = 0; } while (--n);
-  } else if (f != (1<<MW_MIX_FIX)) {
-    do {
-      int v;
-      v = ((*b)*f) >> MW_MIX_FIX;
-      *b++ = ( v << 16 ) | ( v & 0xFFFF );
-    } while (--n);
+  switch (ev->reg) {
+
+  case MW_DATA:
+    command_dispatcher(mw, ev->val);
+    break;
+
+  case MW_ACTI:
+    /* Reload internal counters
+     *
+     * $$$ Should we do this whatever the value or only if dma is
+     * started ? This is probably not a great deal !
+     */
+    mw->map[MW_ACTI] = mw->shadow[MW_ACTI] = ev->val;
+    mw->ct  = mw_counter_read(mw, MW_BASH);
+    mw->end = mw_counter_read(mw, MW_ENDH);
+    break;
+
+  default:
+    mw->map[ev->reg] = ev->val;
+    break;
+  }
+}
+
+/* Apply all pending accesses. */
+static void flush_events(mw_t * const mw)
+{
+  const mw_event_t * ev;
+
+  for (ev = mw->event_buf; ev < mw->event_ptr; ++ev)
+    write_hw(mw, ev);
+  mw->event_ptr = mw->event_buf;
+}
+
+void mw_writereg(mw_t * const mw, const int reg, const int val,
+                 const cycle68_t cycle)
+{
+  const mw_event_t * const event_end = mw->event_buf + ELTOF(mw->event_buf);
+  mw_event_t * ev;
+  int v;
+
+  switch (reg) {
+
+  case MW_CTRL:
+    mw->shadow[MW_CTRL+0] = val >> 8;
+    mw->shadow[MW_CTRL+1] = val;
+    return;
+
+  case MW_DATA:
+    mw->shadow[MW_DATA+0] = val >> 8;
+    mw->shadow[MW_DATA+1] = val;
+    v = shift_command(mw);
+    if (v < 0)
+      return;
+    break;
+
+  case MW_CTH: case MW_CTM: case MW_CTL:
+    /* write to counter register does nothing */
+    return;
+
+  default:
+    /* Skip even line in any case. */
+    if ( ! ( reg & 1 ) || reg < 0 || reg >= 64 )
+      return;
+    v = (u8) val;
+    if (reg == MW_ACTI)
+      v &= 3;                           /* ??? should we ? */
+    mw->shadow[reg] = v;
+    break;
+  }
+
+  if (mw->event_ptr >= event_end) {
+    /* No more room: catch up with all pending accesses. */
+    ++mw->event_ovf;
+    flush_events(mw);
+  }
+  ev = mw->event_ptr++;
+  ev->cycle = cycle;
+  ev->reg   = reg;
+  ev->val   = v;
+}
+
+void mw_adjust_cycle(mw_t * const mw, const cycle68_t cycles)
+{
+  mw_event_t * ev;
+
+  for (ev = mw->event_buf; ev < mw->event_ptr; ++ev)
+    ev->cycle = ev->cycle > cycles ? ev->cycle - cycles : 0;
+}
+
+/* ,-----------------------------------------------------------------.
+ * |                        LMC tone control                         |
+ * `-----------------------------------------------------------------'
+ *
+ * Bass and treble are RBJ shelving biquads (slope 1) centered at 50 Hz
+ * and 15 kHz, as documented for the STE. Coefficients only change
+ * with the LMC settings or the sampling rate. A flat control costs
+ * nothing.
+ */
+
+/* 10^(dB/40) and 10^(dB/80) for dB in [-12..+12] by 2dB step. */
+static const double tone_a[13] = {
+  0.501187233627272, 0.562341325190349, 0.630957344480193,
+  0.707945784384138, 0.794328234724281, 0.891250938133746,
+  1.000000000000000, 1.122018454301963, 1.258925411794167,
+  1.412537544622754, 1.584893192461114, 1.778279410038923,
+  1.995262314968880
+};
+
+static const double tone_sqrta[13] = {
+  0.707945784384138, 0.749894209332456, 0.794328234724281,
+  0.841395141645195, 0.891250938133746, 0.944060876285923,
+  1.000000000000000, 1.059253725177289, 1.122018454301963,
+  1.188502227437018, 1.258925411794167, 1.333521432163324,
+  1.412537544622754
+};
+
+/* Sine and cosine for x in [0..pi] (power series, no libm). */
+static void tone_sincos(const double x, double * s, double * c)
+{
+  const double x2 = x * x;
+  double ts = x, tc = 1.0;
+  int i;
+
+  *s = ts; *c = tc;
+  for (i = 1; i < 12; ++i) {
+    ts *= -x2 / ( (2*i) * (2*i+1) );
+    tc *= -x2 / ( (2*i-1) * (2*i) );
+    *s += ts;
+    *c += tc;
+  }
+}
+
+static s32 tone_fix(const double v)
+{
+  return (s32) ( v * (double) (1 << MW_BQ_FIX) + ( v < 0 ? -0.5 : 0.5 ) );
+}
+
+static void tone_shelf(mw_biquad_t * const bq, const int g, const int high,
+                       const double fc, const int hz)
+{
+  const double pi = 3.14159265358979323846;
+  const double A = tone_a[g];
+  double w0 = 2.0 * pi * fc / hz, sn, cs, al, b0, b1, b2, a0, a1, a2;
+
+  if (w0 > 0.9 * pi)
+    w0 = 0.9 * pi;                      /* above nyquist */
+  tone_sincos(w0, &sn, &cs);
+  al = 1.41421356237309504880 * sn * tone_sqrta[g]; /* 2.sqrt(A).alpha */
+
+  if (!high) {
+    b0 =    A * ( (A+1) - (A-1)*cs + al );
+    b1 =  2*A * ( (A-1) - (A+1)*cs      );
+    b2 =    A * ( (A+1) - (A-1)*cs - al );
+    a0 =          (A+1) + (A-1)*cs + al;
+    a1 =   -2 * ( (A-1) + (A+1)*cs      );
+    a2 =          (A+1) + (A-1)*cs - al;
+  } else {
+    b0 =    A * ( (A+1) + (A-1)*cs + al );
+    b1 = -2*A * ( (A-1) + (A+1)*cs      );
+    b2 =    A * ( (A+1) + (A-1)*cs - al );
+    a0 =          (A+1) - (A-1)*cs + al;
+    a1 =    2 * ( (A-1) - (A+1)*cs      );
+    a2 =          (A+1) - (A-1)*cs - al;
   }
+  bq->b0 = tone_fix(b0 / a0);
+  bq->b1 = tone_fix(b1 / a0);
+  bq->b2 = tone_fix(b2 / a0);
+  bq->a1 = tone_fix(a1 / a0);
+  bq->a2 = tone_fix(a2 / a0);
 }
 
-/* --- Rescale n sample of b with r ( << mw_MIX_FIX ) --- */
-static void no_mix_ste(mw_t * const mw, s32 * b, int n)
+/* Compute the coefficients for the current settings. */
+static void tone_setup(mw_t * const mw)
 {
-  rescale(b, (mw->db_conv == Db_alone) ? 0 : MW_YM_MULT, n);
+  const int bass = 12 - mw->lmc.low, treble = 12 - mw->lmc.high;
+
+  mw->tone_on = (bass != 6) | ( (treble != 6) << 1 );
+  if (mw->tone_on & 1)
+    tone_shelf(mw->tone+0, bass, 0, 50.0, mw->hz);
+  if (mw->tone_on & 2)
+    tone_shelf(mw->tone+1, treble, 1, 15000.0, mw->hz);
+  mw->tone_hz = mw->hz;
+  TRACE68(mw_cat, MWHD "LMC -- tone -- bass:%+ddB treble:%+ddB\n",
+          2*bass-12, 2*treble-12);
 }
 
+/* Run n samples of channel c through a biquad. The poles of the bass
+ * shelf are very close to 1 : the truncation error is fed back
+ * (second order) or it would build up a large DC offset.
+ */
+static void tone_filter(mw_biquad_t * const bq, s32 * b, const int c, int n)
+{
+  const s64 b0 = bq->b0, b1 = bq->b1, b2 = bq->b2;
+  const s64 a1 = bq->a1, a2 = bq->a2;
+  const s64 msk = ( (s64) 1 << MW_BQ_FIX ) - 1;
+  s64 x1 = bq->x[c][0], x2 = bq->x[c][1];
+  s64 y1 = bq->y[c][0], y2 = bq->y[c][1];
+  s64 e1 = bq->e[c][0], e2 = bq->e[c][1];
+
+  do {
+    const s64 x0 = *b;
+    const s64 acc =
+      b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2 + 2*e1 - e2;
+    const s64 y0 = acc >> MW_BQ_FIX;
+    x2 = x1; x1 = x0;
+    y2 = y1; y1 = y0;
+    e2 = e1; e1 = acc & msk;
+    *b++ = (s32) y0;
+  } while (--n);
+
+  bq->x[c][0] = x1; bq->x[c][1] = x2;
+  bq->y[c][0] = y1; bq->y[c][1] = y2;
+  bq->e[c][0] = e1; bq->e[c][1] = e2;
+}
+
+/* ,-----------------------------------------------------------------.
+ * |                         DMA sound mixer                         |
+ * `-----------------------------------------------------------------'
+ */
+
 static void skip_ste(mw_t * const mw, int n)
 {
   mwct_t base, end2, ct, end, stp;
@@ -509,147 +758,239 @@ out:
 #define _VOL(LR) \
   (mw->db_conv[mw->lmc.master+mw->lmc.LR] >> 1)
 
-static void mix_ste(mw_t * const mw, s32 *b, int n)
+/* Stop the DMA at the end of a frame (no loop). */
+static void dma_stop(mw_t * const mw)
 {
-  mwct_t base, end2, ct, end, stp;
-  const int          vl = _VOL(left);
-  const int          vr = _VOL(right);
-  const int        loop = mw->map[MW_ACTI] & 2;
-  const int        mono = (mw->map[MW_MODE]>>7) & 1;
-  const uint_t      frq = 50066u >> ((mw->map[MW_MODE]&3)^3);
-  const int68_t ym_mult = (mw->db_conv == Db_alone) ? 0 : MW_YM_MULT;
-  const int      ct_fix = mw->ct_fix;
-  const s8 *        spl = (const s8 *)mw->mem;
-
-  /* Get internal register for sample base and sample end
-   * $$$ ??? what if base > end2 ???
-   */
-  base = mw_counter_read(mw, MW_BASH);
-  end2 = mw_counter_read(mw, MW_ENDH);
-
-  /* Get current sample counter and end */
-  ct  = mw->ct;
-  end = mw->end;
+  mw->map[MW_ACTI] = mw->shadow[MW_ACTI] = 0;
+  mw->ct  = mw_counter_read(mw, MW_BASH);
+  mw->end = mw_counter_read(mw, MW_ENDH);
+}
 
-  if (ct >= end) {
-    if (!loop) {
-      goto out;
+/* Restart or stop a DMA counter past its end before running. */
+static void dma_check(mw_t * const mw)
+{
+  if ( (mw->map[MW_ACTI] & 1) && mw->ct >= mw->end ) {
+    if ( ! (mw->map[MW_ACTI] & 2) ) {
+      dma_stop(mw);
     } else {
-      mwct_t overflow =  ct - end;
-      mwct_t length   = end - base;
-      ct  = base;
+      const mwct_t base     = mw_counter_read(mw, MW_BASH);
+      const mwct_t overflow = mw->ct - mw->end;
+      const mwct_t length   = mw->end - base;
+      mw->ct  = base;
       if (length) {
-        ct += overflow > length ? overflow % length : overflow;
+        mw->ct += overflow > length ? overflow % length : overflow;
       }
-      end = end2;
+      mw->end = mw_counter_read(mw, MW_ENDH);
     }
   }
-  /* Calculate sample step.
-   * Stereo trick : Advance 2 times faster, take care of word alignment later.
-   */
-  stp = ( (mwct_t) frq << ( ct_fix + 1 - mono ) ) / mw->hz;
+}
+
+/* Fetch n DMA samples into the l and r planar buffers (silence when
+ * the DMA is not running). Samples are fetched by blocks up to the
+ * end of frame so the fetch loops have no test. Returns the right
+ * channel buffer (l for mono).
+ */
+static const s32 * fetch_dma(mw_t * const mw, s32 * l, s32 * r, const int n)
+{
+  const int        loop = mw->map[MW_ACTI] & 2;
+  const int        mono = (mw->map[MW_MODE]>>7) & 1;
+  const uint_t      frq = 50066u >> ((mw->map[MW_MODE]&3)^3);
+  const int      ct_fix = mw->ct_fix;
+  const s8 * const  spl = (const s8 *)mw->mem;
+  mwct_t ct, end, stp;
+  int i = 0;
+
+  if (mw->map[MW_ACTI] & 1) {
+    ct  = mw->ct;
+    end = mw->end;
+
+    /* Calculate sample step.
+     * Stereo trick : Advance 2 times faster, take care of word
+     * alignment later.
+     */
+    stp = ( (mwct_t) frq << ( ct_fix + 1 - mono ) ) / mw->hz;
 
-  if (mono) {
-    /* mix mono */
     do {
-      int68_t v, ym;
-
-      ym = (*b) * ym_mult;
-      v = spl[ (int)( ct >> ct_fix ) ];
-      *b++ =
-        (
-          (u16)((v*vl + ym) >> MW_MIX_FIX)
-          +
-          (((v*vr + ym)>>MW_MIX_FIX)<<16)
-          );
-
-      ct += stp;
-      if (ct >= end) {
-        if (!loop) {
-          --n;
-          break;
-        } else {
-          mwct_t overflow = ct-end;
-          mwct_t length   = end-base;
-          ct  = base;
-          if (length) {
-            ct += overflow>length ? overflow%length : overflow;
-          }
-          end = end2;
-        }
+      mwct_t m = ct < end ? ( end - ct + stp - 1 ) / stp : 1;
+
+      if (m > (mwct_t) (n - i))
+        m = n - i;
+      if (mono) {
+        do {
+          l[i++] = spl[ (int)( ct >> ct_fix ) ];
+          ct += stp;
+        } while (--m);
+      } else {
+        do {
+          const int addr = ( ct >> ct_fix ) & ~1;
+          l[i]   = spl[addr+0];
+          r[i++] = spl[addr+1];
+          ct += stp;
+        } while (--m);
       }
-    } while (--n);
 
-  } else {
-    /* mix stereo */
-    do {
-      int68_t l,r,ym;
-      int addr;
-
-      ym = (*b) * ym_mult;
-      addr = ( ct >> ct_fix ) & ~1;
-      l = spl[addr+0];
-      r = spl[addr+1];
-      *b++ =
-        (
-          (u16)((l*vl + ym)>>MW_MIX_FIX)
-          +
-          (((r*vr + ym)>>MW_MIX_FIX)<<16)
-          );
-
-      ct += stp;
       if (ct >= end) {
         if (!loop) {
-          --n;
+          dma_stop(mw);
           break;
         } else {
-          mwct_t overflow = ct-end;
-          mwct_t length   = end-base;
+          const mwct_t base     = mw_counter_read(mw, MW_BASH);
+          const mwct_t overflow = ct - end;
+          const mwct_t length   = end - base;
           ct  = base;
           if (length) {
-            ct += overflow>length ? overflow%length : overflow;
+            ct += overflow > length ? overflow % length : overflow;
           }
-          end = end2;
+          end = mw_counter_read(mw, MW_ENDH);
         }
       }
-    } while (--n);
+      mw->ct  = ct;
+      mw->end = end;
+    } while (i < n);
   }
 
-  out:
-  if (!loop && ct >= end) {
-    mw->map[MW_ACTI] = 0;
-    ct  = base;
-    end = end2;
+  /* Finish the buffer */
+  if (i < n) {
+    memset(l+i, 0, (n-i) * sizeof(*l));
+    if (!mono)
+      memset(r+i, 0, (n-i) * sizeof(*r));
   }
-  mw->ct  = ct;
-  mw->end = end;
+  return mono ? l : r;
+}
 
-  /* Finish the buffer */
-  if (n>0) {
-    no_mix_ste(mw,b,n);
+/* Blend n DMA samples with the YM samples in b, apply the LMC tone
+ * controls and pack to 16-bit stereo into b, or store unclipped
+ * left/right pairs into wide.
+ */
+static void mix_block(mw_t * const mw, s32 * b, s32 * wide, s32 * dma,
+                      const s32 * l, const s32 * r, const int n)
+{
+  const int vl = _VOL(left);
+  const int vr = _VOL(right);
+  const int ym_mult = (mw->db_conv == Db_alone) ? 0 : MW_YM_MULT;
+  s32 lo[MW_MIX_BLOCK], ro[MW_MIX_BLOCK];
+  int i;
+
+  if (dma)
+    for (i = 0; i < n; ++i)
+      dma[i] = (u16) ( ( l[i] * vl ) >> MW_MIX_FIX )
+        | ( (u32) ( ( r[i] * vr ) >> MW_MIX_FIX ) << 16 );
+
+  if (mw->tone_hz != mw->hz)
+    tone_setup(mw);
+
+  if (!mw->tone_on && !wide) {
+    /* Flat tone : blend and pack in a single pass. */
+    for (i = 0; i < n; ++i) {
+      const int ym = b[i] * ym_mult;
+      b[i] = (u16) ( ( l[i] * vl + ym ) >> MW_MIX_FIX )
+        | ( (u32) ( ( r[i] * vr + ym ) >> MW_MIX_FIX ) << 16 );
+    }
+  } else {
+    for (i = 0; i < n; ++i) {
+      const int ym = b[i] * ym_mult;
+      lo[i] = ( l[i] * vl + ym ) >> MW_MIX_FIX;
+      ro[i] = ( r[i] * vr + ym ) >> MW_MIX_FIX;
+    }
+    if (mw->tone_on & 1) {
+      tone_filter(mw->tone+0, lo, 0, n);
+      tone_filter(mw->tone+0, ro, 1, n);
+    }
+    if (mw->tone_on & 2) {
+      tone_filter(mw->tone+1, lo, 0, n);
+      tone_filter(mw->tone+1, ro, 1, n);
+    }
+    if (wide)
+      for (i = 0; i < n; ++i) {
+        *wide++ = lo[i];
+        *wide++ = ro[i];
+      }
+    else
+      for (i = 0; i < n; ++i) {
+        const int cl = lo[i] < -32768 ? -32768 : lo[i] > 32767 ? 32767 : lo[i];
+        const int cr = ro[i] < -32768 ? -32768 : ro[i] > 32767 ? 32767 : ro[i];
+        b[i] = (u16) cl | ( (u32) cr << 16 );
+      }
   }
 }
 
+/* Sample index of an access (clipped to n). */
+static inline int event_pos(const mw_t * const mw,
+                            const mw_event_t * const ev, const int n)
+{
+  const u64 pos = mw->clock
+    ? (u64) ev->cycle * mw->hz / mw->clock
+    : 0
+    ;
+  return pos < (u64) n ? (int) pos : n;
+}
+
 /* ,-----------------------------------------------------------------.
  * |                      STE sound process                          |
  * `-----------------------------------------------------------------'
  */
 
-void mw_mix(mw_t * const mw, s32 * b, int n)
+static void mix(mw_t * const mw, s32 * b, s32 * wide, s32 * dma, int n)
 {
+  const mw_event_t * ev = mw->event_buf;
+  s32 l[MW_MIX_BLOCK], r[MW_MIX_BLOCK];
+  int k, m, pos = n;
+
   if ( n <= 0 ) {
     return;
   }
+
   if ( !b ) {
+    flush_events(mw);
     if ( mw->map[MW_ACTI] & 1 ) {
       /* no buffer and active : advance counters only */
       skip_ste(mw,n);
     }
-  } else if ( ! (mw->map[MW_ACTI] & 1 ) ) {
-    /* Microwire desactivated */
-    no_mix_ste(mw,b,n);
-  } else {
-    /* Microwire activated */
-    mix_ste(mw,b,n);
+    if ( dma )
+      memset(dma, 0, n * sizeof(*dma));
+    return;
+  }
+
+  /* Mix by blocks, split at the register accesses. */
+  dma_check(mw);
+  for (k = 0; k < n; k += m) {
+    const s32 * rr;
+
+    if (ev < mw->event_ptr && (pos = event_pos(mw, ev, n)) <= k) {
+      /* Apply the register accesses occurring at this sample. */
+      do {
+        write_hw(mw, ev++);
+      } while (ev < mw->event_ptr && (pos = event_pos(mw, ev, n)) <= k);
+      dma_check(mw);
+    }
+
+    m = n - k;
+    if (m > MW_MIX_BLOCK)
+      m = MW_MIX_BLOCK;
+    if (ev < mw->event_ptr && m > pos - k)
+      m = pos - k;
+
+    rr = fetch_dma(mw, l, r, m);
+    mix_block(mw, b+k, wide ? wide+2*k : 0, dma ? dma+k : 0, l, rr, m);
   }
+
+  /* Accesses at or past the end of the buffer. */
+  while (ev < mw->event_ptr)
+    write_hw(mw, ev++);
+  mw->event_ptr = mw->event_buf;
+}
+
+void mw_mix(mw_t * const mw, s32 * b, int n)
+{
+  mix(mw, b, 0, 0, n);
+}
+
+void mw_mix_stems(mw_t * const mw, s32 * b, s32 * dma, int n)
+{
+  mix(mw, b, 0, dma, n);
+}
+
+void mw_mix_wide(mw_t * const mw, s32 * b, s32 * wide, s32 * dma, int n)
+{
+  mix(mw, b, wide, dma, n);
 }
@@ -149,6 +149,7 @@ typedef struct {
   mw_parms_t parms; /**< configuration parameters.           */
   u8 * mem;         /**< 68K memory buffer.                  */
   int log2mem;      /**< 68K memory buffer size (2^log2mem). */
+  uint_t clock;     /**< Event cycles frequency (CPU clock). */
 } mw_setup_t;
 
 /**
@@ -161,11 +162,34 @@ typedef struct {
  */
 typedef uint68_t mwct_t;
 
+/**
+ * Microwire event (write access) structure.
+ *
+ *   For MW_DATA the value is the decoded LMC command (9 bits).
+ */
+typedef struct {
+  cycle68_t cycle;  /**< Cycle this access occurs.     */
+  u8        reg;    /**< Register to write into.       */
+  u16       val;    /**< Value to write.               */
+} mw_event_t;
+
+/**
+ * LMC tone control biquad filter.
+ */
+typedef struct {
+  s32 b0, b1, b2;   /**< Feed forward coefficients (MW_BQ_FIX).  */
+  s32 a1, a2;       /**< Feedback coefficients (MW_BQ_FIX).      */
+  s32 x[2][2];      /**< Left/right input history.               */
+  s32 y[2][2];      /**< Left/right output history.              */
+  s32 e[2][2];      /**< Left/right rounding error history.      */
+} mw_biquad_t;
+
 /**
  * Microwire emulator instance.
  */
 typedef struct {
-  u8 map[0x40];   /**< STE register array.                          */
+  u8 map[0x40];   /**< STE register array (hardware side).          */
+  u8 shadow[0x40];/**< STE register array (CPU side).               */
   mwct_t ct;      /**< DMA current location (ct_fix fixed point).   */
   mwct_t end;     /**< DMA end point location (ct_fix fixed point). */
 
@@ -176,8 +200,8 @@ typedef struct {
     u8 left;   /**< Left volume.               */
     u8 right;  /**< Right volume.              */
     u8 lr;     /**< Left/Right average volume. */
-    u8 high;   /**< High pass filter.          */
-    u8 low;    /**< Low pass filter.           */
+    u8 high;   /**< Treble attenuation.        */
+    u8 low;    /**< Bass attenuation.          */
     u8 mixer;  /**< Mixer mode.                */
     u8 align;  /**< reserved for struct align. */
   } lmc;
@@ -188,7 +212,29 @@ typedef struct {
   int ct_fix;         /**< fixed point for automatic memory modulo. */
   const u8 * mem;     /**< 68000 memory buffer.                     */
   int log2mem;        /**< Size of 68K memory (2^log2mem).          */
-
+  uint_t clock;       /**< Event cycles frequency (CPU clock).      */
+
+  /**
+   * @name  LMC tone control.
+   * @{
+   */
+  int tone_hz;        /**< Sampling rate of the coefficients (0:dirty). */
+  int tone_on;        /**< Bit#0:bass, bit#1:treble not flat.           */
+  mw_biquad_t tone[2];/**< Bass and treble shelving filters.            */
+  /**
+   * @}
+   */
+
+  /**
+   * @name  Events (Write access) storage.
+   * @{
+   */
+  mw_event_t * event_ptr;      /**< Current entry in event.  */
+  unsigned int event_ovf;      /**< Count overflows.         */
+  mw_event_t   event_buf[256]; /**< Pre-allocated accesses.  */
+  /**
+   * @}
+   */
 } mw_t;
 
 
@@ -293,6 +339,39 @@ IO68_EXTERN
  */
 int mw_reset(mw_t * const mw);
 
+IO68_EXTERN
+/**
+ * Write in a microwire register.
+ *
+ *   The mw_writereg() function performs a byte write access to a
+ *   microwire register, or a word write access for MW_DATA and
+ *   MW_CTRL. The CPU side registers are updated immediately. The
+ *   hardware side changes (DMA control, mode, frame addresses and LMC
+ *   commands) are stored with their cycle stamp and applied by
+ *   mw_mix() at the matching sample.
+ *
+ * @param  mw     microwire instance
+ * @param  reg    register (offset from the microwire base address)
+ * @param  val    value to write
+ * @param  cycle  cycle the access occurs (relative to the beginning
+ *                of the next mw_mix() call)
+ */
+void mw_writereg(mw_t * const mw, const int reg, const int val,
+                 const cycle68_t cycle);
+
+IO68_EXTERN
+/**
+ * Change microwire cycle counter base.
+ *
+ *   The mw_adjust_cycle() function subtracts cycles to the cycle
+ *   stamp of the pending accesses. Accesses that occur before the
+ *   new base are moved to the base.
+ *
+ * @param  mw      microwire instance
+ * @param  cycles  number of cycles to subtract
+ */
+void mw_adjust_cycle(mw_t * const mw, const cycle68_t cycles);
+
 IO68_EXTERN
 /**
  * Execute microwire emulation.
@@ -305,7 +384,9 @@ IO68_EXTERN
  *   emulator to honnor the LMC mixer mode.iven LMC mode. This
  *   porocess include the mono to stereo expansion. The mem68 starting
  *   pointer locates the 68K memory buffer where samples are stored to
- *   allow DMA fetch emulation.
+ *   allow DMA fetch emulation. Pending register accesses are applied
+ *   when the mixing reaches their cycle stamp. The LMC bass and
+ *   treble controls are applied to the mixed output.
  *
  * @param  mw     microwire instance
  * @param  out    pointer to YM-2149 source sample directly used for
@@ -316,6 +397,46 @@ IO68_EXTERN
  */
 void mw_mix(mw_t * const mw, s32 * out, int n);
 
+IO68_EXTERN
+/**
+ * Execute microwire emulation with a separate DMA output.
+ *
+ *   The mw_mix_stems() function is the same as mw_mix() but it also
+ *   stores the DMA sound contribution alone (with the LMC volumes
+ *   applied but before the tone controls) in the dma buffer. When the DMA is not running the dma
+ *   buffer is cleared.
+ *
+ * @param  mw     microwire instance
+ * @param  out    pointer to YM-2149 source sample directly used for
+ *                microwire output mixing.
+ * @param  dma    DMA only output buffer (0 for none)
+ * @param  n      number of sample to mix in out buffer
+ *
+ * @see mw_mix()
+ */
+void mw_mix_stems(mw_t * const mw, s32 * out, s32 * dma, int n);
+
+IO68_EXTERN
+/**
+ * Execute microwire emulation with an unclipped output.
+ *
+ *   The mw_mix_wide() function is the same as mw_mix_stems() but
+ *   the mix is neither clipped nor packed to 16-bit stereo. It is
+ *   stored in the wide buffer as pairs of 32 bit integers (left then
+ *   right) at the 16-bit scale, so that it can exceed the 16-bit
+ *   range. The out buffer only provides the YM-2149 samples and is
+ *   left unchanged.
+ *
+ * @param  mw     microwire instance
+ * @param  out    pointer to YM-2149 source samples.
+ * @param  wide   output buffer (at least 2*n values)
+ * @param  dma    DMA only output buffer (0 for none)
+ * @param  n      number of sample to mix
+ *
+ * @see mw_mix_stems()
+ */
+void mw_mix_wide(mw_t * const mw, s32 * out, s32 * wide, s32 * dma, int n);
+
 /**
  * @}
  */
@@ -382,30 +503,27 @@ int mw_lmc_right(mw_t * const mw, int n);
 
 IO68_EXTERN
 /**
- * Set/Get high pass filter.
+ * Set/Get treble (high shelving filter at 15 kHz).
  *
  * @param   mw  microwire instance
-
- * @param    n  @ref mw_lmc_e "high pass filter" in range [0..12] for
- *              [-12..0] dB
- * @return      @ref mw_lmc_e "high pass filter"
+ * @param    n  @ref mw_lmc_e "treble" in range [0..12] for
+ *              [-12..+12] dB (6 is flat)
+ * @return      @ref mw_lmc_e "treble"
  *
  * @see      mw_lmc_low()
- * @warning  Filters are not supported by this microwire emulator.
  */
 int mw_lmc_high(mw_t * const mw, int n);
 
 IO68_EXTERN
 /**
- * Set/Get low pass filter.
+ * Set/Get bass (low shelving filter at 50 Hz).
  *
  * @param   mw  microwire instance
- * @param    n  @ref mw_lmc_e "low pass filter" in range [0..12]
- *              for [-12..0] dB
- * @return      @ref mw_lmc_e "low pass filter"
+ * @param    n  @ref mw_lmc_e "bass" in range [0..12] for
+ *              [-12..+12] dB (6 is flat)
+ * @return      @ref mw_lmc_e "bass"
  *
  * @see      mw_lmc_high()
- * @warning  Filters are not supported by this microwire emulator.
  */
 int mw_lmc_low(mw_t * const mw,int n);
 
@@ -413,6 +531,10 @@ IO68_EXTERN
 /**
  * Parse and execute a microwire command.
  *
+ *   The mw_command() function decodes the CPU side MW_DATA and
+ *   MW_CTRL registers and executes the command immediately on the
+ *   emulated hardware.
+ *
  * @param   mw  microwire instance
  * @retval  0 on success (a command was found)
  * @retval -1 on error
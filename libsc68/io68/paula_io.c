@@ -34,27 +34,15 @@ typedef struct {
   paula_t paula;
 } paula_io68_t;
 
-static void reload(paulav_t * const v, const u8 * const p, const int fix);
-
-static inline int clearset(const int v, const int clrset)
+/* Convert cpu-cycle to paula-cycle. */
+static inline
+cycle68_t cycle_cputopaula(const paula_io68_t * const paulaio,
+                           const cycle68_t cycle)
 {
-  if (clrset & 0x8000) {
-    return (v | clrset) & 0x7FFF;
-  } else {
-    return v & ~clrset;
-  }
-}
-
-static inline int DMACON(const int dmacon) {
-  return (-!!(dmacon&(1<<9))) & dmacon & 0xF;
-}
-
-static inline int INTREQ(const int intreq) {
-  return intreq & (0xF<<7);
-}
-
-static inline int INTENA(const int intena) {
-  return (-!!(intena&(1<<14))) & intena & (0xF<<7);
+  u64 cycle64 = cycle;
+  cycle64 *= paula_clock_frq(&paulaio->paula);
+  cycle64 /= paulaio->io.emu68->clock;
+  return (cycle68_t) cycle64;
 }
 
 /* $$$ I am not sure what really happen in case of byte access on the
@@ -80,35 +68,35 @@ static int68_t _paula_readB(paula_io68_t * const paulaio,
     break;
 
   case PAULA_DMACONRH:
-    v = /* paula->map[PAULA_DMACONRH] = */ (paula->dmacon>>8)&0x7f;
+    v = /* paula->map[PAULA_DMACONRH] = */ (paula->shadow.dmacon>>8)&0x7f;
     break;
   case PAULA_DMACONRL:
-    v = /* paula->map[PAULA_DMACONRL] = */ (u8)paula->dmacon;
+    v = /* paula->map[PAULA_DMACONRL] = */ (u8)paula->shadow.dmacon;
     break;
 
   case PAULA_INTENARH:
-    v = /* paula->map[PAULA_INTENARH] =  */(paula->intena>>8)&0x7f;
+    v = /* paula->map[PAULA_INTENARH] =  */(paula->shadow.intena>>8)&0x7f;
     break;
   case PAULA_INTENARL:
-    v = /* paula->map[PAULA_INTENARL] =  */(u8)paula->intena;
+    v = /* paula->map[PAULA_INTENARL] =  */(u8)paula->shadow.intena;
     break;
 
   case PAULA_INTREQRH:
-    v = /* paula->map[PAULA_INTREQRH] =  */(paula->intreq>>8)&0x7f;
+    v = /* paula->map[PAULA_INTREQRH] =  */(paula->shadow.intreq>>8)&0x7f;
     break;
   case PAULA_INTREQRL:
-    v = /* paula->map[PAULA_INTREQRL] =  */(u8)paula->intreq;
+    v = /* paula->map[PAULA_INTREQRL] =  */(u8)paula->shadow.intreq;
     break;
 
   case PAULA_ADKCONRH:
-    v = /* paula->map[PAULA_ADKCONRH] =  */(paula->adkcon>>8)&0x7f;
+    v = /* paula->map[PAULA_ADKCONRH] =  */(paula->shadow.adkcon>>8)&0x7f;
     break;
   case PAULA_ADKCONRL:
-    v = /* paula->map[PAULA_ADKCONRL] =  */(u8)paula->adkcon;
+    v = /* paula->map[PAULA_ADKCONRL] =  */(u8)paula->shadow.adkcon;
     break;
 
   default:
-    v = paula->map[i];
+    v = paula->shadow.map[i];
     break;
   }
   return v;
@@ -123,19 +111,19 @@ static int68_t _paula_readW(paula_io68_t * const paulaio,
 
   switch (i) {
   case PAULA_DMACONR:
-    v =  paula->dmacon & 0x7fff;
+    v =  paula->shadow.dmacon & 0x7fff;
     break;
   case PAULA_INTENAR:
-    v =  paula->intena & 0x7fff;
+    v =  paula->shadow.intena & 0x7fff;
     break;
   case PAULA_INTREQR:
-    v =  paula->intreq & 0x7fff;
+    v =  paula->shadow.intreq & 0x7fff;
     break;
   case PAULA_ADKCON:
-    v =  paula->adkcon & 0x7fff;
+    v =  paula->shadow.adkcon & 0x7fff;
     break;
   default:
-    v = (paula->map[i]<<8) | paula->map[i+1];
+    v = (paula->shadow.map[i]<<8) | paula->shadow.map[i+1];
     break;
   }
   return v;
@@ -161,156 +149,18 @@ static void paulaio_readL(io68_t * const io)
     ;
 }
 
-#if 0
-/* start DMA on voice n ( DMA disable -> enable ) */
-static void start_DMA(paula_t * const paula, const int bit)
-{
-  int old,chg,cur;
-
-  old = DMACON(paula->dmacon);
-  paula->dmacon |= bit;
-  cur = DMACON(paula->dmacon);
-  chg = cur & ~old;
-
-  if (chg&1) reload(paula->voice+0, paula->map+PAULA_VOICEA, paula->ct_fix);
-  if (chg&2) reload(paula->voice+1, paula->map+PAULA_VOICEB, paula->ct_fix);
-  if (chg&4) reload(paula->voice+2, paula->map+PAULA_VOICEC, paula->ct_fix);
-  if (chg&8) reload(paula->voice+3, paula->map+PAULA_VOICED, paula->ct_fix);
-}
-#endif
-
-/* stop DMA bit to be stopped */
-static inline void stop_DMA(paula_t * const paula, const int bit)
-{
-  paula->dmacon &= ~bit;
-}
-
-/* Reload paula internal register with current value */
-static void reload(paulav_t * const v, const u8 * const p, const int fix)
-{
-  plct_t len;
-
-  v->start = v->adr = (plct_t) ( (p[1]<<16) | (p[2]<<8) | (p[3]&0xFE) ) << fix;
-  len = (p[4]<<8) | p[5];
-  len |= (!len) << 16;
-  len <<= 1+fix;
-  v->end = v->start + len;
-}
-
-/* Write INTREQ :
- *
- * - If clearing bits just release the interrupt. Nothing more to do.
- * - If setting bit checks whether the interrupt is denied or not.
- *   When denied it seems that the internal pointer and length register
- *   are reloaded however its is not an official practice.
- */
-static void write_intreq(paula_t * const paula, const int intreq)
-{
-  if ( !(intreq & 0x8000) ) {
-    /* Clearing ... */
-    paula->intreq &= ~intreq;
-    return;
-  } else {
-    int intdenied;
-
-    /* Master interrupt not set : DENIED */
-    intdenied = ~INTENA(paula->intena);
-    /* Already requested : DENIED */
-    intdenied |= paula->intreq;
-    /* Only interrested by requested bits */
-    intdenied &= intreq;
-    /* Reload for each denied channel */
-
-    /* $$$ May be should not reload if DMA is OFF $$$ */
-
-    if(intdenied & (1<< 7))
-      reload(paula->voice+0, paula->map+PAULA_VOICEA, paula->ct_fix);
-    if(intdenied & (1<< 8))
-      reload(paula->voice+1, paula->map+PAULA_VOICEB, paula->ct_fix);
-    if(intdenied & (1<< 9))
-      reload(paula->voice+2, paula->map+PAULA_VOICEC, paula->ct_fix);
-    if(intdenied & (1<<10))
-      reload(paula->voice+3, paula->map+PAULA_VOICED, paula->ct_fix);
-
-    paula->intreq |= intreq;
-  }
-}
-
 static void _paula_writeB(paula_io68_t * const paulaio,
                           addr68_t const addr, const int68_t data)
 {
-  const int i = (u8)addr;
-  paula_t * const paula = &paulaio->paula;
-
-  paula->map[i] = data;
-  switch (i) {
-
-  case PAULA_INTREQL:
-    write_intreq(paula,
-                 ( paula->map[PAULA_INTREQH] << 8 )
-                 |
-                 paula->map[PAULA_INTREQL] );
-    break;
-
-  }
+  paula_writereg(&paulaio->paula, (u8) addr, (u8) data, 1,
+                 cycle_cputopaula(paulaio, paulaio->io.emu68->cycle));
 }
 
 static void _paula_writeW(paula_io68_t * const paulaio,
                           addr68_t const addr, const int68_t data)
 {
-  const int i = (u8) addr;
-  paula_t * const paula = &paulaio->paula;
-  const int v = (u16) data;
-
-  /* Copy into hw-reg */
-  paula->map[i] = v >> 8;
-  paula->map[(u8)(i+1)] = v;
-
-  switch (i) {
-  case PAULA_ADKCON: {
-    int old_adkcon = paula->adkcon;
-    paula->adkcon = clearset(old_adkcon, v);
-    if (paula->adkcon & ~old_adkcon & 0xFF) {
-      /* Modulation is active !!! */
-    }
-  } break;
-
-  case PAULA_DMACON: {
-    int old_dmacon = paula->dmacon;
-    int old_dmaena = DMACON(old_dmacon);
-    int new_dmaena;
-    int start;
-
-    paula->dmacon = clearset(old_dmacon, v);
-    new_dmaena = DMACON(paula->dmacon);
-
-    start = new_dmaena & ~old_dmaena;
-
-    if (start&1) reload(paula->voice+0,paula->map+PAULA_VOICEA,paula->ct_fix);
-    if (start&2) reload(paula->voice+1,paula->map+PAULA_VOICEB,paula->ct_fix);
-    if (start&4) reload(paula->voice+2,paula->map+PAULA_VOICEC,paula->ct_fix);
-    if (start&8) reload(paula->voice+3,paula->map+PAULA_VOICED,paula->ct_fix);
-
-  } break;
-
-  case PAULA_INTENA: {
-    int old_intena = INTENA(paula->intena), new_intena;
-    old_intena=old_intena;
-    paula->intena = clearset(paula->intena, v);
-    new_intena = INTENA(paula->intena);
-
-    if ( new_intena & ~old_intena ) {
-      /*Amiga Audio IRQ enabled */
-    }
-  } break;
-
-  case PAULA_INTREQ:
-    write_intreq(paula, v);
-    break;
-
-  default:
-    break;
-  }
+  paula_writereg(&paulaio->paula, (u8) addr, (u16) data, 2,
+                 cycle_cputopaula(paulaio, paulaio->io.emu68->cycle));
 }
 
 static void paulaio_writeB(io68_t * const io)
@@ -345,6 +195,8 @@ static cycle68_t paulaio_next_interrupt(io68_t * const io, cycle68_t cycle)
 
 static void paulaio_adjust_cycle(io68_t * const io, cycle68_t cycle)
 {
+  paula_io68_t * const paulaio = (paula_io68_t *)io;
+  paula_adjust_cycle(&paulaio->paula, cycle_cputopaula(paulaio, cycle));
 }
 
 static int paulaio_reset(io68_t * const io)
@@ -46,9 +46,12 @@ int pl_cat = msg68_DEFAULT;
 static paula_parms_t default_parms;
 
 
-static int msw_first = 0;           /* big/little endian compliance */
 static int pl_chans  = 15;          /* active channels */
 
+enum {
+  PAULA_MIX_BLOCK = 512             /* samples mixed per block */
+};
+
 static int onchange_filter(const option68_t * opt, value68_t * val)
 {
   paula_engine(0,!val->num?PAULA_ENGINE_SIMPLE:PAULA_ENGINE_LINEAR);
@@ -95,14 +98,9 @@ static option68_t opts[] = {
 
 int paula_init(int * argc, char ** argv)
 {
-  static const u32 msw = 0x1234;
-
   if (pl_cat == msg68_DEFAULT)
     pl_cat = msg68_cat("paula","amiga sound emulator", DEBUG_PL_O);
 
-  /* Setup little/big endian swap */
-  msw_first = !(*(const u8 *)&msw);
-
   /* Set default default */
   default_parms.engine = PAULA_ENGINE_SIMPLE;
   default_parms.clock  = PAULA_CLOCK_PAL;
@@ -292,10 +290,28 @@ int paula_reset(paula_t * const paula)
   paula->intena = 1 << 14; /* Master interrupt enable, audio int disable.  */
   paula->adkcon = 0;       /* No modulation.                               */
 
+  /* CPU side registers are the same. */
+  for (i=0; i<sizeof(paula->map); i++) {
+    paula->shadow.map[i] = paula->map[i];
+  }
+  paula->shadow.dmacon = paula->dmacon;
+  paula->shadow.intreq = paula->intreq;
+  paula->shadow.intena = paula->intena;
+  paula->shadow.adkcon = paula->adkcon;
+
+  /* Discard pending accesses. */
+  paula->event_ptr = paula->event_buf;
+  paula->event_ovf = 0;
+
   return 0;
 }
 
-void paula_cleanup(paula_t * const paula) {}
+void paula_cleanup(paula_t * const paula)
+{
+  if (paula && paula->event_ovf)
+    TRACE68(pl_cat, PLHD "write access buffer has overflow -- *%u*\n",
+            paula->event_ovf);
+}
 
 int paula_setup(paula_t * const paula,
                 paula_setup_t * const setup)
@@ -331,6 +347,222 @@ int paula_setup(paula_t * const paula,
   return 0;
 }
 
+uint68_t paula_clock_frq(const paula_t * const paula)
+{
+  return paula->clock == PAULA_CLOCK_NTSC
+    ? PAULA_NTSC_FRQ
+    : PAULA_PAL_FRQ
+    ;
+}
+
+/* ,-----------------------------------------------------------------.
+ * |                      Write Paula register                       |
+ * `-----------------------------------------------------------------'
+ */
+
+#define ELTOF(A) ( sizeof(A) / sizeof(*A) )
+
+static inline int clearset(const int v, const int clrset)
+{
+  if (clrset & 0x8000) {
+    return (v | clrset) & 0x7FFF;
+  } else {
+    return v & ~clrset;
+  }
+}
+
+static inline int DMACON(const int dmacon) {
+  return (-!!(dmacon&(1<<9))) & dmacon & 0xF;
+}
+
+static inline int INTENA(const int intena) {
+  return (-!!(intena&(1<<14))) & intena & (0xF<<7);
+}
+
+/* Reload paula internal register with current value */
+static void reload(paulav_t * const v, const u8 * const p, const int fix)
+{
+  plct_t len;
+
+  v->start = v->adr = (plct_t) ( (p[1]<<16) | (p[2]<<8) | (p[3]&0xFE) ) << fix;
+  len = (p[4]<<8) | p[5];
+  len |= (!len) << 16;
+  len <<= 1+fix;
+  v->end = v->start + len;
+}
+
+/* Write INTREQ :
+ *
+ * - If clearing bits just release the interrupt. Nothing more to do.
+ * - If setting bit checks whether the interrupt is denied or not.
+ *   When denied it seems that the internal pointer and length register
+ *   are reloaded however its is not an official practice.
+ */
+static void write_intreq(paula_t * const paula, const int intreq)
+{
+  if ( !(intreq & 0x8000) ) {
+    /* Clearing ... */
+    paula->intreq &= ~intreq;
+    return;
+  } else {
+    int intdenied;
+
+    /* Master interrupt not set : DENIED */
+    intdenied = ~INTENA(paula->intena);
+    /* Already requested : DENIED */
+    intdenied |= paula->intreq;
+    /* Only interrested by requested bits */
+    intdenied &= intreq;
+    /* Reload for each denied channel */
+
+    /* $$$ May be should not reload if DMA is OFF $$$ */
+
+    if(intdenied & (1<< 7))
+      reload(paula->voice+0, paula->map+PAULA_VOICEA, paula->ct_fix);
+    if(intdenied & (1<< 8))
+      reload(paula->voice+1, paula->map+PAULA_VOICEB, paula->ct_fix);
+    if(intdenied & (1<< 9))
+      reload(paula->voice+2, paula->map+PAULA_VOICEC, paula->ct_fix);
+    if(intdenied & (1<<10))
+      reload(paula->voice+3, paula->map+PAULA_VOICED, paula->ct_fix);
+
+    paula->intreq |= intreq;
+  }
+}
+
+/* Apply a write access to the emulated hardware. */
+static void write_hw(paula_t * const paula, const paula_event_t * const ev)
+{
+  const int i = ev->reg;
+  const int v = ev->val;
+
+  if (ev->len == 1) {
+    paula->map[i] = v;
+    if (i == PAULA_INTREQL)
+      write_intreq(paula,
+                   ( paula->map[PAULA_INTREQH] << 8 )
+                   |
+                   paula->map[PAULA_INTREQL] );
+    return;
+  }
+
+  /* Copy into hw-reg */
+  paula->map[i] = v >> 8;
+  paula->map[(u8)(i+1)] = v;
+
+  switch (i) {
+  case PAULA_ADKCON: {
+    int old_adkcon = paula->adkcon;
+    paula->adkcon = clearset(old_adkcon, v);
+    if (paula->adkcon & ~old_adkcon & 0xFF) {
+      /* Modulation is active !!! */
+    }
+  } break;
+
+  case PAULA_DMACON: {
+    int old_dmacon = paula->dmacon;
+    int old_dmaena = DMACON(old_dmacon);
+    int new_dmaena;
+    int start;
+
+    paula->dmacon = clearset(old_dmacon, v);
+    new_dmaena = DMACON(paula->dmacon);
+
+    start = new_dmaena & ~old_dmaena;
+
+    if (start&1) reload(paula->voice+0,paula->map+PAULA_VOICEA,paula->ct_fix);
+    if (start&2) reload(paula->voice+1,paula->map+PAULA_VOICEB,paula->ct_fix);
+    if (start&4) reload(paula->voice+2,paula->map+PAULA_VOICEC,paula->ct_fix);
+    if (start&8) reload(paula->voice+3,paula->map+PAULA_VOICED,paula->ct_fix);
+
+  } break;
+
+  case PAULA_INTENA: {
+    int old_intena = INTENA(paula->intena), new_intena;
+    old_intena=old_intena;
+    paula->intena = clearset(paula->intena, v);
+    new_intena = INTENA(paula->intena);
+
+    if ( new_intena & ~old_intena ) {
+      /*Amiga Audio IRQ enabled */
+    }
+  } break;
+
+  case PAULA_INTREQ:
+    write_intreq(paula, v);
+    break;
+
+  default:
+    break;
+  }
+}
+
+/* Apply all pending accesses. */
+static void flush_events(paula_t * const paula)
+{
+  const paula_event_t * ev;
+
+  for (ev = paula->event_buf; ev < paula->event_ptr; ++ev)
+    write_hw(paula, ev);
+  paula->event_ptr = paula->event_buf;
+}
+
+void paula_writereg(paula_t * const paula, const int reg, const int val,
+                    const int len, const cycle68_t cycle)
+{
+  const paula_event_t * const event_end =
+    paula->event_buf + ELTOF(paula->event_buf);
+  const int i = (u8) reg;
+  paula_event_t * ev;
+
+  /* CPU side */
+  if (len == 1) {
+    paula->shadow.map[i] = val;
+    if (i == PAULA_INTREQL)
+      paula->shadow.intreq =
+        clearset(paula->shadow.intreq,
+                 ( paula->shadow.map[PAULA_INTREQH] << 8 ) | (u8) val );
+  } else {
+    const int v = (u16) val;
+    paula->shadow.map[i] = v >> 8;
+    paula->shadow.map[(u8)(i+1)] = v;
+    switch (i) {
+    case PAULA_ADKCON:
+      paula->shadow.adkcon = clearset(paula->shadow.adkcon, v);
+      break;
+    case PAULA_DMACON:
+      paula->shadow.dmacon = clearset(paula->shadow.dmacon, v);
+      break;
+    case PAULA_INTENA:
+      paula->shadow.intena = clearset(paula->shadow.intena, v);
+      break;
+    case PAULA_INTREQ:
+      paula->shadow.intreq = clearset(paula->shadow.intreq, v);
+      break;
+    }
+  }
+
+  /* Hardware side */
+  if (paula->event_ptr >= event_end) {
+    /* No more room: catch up with all pending accesses. */
+    ++paula->event_ovf;
+    flush_events(paula);
+  }
+  ev = paula->event_ptr++;
+  ev->cycle = cycle;
+  ev->reg   = i;
+  ev->len   = len == 1 ? 1 : 2;
+  ev->val   = val;
+}
+
+void paula_adjust_cycle(paula_t * const paula, const cycle68_t cycles)
+{
+  paula_event_t * ev;
+
+  for (ev = paula->event_buf; ev < paula->event_ptr; ++ev)
+    ev->cycle = ev->cycle > cycles ? ev->cycle - cycles : 0;
+}
+
 #if 0
 static void poll_irq(paula_t * const paula, unsigned int N)
 {
@@ -359,16 +591,41 @@ static void poll_irq(paula_t * const paula, unsigned int N)
 }
 #endif
 
-/* Mix with laudio channel data (1 char instead of 2) */
+/* Mix m samples that do not reach the loop or end boundary. As the
+ * next sample can not wrap there is no test at all in the loop.
+ */
+static plct_t mix_block(s32 * acc, const u8 * const mem,
+                        plct_t adr, const plct_t stp,
+                        const plct_t imask, const int ct_fix,
+                        const int vol, int m)
+{
+  do {
+    const int idx = adr >> ct_fix;
+    const signed_plct_t v0 = (s8) mem[idx];
+    const signed_plct_t v1 = (s8) mem[idx+1];
+    const signed_plct_t low = adr & imask;
+
+    /* linear interpolation (or not if imask is zero) */
+    *acc++ += ( v0 + ( ( (v1 - v0) * low ) >> ct_fix ) ) * vol;
+    adr += stp;
+  } while (--m);
 
+  return adr;
+}
+
+/* Mix with laudio channel data (1 char instead of 2)
+ *
+ *   The voice is added to the acc planar buffer. Samples are
+ *   processed by blocks up to the next loop boundary. Only the
+ *   samples interpolating across the boundary go through the slow
+ *   path.
+ */
 static void mix_one(paula_t * const paula,
-                    int N, const int shift,
-                    s32 * b, int n)
+                    int N, s32 * acc, int n)
 {
   const u8 * const mem = paula->mem;
   paulav_t * const w   = paula->voice+N;
   u8       * const p   = paula->map+PAULA_VOICE(N);
-  s16      *       b2  = (s16 *)b + shift;
   const int     ct_fix = paula->ct_fix;
   plct_t adr, stp, readr, reend, end, vol, per;
   u8 last, hasloop;
@@ -419,35 +676,47 @@ static void mix_one(paula_t * const paula,
   if (end <= adr)
     return;
 
-  /* mix stereo */
   do {
-    int idx;
-    signed_plct_t low, v0, v1;
+    if (adr + one < end) {
+      /* Block of samples before the next sample wraps. */
+      plct_t m = !stp ? n : ( end - one - adr + stp - 1 ) / stp;
+      if (m > (plct_t) n)
+        m = n;
+      adr = mix_block(acc, mem, adr, stp, imask, ct_fix, vol, m);
+      acc += m;
+      n   -= m;
+      last = mem[(adr - stp) >> ct_fix];
+    } else {
+      /* Boundary sample */
+      int idx;
+      signed_plct_t low, v0, v1;
 
-    low = adr & imask;
-    idx = adr >> ct_fix;                /* current index         */
-    last = mem[idx++];                  /* save last sample read */
+      low = adr & imask;
+      idx = adr >> ct_fix;              /* current index         */
+      last = mem[idx++];                /* save last sample read */
 
-    if ( ( (plct_t) idx << ct_fix ) >= end )
-      idx = readr >> ct_fix;            /* loop index     */
-    v1 = (s8) mem[idx];                 /* next sample    */
-    v0 = (s8) last;                     /* current sample */
+      if ( ( (plct_t) idx << ct_fix ) >= end )
+        idx = readr >> ct_fix;          /* loop index     */
+      v1 = (s8) mem[idx];               /* next sample    */
+      v0 = (s8) last;                   /* current sample */
 
-    /* linear interpolation (or not if imask is zero) */
-    v0 = ( v1 * low + v0 * ( one - low ) ) >> ct_fix;
+      /* linear interpolation (or not if imask is zero) */
+      v0 = ( v1 * low + v0 * ( one - low ) ) >> ct_fix;
 
-    /* apply volume */
-    v0  *= vol;
+      /* apply volume */
+      v0  *= vol;
 
-    assert(v0 >= -16384);
-    assert(v0 <   16384);
+      assert(v0 >= -16384);
+      assert(v0 <   16384);
 
-    /* Store and advance output buffer */
-    *b2 += v0;
-    b2  += 2;
+      /* Store and advance output buffer */
+      *acc++ += v0;
+      --n;
+
+      /* Advance */
+      adr += stp;
+    }
 
-    /* Advance */
-    adr += stp;
     if (adr >= end) {
       plct_t relen = reend - readr;
       hasloop = 1;
@@ -457,7 +726,7 @@ static void mix_one(paula_t * const paula,
         adr -= relen;
       }
     }
-  } while (--n);
+  } while (n > 0);
 
   last &= 0xFF;
   p[0xA] = last + (last << 8);
@@ -483,6 +752,23 @@ static void clear_buffer(s32 * b, int n)
     } while (--n);
 }
 
+/* Interleave left and right planar buffers into 16-bit stereo PCM. */
+static void interleave(s32 * b, const s32 * l, const s32 * r, int n)
+{
+  do {
+    *b++ = (u16) *l++ | ( *r++ << 16 );
+  } while (--n);
+}
+
+/* Interleave left and right planar buffers into 32-bit pairs. */
+static void interleave_wide(s32 * b, const s32 * l, const s32 * r, int n)
+{
+  do {
+    *b++ = *l++;
+    *b++ = *r++;
+  } while (--n);
+}
+
 
 #if DEBUG_PL_O == 1
 
@@ -516,28 +802,90 @@ void paula_dbg(paulav_dbg_t * d, paula_t * const paula, int i)
 
 #endif
 
-void paula_mix(paula_t * const paula, s32 * splbuf, int n)
+/* Sample index of an access (clipped to n). */
+static inline int event_pos(const paula_event_t * const ev,
+                            const uint68_t hz, const uint68_t frq, const int n)
+{
+  const u64 pos = (u64) ev->cycle * hz / frq;
+  return pos < (u64) n ? (int) pos : n;
+}
+
+static void mix(paula_t * const paula, s32 * splbuf, s32 * wide,
+                s32 * const voices[4], int n)
 {
 
   if ( n > 0 ) {
     const int pl_mask = paula->chansptr ? *paula->chansptr : 15;
-    int i, b=0;
+    const uint68_t frq = paula_clock_frq(paula);
+    const paula_event_t * ev = paula->event_buf;
+    int i, k, m, pos = n, b=0;
+    s32 acc[2][PAULA_MIX_BLOCK], tmp[PAULA_MIX_BLOCK];
 #if DEBUG_PL_O == 1
     paulav_dbg_t d[4];
-#endif
-    clear_buffer(splbuf, n);
-    for (i=0; i<4; i++) {
-      /* $$$ VERIFY: channel mapping ABCD => LRRL ? */
-      const int right = (i^(i>>1)^msw_first)&1;
-#if DEBUG_PL_O == 1
+
+    for (i=0; i<4; i++)
       paula_dbg(d+i, paula, i);
 #endif
-      if ((paula->dmacon >> 9) & ( (pl_mask & paula->dmacon) >> i) & 1) {
-        mix_one(paula, i, right, splbuf, n);
-        b += 1 << i;
+
+    /* Voices are mixed into planar left/right accumulators by block
+     * and interleaved once at the end of each block.
+     */
+    for (k = 0; k < n; k += m) {
+      /* Apply the register accesses occurring at this sample. */
+      for ( ; ev < paula->event_ptr; ++ev) {
+        pos = event_pos(ev, paula->hz, frq, n);
+        if (pos > k)
+          break;
+        write_hw(paula, ev);
+      }
+
+      /* Mix up to the next access. */
+      m = n - k;
+      if (m > PAULA_MIX_BLOCK)
+        m = PAULA_MIX_BLOCK;
+      if (ev < paula->event_ptr && m > pos - k)
+        m = pos - k;
+      clear_buffer(acc[0], m);
+      clear_buffer(acc[1], m);
+
+      for (i=0; i<4; i++) {
+        /* $$$ VERIFY: channel mapping ABCD => LRRL ? */
+        const int right = (i^(i>>1))&1;
+        s32 * const stem = voices ? voices[i] : 0;
+        const int on =
+          (paula->dmacon >> 9) & ( (pl_mask & paula->dmacon) >> i) & 1;
+
+        if (!stem) {
+          if (on)
+            mix_one(paula, i, acc[right], m);
+        } else {
+          int j;
+          clear_buffer(tmp, m);
+          if (on) {
+            mix_one(paula, i, tmp, m);
+            for (j = 0; j < m; ++j)
+              acc[right][j] += tmp[j];
+          }
+          if (right)
+            for (j = 0; j < m; ++j)
+              stem[k+j] = tmp[j] << 16;
+          else
+            for (j = 0; j < m; ++j)
+              stem[k+j] = (u16) tmp[j];
+        }
+        b |= on << i;
       }
+      if (wide)
+        interleave_wide(wide + 2*k, acc[0], acc[1], m);
+      else
+        interleave(splbuf + k, acc[0], acc[1], m);
     }
 
+    /* Accesses at or past the end of the buffer. */
+    for ( ; ev < paula->event_ptr; ++ev)
+      write_hw(paula, ev);
+    paula->event_ptr = paula->event_buf;
+
 #if DEBUG_PL_O == 1
     if (1) {
 #   define ONE "%c:%06x-%06x->%06x,%04x,%02d"
@@ -554,3 +902,20 @@ void paula_mix(paula_t * const paula, s32 * splbuf, int n)
   /* HaxXx: assuming next mix is next frame reset beam V/H position. */
   paula->vhpos = 0;
 }
+
+void paula_mix(paula_t * const paula, s32 * splbuf, int n)
+{
+  mix(paula, splbuf, 0, 0, n);
+}
+
+void paula_mix_stems(paula_t * const paula, s32 * splbuf,
+                     s32 * const voices[4], int n)
+{
+  mix(paula, splbuf, 0, voices, n);
+}
+
+void paula_mix_wide(paula_t * const paula, s32 * wide,
+                    s32 * const voices[4], int n)
+{
+  mix(paula, 0, wide, voices, n);
+}
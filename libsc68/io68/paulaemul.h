@@ -205,6 +205,16 @@ typedef struct {
   plct_t end;   /**< end address (<<paula_t::ct_fix).            */
 } paulav_t;
 
+/**
+ * Paula event (write access) structure.
+ */
+typedef struct {
+  cycle68_t cycle;  /**< Paula cycle this access occurs. */
+  u8        reg;    /**< Paula register to write into.   */
+  u8        len;    /**< Access size (1:byte 2:word).    */
+  u16       val;    /**< Value to write.                 */
+} paula_event_t;
+
 /** Paula emulator data structure. */
 typedef struct {
   u8       map[256];   /**< Paula regiters mapping.              */
@@ -226,6 +236,37 @@ typedef struct {
   int      intreq;     /**< Shadow INTREQ. */
   int      adkcon;     /**< Shadow ADKCON. */
   int      vhpos;      /**< Shadow VHPOSR. */
+
+  /**
+   * @name  CPU side registers.
+   *
+   *   Register values as read back by the CPU. They are updated at
+   *   the time of the write access whereas the registers above are
+   *   only updated when the event is processed by the mixer.
+   *
+   * @{
+   */
+  struct {
+    u8  map[256];      /**< Paula registers mapping.             */
+    int dmacon;        /**< DMACON.                              */
+    int intena;        /**< INTENA.                              */
+    int intreq;        /**< INTREQ.                              */
+    int adkcon;        /**< ADKCON.                              */
+  } shadow;
+  /**
+   * @}
+   */
+
+  /**
+   * @name  Events (Write access) storage.
+   * @{
+   */
+  paula_event_t * event_ptr;      /**< Current entry in event.  */
+  unsigned int    event_ovf;      /**< Count overflows.         */
+  paula_event_t   event_buf[512]; /**< Pre-allocated accesses.  */
+  /**
+   * @}
+   */
 } paula_t;
 
 /**
@@ -383,6 +424,49 @@ int paula_sampling_rate(paula_t * const paula, int hz);
  * @{
  */
 
+IO68_EXTERN
+/**
+ * Write in Paula register.
+ *
+ *   The paula_writereg() function performs a write access to a Paula
+ *   register. The CPU side registers are updated immediately so that
+ *   they can be read back. The emulated hardware is not modified;
+ *   the access is stored with its cycle stamp and applied by
+ *   paula_mix() at the matching sample. If the event buffer is full
+ *   all pending accesses are applied at once.
+ *
+ * @param  paula  Paula emulator instance
+ * @param  reg    Register (offset from Paula base address)
+ * @param  val    Value to write
+ * @param  len    Access size (1:byte 2:word)
+ * @param  cycle  Paula cycle the access occurs (relative to the
+ *                beginning of the next paula_mix() call)
+ */
+void paula_writereg(paula_t * const paula, const int reg, const int val,
+                    const int len, const cycle68_t cycle);
+
+IO68_EXTERN
+/**
+ * Change Paula cycle counter base.
+ *
+ *   The paula_adjust_cycle() function subtracts cycles to the cycle
+ *   stamp of the pending accesses. Accesses that occur before the
+ *   new base are moved to the base.
+ *
+ * @param  paula   Paula emulator instance
+ * @param  cycles  Number of paula cycles to subtract
+ */
+void paula_adjust_cycle(paula_t * const paula, const cycle68_t cycles);
+
+IO68_EXTERN
+/**
+ * Get Paula clock frequency.
+ *
+ * @param  paula  Paula emulator instance
+ * @return Paula clock frequency in Hz
+ */
+uint68_t paula_clock_frq(const paula_t * const paula);
+
 IO68_EXTERN
 /**
  * Execute Paula emulation.
@@ -395,6 +479,10 @@ IO68_EXTERN
  *   RAM. This implies at leat 512Kb and PCM data must be in the first
  *   512Kb.
  *
+ *   Pending register accesses are applied when the mixing reaches
+ *   their cycle stamp. Cycle 0 is the first sample of splbuf. The
+ *   accesses past the end of the buffer are applied after it.
+ *
  * @param  paula   Paula emulator instance
  * @param  splbuf  Destination 32-bit sample buffer
  * @param  n       Number of sample to mix in splbuf buffer
@@ -402,6 +490,43 @@ IO68_EXTERN
  */
 void paula_mix(paula_t * const paula, s32 * splbuf, int n);
 
+IO68_EXTERN
+/**
+ * Execute Paula emulation with per voice outputs.
+ *
+ *   The paula_mix_stems() function is the same as paula_mix() but it
+ *   also stores each voice alone in its own buffer. A voice buffer
+ *   has the same format than splbuf with the voice on its own side
+ *   (left or right) and silence on the other side.
+ *
+ * @param  paula   Paula emulator instance
+ * @param  splbuf  Destination 32-bit sample buffer
+ * @param  voices  Voice buffers (0 for none), at least n samples each.
+ * @param  n       Number of sample to mix in splbuf buffer
+ *
+ * @see paula_mix()
+ */
+void paula_mix_stems(paula_t * const paula, s32 * splbuf,
+                     s32 * const voices[4], int n);
+
+IO68_EXTERN
+/**
+ * Execute Paula emulation with 32-bit pairs output.
+ *
+ *   The paula_mix_wide() function is the same as paula_mix_stems()
+ *   but the mix is stored as pairs of 32 bit integers (left then
+ *   right) at the 16-bit scale instead of packed 16-bit stereo.
+ *
+ * @param  paula   Paula emulator instance
+ * @param  wide    Destination buffer (at least 2*n values)
+ * @param  voices  Voice buffers (0 for none), at least n samples each.
+ * @param  n       Number of sample to mix
+ *
+ * @see paula_mix_stems()
+ */
+void paula_mix_wide(paula_t * const paula, s32 * wide,
+                    s32 * const voices[4], int n);
+
 /**
  * @}
  */
@@ -27,16 +27,31 @@ static const u16 vol2k9[32 * 32 * 32] =
 # include "ymout2k9.h"
   ;
 
+/* One row of 32 levels per unordered pair of levels: 32*33/2 rows.
+ * Rows are 64 bytes, aligning them on cache lines if possible.
+ */
+#ifdef __GNUC__
+# define ROWS_ALIGN __attribute__ ((aligned (64)))
+#else
+# define ROWS_ALIGN
+#endif
+static s16 atarist_rows[32*33/2*32] ROWS_ALIGN;
+
 /* Create a non-linear 3 channels 5 bit per channels DAC table.
+ *
+ * The measured table is symmetric (the output does not depend on
+ * which voice has which level). Only one row is stored for the
+ * (b,c) and (c,b) voices levels pairs.
  */
 static void
-create_table(s16 * out, const u16 * inp, uint_t level, const char * name)
+create_table(ym_dac_t * dac, s16 * out, const u16 * inp, uint_t level,
+             const char * name)
 {
   const int min = inp[0x0000];
   const int max = inp[0x7fff];
   const int div = max-min ? max-min : 1;
   const int mid = ( level + 1 ) >> 1;
-  int h;
+  int a, b, c, r;
 
   TRACE68(ym_cat,
           "ym-2149: creating %s -- min:%d max:%d div:%d mid:%d\n",
@@ -45,21 +60,28 @@ create_table(s16 * out, const u16 * inp, uint_t level, const char * name)
   assert(level > 254 && level < 65536u);
   assert(max > min);
 
-  for (h=0; h<32*32*32; ++h) {
-    int tmp = inp[h], res;
-    assert(tmp >= min);
-    assert(tmp <= max);
-    res = (tmp-min) * level / div - mid;
-    out[h] = res;
-  }
+  for (b=r=0; b<32; ++b)
+    for (c=0; c<=b; ++c, r+=32) {
+      dac->row[(b<<5)|c] = dac->row[(c<<5)|b] = r;
+      for (a=0; a<32; ++a) {
+        int tmp = inp[(b<<10)|(c<<5)|a];
+        assert(tmp >= min);
+        assert(tmp <= max);
+        assert(tmp == inp[(c<<10)|(b<<5)|a]);
+        out[r+a] = (tmp-min) * level / div - mid;
+      }
+    }
+
+  dac->model = YM_VOL_ATARIST;
+  dac->rows  = out;
   TRACE68(ym_cat,
           "ym-2149: volume model -- *%s* -- [%d..%d]\n",
-          name, out[0], out[0x7FFF]);
+          name, ym_dac_output(dac,0), ym_dac_output(dac,0x7FFF));
 }
 
 /* Create a non-linear 3 channels 5 bit per channels DAC table.
  */
-void ym_create_5bit_atarist_table(s16 * out, unsigned int level)
+void ym_create_5bit_atarist_table(ym_dac_t * dac, unsigned int level)
 {
-  create_table(out, vol2k9, level, "atarist-5bit-2k9");
+  create_table(dac, atarist_rows, vol2k9, level, "atarist-5bit-2k9");
 }
@@ -31,6 +31,19 @@
 #include "emu68/assert68.h"
 #include <sc68/file68_msg.h>
 #include <string.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#ifdef USE_THREADS
+# include <pthread.h>
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+# define LOCK()   pthread_mutex_lock(&lock)
+# define UNLOCK() pthread_mutex_unlock(&lock)
+#else
+# define LOCK()
+# define UNLOCK()
+#endif
 
 extern int ym_cat;                      /* defined in ymemul.c */
 extern const u16 * ym_envelops[16];     /* defined in ym_envelop.c */
@@ -143,14 +156,187 @@ const static s32 sine_integral[BLEP_SIZE] = {
   0, 0, 0, 0, 0, 0, 0
 };
 
-static void ym2149_new_output_level(ym_t * const ym)
+/* Accumulate level times the step table into the output buffer. */
+#ifdef __SSE2__
+
+static void blep_add(s32 * acc, const s16 * tab, int n, const s16 level)
 {
-  ym_blep_t *blep = &ym->emu.blep;
+  const __m128i l = _mm_set1_epi16(level);
+
+  for (; n >= 8; n -= 8, acc += 8, tab += 8) {
+    __m128i * const a = (__m128i *) acc;
+    const __m128i t  = _mm_loadu_si128((const __m128i *) tab);
+    const __m128i lo = _mm_mullo_epi16(t, l);
+    const __m128i hi = _mm_mulhi_epi16(t, l);
+    _mm_storeu_si128(a + 0, _mm_add_epi32(_mm_loadu_si128(a + 0),
+                                          _mm_unpacklo_epi16(lo, hi)));
+    _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1),
+                                          _mm_unpackhi_epi16(lo, hi)));
+  }
+  while (n-- > 0)
+    *acc++ += *tab++ * level;
+}
 
-  u32 i;
-  s16 output;
+#else
+
+static void blep_add(s32 * acc, const s16 * tab, int n, const s16 level)
+{
+  for (; n >= 4; n -= 4, acc += 4, tab += 4) {
+    acc[0] += tab[0] * level;
+    acc[1] += tab[1] * level;
+    acc[2] += tab[2] * level;
+    acc[3] += tab[3] * level;
+  }
+  while (n-- > 0)
+    *acc++ += *tab++ * level;
+}
+
+#endif
+
+struct ym_blep_table_s {
+  ym_blep_table_t * next;               /* next cached table.      */
+  int refs;                             /* instances using it.     */
+  u32 cycles_per_sample;                /* sampling rate (key).    */
+  int phases;                           /* number of phases (2^n). */
+  int taps;                             /* taps per phase (8*n).   */
+  s16 step[1];                          /* phases x taps.          */
+};
+
+/* Step tables are immutable and shared by all the instances running
+ * at the same sampling rate. */
+static ym_blep_table_t * tables;
+
+/* Build the polyphase step table for a sampling rate.
+ *
+ * Phase p holds the integrated sinc for a step that is p/phases of a
+ * sample period old at the next output sample. There are enough
+ * phases to get a quarter of ym cycle resolution.
+ */
+static ym_blep_table_t * table_new(const u32 cps)
+{
+  const u32 len = (BLEP_SIZE-1) << 8;
+  ym_blep_table_t * table;
+  int p, n, phases, taps;
+
+  taps = (len + cps - 1) / cps;
+  taps = (taps + 7) & ~7;
+  assert(taps < YM_BLEP_MAX_TAPS);
+  for (phases = 8; phases < 1024 && (phases << 6) < cps; phases <<= 1)
+    ;
+  while (phases * taps > YM_BLEP_MAX_TABLE)
+    phases >>= 1;
+
+  table = emu68_alloc(sizeof(*table) + (phases * taps - 1) * sizeof(s16));
+  if (!table)
+    return 0;
+  table->next = 0;
+  table->refs = 0;
+  table->cycles_per_sample = cps;
+  table->phases = phases;
+  table->taps   = taps;
+
+  for (p = 0; p < phases; ++p) {
+    s16 * const tab = table->step + p * taps;
+    u32 age = (p * cps + (phases >> 1)) / phases;
+    for (n = 0; n < taps; ++n, age += cps) {
+      const u32 i = age >> 8, f = age & 255;
+      s32 v = 0;
+      if (age < len) {
+        /* 16 bit table: one bit less than sine_integral[] */
+        v = (sine_integral[i] * (s32)(256 - f) + sine_integral[i+1] * (s32)f
+             + 256) >> 9;
+        if (v > 32767)
+          v = 32767;
+      }
+      tab[n] = v;
+    }
+  }
+  TRACE68(ym_cat,"ym-2149: blep table -- *%dx%d*\n", phases, taps);
+  return table;
+}
+
+/* Get the step table for a sampling rate. */
+static const ym_blep_table_t * table_get(const u32 cps)
+{
+  ym_blep_table_t * table;
+
+  LOCK();
+  for (table = tables; table; table = table->next)
+    if (table->cycles_per_sample == cps)
+      break;
+  if (!table && (table = table_new(cps))) {
+    table->next = tables;
+    tables = table;
+  }
+  if (table)
+    ++table->refs;
+  UNLOCK();
+  return table;
+}
+
+/* Release a step table, freeing it with its last user. */
+static void table_put(const ym_blep_table_t * const table)
+{
+  ym_blep_table_t ** p;
+
+  LOCK();
+  for (p = &tables; *p && *p != table; p = &(*p)->next)
+    ;
+  if (*p && !--(*p)->refs) {
+    ym_blep_table_t * const free_me = *p;
+    *p = free_me->next;
+    emu68_free(free_me);
+  }
+  UNLOCK();
+}
 
+/* Add a step of level to the samples it spans. cycles_to_next_sample
+ * is its age at the next sample (8 bit fixed point). */
+static void acc_add_step(ym_blep_t * const blep, s32 * acc, const s16 level)
+{
+  const ym_blep_table_t * const table = blep->table;
+  const u32 cps = blep->cycles_per_sample;
+  const int taps = table->taps;
+  u32 p = (blep->cycles_to_next_sample * table->phases + (cps >> 1)) / cps;
+
+  acc += blep->acc->acc_pos;
+  if (p < (u32) table->phases)
+    blep_add(acc, table->step + p * taps, taps, level);
+  else {
+    /* Older than a sample period: skip the first tap. */
+    p -= table->phases;
+    assert(p < (u32) table->phases);
+    blep_add(acc, table->step + p * taps + 1, taps - 1, level);
+  }
+}
+
+/* Add a step of level before the live bleps of a ring. */
+static void ring_add_step(ym_blep_t * const blep, ym_blep_ring_t * const ring,
+                          const s16 level)
+{
+  ring->blep_idx -= 1;
+  ring->blep_idx &= MAX_BLEPS - 1;
+  ring->blepstate[ring->blep_idx].stamp = blep->time;
+  ring->blepstate[ring->blep_idx].level = level;
+}
+
+/* Add a step to the main output (voice < 0) or to a voice. */
+static void add_step(ym_blep_t * const blep, const int voice, const s16 level)
+{
+  if (blep->acc)
+    acc_add_step(blep, voice < 0 ? blep->acc->main : blep->acc->voice[voice],
+                 level);
+  else
+    ring_add_step(blep, voice < 0 ? &blep->ring : blep->voice_ring+voice,
+                  level);
+}
+
+/* Get the 15 bit DAC input (5 bits per voice). */
+static u16 dac_state(const ym_blep_t * const blep)
+{
+  u32 i;
   u16 dacstate = 0;
+
   for (i = 0; i < 3; i ++) {
     u16 mask = blep->tonegen[i].tonemix | blep->tonegen[i].flip_flop;
     mask &= blep->tonegen[i].noisemix | blep->noise_output;
@@ -158,18 +344,35 @@ static void ym2149_new_output_level(ym_t * const ym)
       ((blep->env_output & blep->tonegen[i].envmask)
        | blep->tonegen[i].volmask);
   }
-
   assert( (dacstate & 0x7fff) == dacstate );
-  output = (ym->ymout5[dacstate] + 1) >> 1;
+  return dacstate;
+}
+
+static void ym2149_new_output_level(ym_t * const ym)
+{
+  ym_blep_t *blep = &ym->emu.blep;
+  const u16 dacstate = dac_state(blep);
+  s16 output = (ym_dac_output(ym->dac, dacstate) + 1) >> 1;
 
   if (output != blep->global_output_level) {
-    /* Add a new blep before the others */
-    blep->blep_idx -= 1;
-    blep->blep_idx &= MAX_BLEPS - 1;
-    blep->blepstate[blep->blep_idx].stamp = blep->time;
-    blep->blepstate[blep->blep_idx].level = blep->global_output_level - output;
+    add_step(blep, -1, blep->global_output_level - output);
     blep->global_output_level = output;
   }
+
+  if (blep->voices) {
+    /* Each voice as if the others were silent. */
+    int i;
+    for (i = 0; i < 3; ++i) {
+      if (blep->voices & (1 << i)) {
+        output =
+          (ym_dac_output(ym->dac, dacstate & (0x1f << (i*5))) + 1) >> 1;
+        if (output != blep->voice_level[i]) {
+          add_step(blep, i, blep->voice_level[i] - output);
+          blep->voice_level[i] = output;
+        }
+      }
+    }
+  }
 }
 
 static void ym2149_clock(ym_t * const ym, cycle68_t cycles)
@@ -196,6 +399,7 @@ static void ym2149_clock(ym_t * const ym, cycle68_t cycles)
 
     cycles -= iter;
     blep->time += iter;
+    blep->cycles_to_next_sample -= iter << 8;
 
     /* Clock subsystems forward */
     for (i = 0; i < 3; i++) {
@@ -241,19 +445,48 @@ static void ym2149_clock(ym_t * const ym, cycle68_t cycles)
   }
 }
 
-static s32 ym2149_output(ym_t * const ym, const u8 subsample)
+/* Move the pending bleps to the start of the accumulation buffers. */
+static void acc_rewind(ym_blep_t * const blep)
 {
-  ym_blep_t *blep = &ym->emu.blep;
-  u32 i = blep->blep_idx;
+  const int pos = blep->acc->acc_pos, keep = blep->table->taps + 1;
+  int i;
+
+  memmove(blep->acc->main, blep->acc->main + pos, keep * sizeof(s32));
+  memset(blep->acc->main + keep, 0, pos * sizeof(s32));
+  for (i = 0; i < 3; ++i) {
+    if (blep->voices & (1 << i)) {
+      s32 * const acc = blep->acc->voice[i];
+      memmove(acc, acc + pos, keep * sizeof(s32));
+      memset(acc + keep, 0, pos * sizeof(s32));
+    }
+  }
+  blep->acc->acc_pos = 0;
+}
+
+/* Pop the next sample of an accumulation buffer. */
+static s32 acc_output(const ym_blep_t * const blep, s32 * acc, const s16 level)
+{
+  s32 output = acc[blep->acc->acc_pos];
+
+  acc[blep->acc->acc_pos] = 0;
+  return ((output + (1 << 14)) >> 15) + level;
+}
+
+/* Sum the live bleps of a ring at the current time. */
+static s32 ring_output(const ym_blep_t * const blep,
+                       ym_blep_ring_t * const ring,
+                       const u8 subsample, const s16 level)
+{
+  u32 i = ring->blep_idx;
   s32 output = 0;
 
   /* Workaround bug #30:
    * https://sourceforge.net/p/sc68/bugs/30/
    */
-  blep->blepstate[(i-1)&(MAX_BLEPS-1)].stamp = blep->time - BLEP_SIZE;
+  ring->blepstate[(i-1)&(MAX_BLEPS-1)].stamp = blep->time - BLEP_SIZE;
 
   while (1) {
-    u16 age = blep->time - blep->blepstate[i].stamp;
+    u16 age = blep->time - ring->blepstate[i].stamp;
     if (age >= BLEP_SIZE-1)
       break;
     /* JOS says that we should have several subphases of SINC for
@@ -261,21 +494,31 @@ static s32 ym2149_output(ym_t * const ym, const u8 subsample)
      * What I got here is better than nothing, though. */
     output += ((sine_integral[age] * (256 - subsample)
                 + sine_integral[age+1] * subsample
-                + 128) >> 8) * blep->blepstate[i].level;
+                + 128) >> 8) * ring->blepstate[i].level;
     i = (i + 1) & (MAX_BLEPS - 1);
   }
   /* Terminate the blep train by keeping the last stamp invalid. */
-  blep->blepstate[i].stamp = blep->time - BLEP_SIZE;
+  ring->blepstate[i].stamp = blep->time - BLEP_SIZE;
 
-  return ((output + (1 << 15)) >> 16) + blep->global_output_level;
+  return ((output + (1 << 15)) >> 16) + level;
 }
 
-static s32 highpass(ym_t * const ym, s32 output)
+/* Get the main output (voice < 0) or a voice next sample. */
+static s32 step_output(ym_blep_t * const blep, const int voice,
+                       const s16 level)
 {
-  ym_blep_t *blep = &ym->emu.blep;
+  if (blep->acc)
+    return acc_output(blep,
+                      voice < 0 ? blep->acc->main : blep->acc->voice[voice],
+                      level);
+  return ring_output(blep, voice < 0 ? &blep->ring : blep->voice_ring+voice,
+                     blep->cycles_to_next_sample, level);
+}
 
-  blep->hp = (blep->hp * 511 + (output << 6) + (1 << 8)) >> 9;
-  output -= (blep->hp + (1 << 5)) >> 6;
+static s32 highpass(s32 * const hp, s32 output)
+{
+  *hp = (*hp * 511 + (output << 6) + (1 << 8)) >> 9;
+  output -= (*hp + (1 << 5)) >> 6;
 
   if (output > 32767)
     output = 32767;
@@ -285,6 +528,27 @@ static s32 highpass(ym_t * const ym, s32 output)
   return output;
 }
 
+/* Output the next sample (idx into the run buffers). */
+static s32 ym2149_output(ym_t * const ym, const int idx)
+{
+  ym_blep_t *blep = &ym->emu.blep;
+  s32 output =
+    highpass(&blep->hp, step_output(blep, -1, blep->global_output_level));
+
+  if (blep->voices) {
+    int i;
+    for (i = 0; i < 3; ++i)
+      if (blep->voices & (1 << i))
+        ym->stems[i][idx] =
+          highpass(&blep->voice_hp[i],
+                   step_output(blep, i, blep->voice_level[i]));
+  }
+
+  if (blep->acc && ++blep->acc->acc_pos == MAX_MIXBUF)
+    acc_rewind(blep);
+  return output;
+}
+
 /* Run output synthesis for some clocks */
 static int mix_to_buffer(ym_t * const ym, cycle68_t cycles, s32 *output)
 {
@@ -302,14 +566,12 @@ static int mix_to_buffer(ym_t * const ym, cycle68_t cycles, s32 *output)
     /* Simulate ym2149 for iter clocks */
     ym2149_clock(ym, iter);
     cycles -= iter;
-    blep->cycles_to_next_sample -= iter << 8;
 
-    /* Generate output.
-     * To improve accuracy, we interpolate the sinc table. */
+    /* Generate output. */
     if (makesample) {
       assert(blep->cycles_to_next_sample <= 0xff);
-      output[len++] =
-        highpass(ym, ym2149_output(ym, blep->cycles_to_next_sample));
+      output[len] = ym2149_output(ym, output + len - ym->outbuf);
+      ++len;
       assert(len < MAX_MIXBUF);
       blep->cycles_to_next_sample += blep->cycles_per_sample;
     }
@@ -317,6 +579,33 @@ static int mix_to_buffer(ym_t * const ym, cycle68_t cycles, s32 *output)
   return len;
 }
 
+/* Select the voices to render separately (see ym_run_stems()). */
+static void voices_setup(ym_t * const ym)
+{
+  ym_blep_t *blep = &ym->emu.blep;
+  const int voices = (!!ym->stems[0]) | (!!ym->stems[1] << 1)
+    | (!!ym->stems[2] << 2);
+  const u16 dacstate = dac_state(blep);
+  int i;
+
+  for (i = 0; i < 3; ++i) {
+    if ((voices & ~blep->voices) & (1 << i)) {
+      /* Start from the current level with a settled high pass. */
+      blep->voice_level[i] =
+        (ym_dac_output(ym->dac, dacstate & (0x1f << (i*5))) + 1) >> 1;
+      blep->voice_hp[i] = blep->voice_level[i] << 6;
+      if (blep->acc)
+        memset(blep->acc->voice[i], 0, sizeof(blep->acc->voice[i]));
+      else {
+        ym_blep_ring_t * const ring = blep->voice_ring + i;
+        memset(ring, 0, sizeof(*ring));
+        ring->blepstate[0].stamp = blep->time - BLEP_SIZE;
+      }
+    }
+  }
+  blep->voices = voices;
+}
+
 /* Mix for ymcycles cycles. */
 static int run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
 {
@@ -328,6 +617,9 @@ static int run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
   /* Walk  the static list of allocated events */
   cycle68_t currcycle = 0;
   ym_event_t *event;
+
+  ym->outbuf = output;
+  voices_setup(ym);
   for (event = ym->event_buf; event < ym->event_ptr; event++) {
     assert( event->ymcycle <= ymcycles );
 
@@ -424,6 +716,9 @@ static int run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
   /* Mix stuff outside writes */
   len += mix_to_buffer(ym, ymcycles - currcycle, output + len);
 
+  if (blep->acc)
+    acc_rewind(blep);
+
   return len;
 }
 
@@ -431,10 +726,16 @@ static int reset(ym_t * const ym, const cycle68_t ymcycle)
 {
   ym_blep_t *blep = &ym->emu.blep;
 
-  u32 tmp = blep->cycles_per_sample;
+  const u32 tmp = blep->cycles_per_sample;
+  const ym_blep_table_t * const table = blep->table;
+  ym_blep_acc_t * const acc = blep->acc;
   memset(blep, 0, sizeof(ym_blep_t));
 
   blep->cycles_per_sample = tmp;
+  blep->table = table;
+  blep->acc = acc;
+  if (acc)
+    memset(acc, 0, sizeof(*acc));
   blep->noise_state = 1;
   blep->time = BLEP_SIZE;
   blep->tonegen[0].event = 8;
@@ -459,8 +760,49 @@ static int sampling_rate(ym_t * const ym, const int hz)
   return hz;
 }
 
+static int acc_sampling_rate(ym_t * const ym, int hz)
+{
+  ym_blep_t *blep = &ym->emu.blep;
+  const u32 mincps = ((BLEP_SIZE-1) << 8) / (YM_BLEP_MAX_TAPS - 16);
+  const ym_blep_table_t * table;
+  u32 cps = (ym->clock << 8) / hz;
+
+  if (cps < mincps) {
+    cps = mincps;
+    hz = (ym->clock << 8) / mincps;
+  }
+  if (!blep->table || blep->table->cycles_per_sample != cps) {
+    table = table_get(cps);
+    if (!table) {
+      /* Keep the current rate. */
+      msg68_critical("ym-2149: blep step table allocation failed\n");
+      return blep->table
+        ? (int) ((ym->clock << 8) / blep->cycles_per_sample) : hz;
+    }
+    if (blep->table)
+      table_put(blep->table);
+    blep->table = table;
+  }
+  blep->cycles_per_sample = cps;
+  return hz;
+}
+
+static void acc_cleanup(ym_t * const ym)
+{
+  ym_blep_t *blep = &ym->emu.blep;
+
+  if (blep->table) {
+    table_put(blep->table);
+    blep->table = 0;
+  }
+  emu68_free(blep->acc);
+  blep->acc = 0;
+}
+
 int ym_blep_setup(ym_t * const ym)
 {
+  ym->emu.blep.table   = 0;
+  ym->emu.blep.acc     = 0;
   ym->cb_cleanup       = 0;
   ym->cb_reset         = reset;
   ym->cb_run           = run;
@@ -469,6 +811,24 @@ int ym_blep_setup(ym_t * const ym)
   return 0;
 }
 
+int ym_blep_acc_setup(ym_t * const ym)
+{
+  ym->emu.blep.table   = 0;
+  ym->emu.blep.acc     = emu68_alloc(sizeof(ym_blep_acc_t));
+  if (ym->emu.blep.acc)
+    acc_sampling_rate(ym, ym->hz);
+  if (!ym->emu.blep.table) {
+    acc_cleanup(ym);
+    return -1;
+  }
+  ym->cb_cleanup       = acc_cleanup;
+  ym->cb_reset         = reset;
+  ym->cb_run           = run;
+  ym->cb_buffersize    = buffersize;
+  ym->cb_sampling_rate = acc_sampling_rate;
+  return 0;
+}
+
 void ym_blep_add_options(void)
 {
 }
@@ -32,6 +32,24 @@ IO68_EXTERN
  */
 int ym_blep_setup(ym_t * const ym);
 
+IO68_EXTERN
+/**
+ * Setup function for ym blep synthesis engine with output rate
+ * accumulation.
+ *
+ *    The ym_blep_acc_setup() function sets the blep engine variant
+ *    that adds each step to an output rate buffer once, from a
+ *    polyphase table shared by all instances at the same sampling
+ *    rate. It is faster when many edges are alive but its output
+ *    differs slightly from the ym_blep_setup() one (step offset
+ *    quantization).
+ *
+ *  @param    ym  ym emulator instance to setup
+ *  @retval   0  on success
+ *  @retval  -1  on failure
+ */
+int ym_blep_acc_setup(ym_t * const ym);
+
 IO68_EXTERN
 /**
  *  Creates ym blep engine options.
@@ -39,7 +57,10 @@ IO68_EXTERN
 void ym_blep_add_options(void);
 
 enum {
-  MAX_BLEPS = 256                       /**< @nodoc */
+  MAX_BLEPS         = 256,      /**< @nodoc */
+  YM_BLEP_MAX_TAPS  = 128,      /**< Max output samples per blep.    */
+  YM_BLEP_MAX_TABLE = 16384,     /**< Polyphase step table size.      */
+  YM_BLEP_MAX_ACC   = 2048 + YM_BLEP_MAX_TAPS /**< @nodoc */
 };
 
 /** @nodoc */
@@ -59,6 +80,22 @@ typedef struct {
   s16 level;                            /**< @nodoc */
 } ym_blep_blep_state_t;
 
+/** Live bleps, newest first. */
+typedef struct {
+  u32 blep_idx;                         /**< @nodoc */
+  ym_blep_blep_state_t blepstate[MAX_BLEPS]; /**< @nodoc */
+} ym_blep_ring_t;
+
+/** Polyphase step table (shared, see ym_blep_acc_setup()). */
+typedef struct ym_blep_table_s ym_blep_table_t;
+
+/** Output rate accumulation buffers (see ym_blep_acc_setup()). */
+typedef struct {
+  int acc_pos;                     /**< main[acc_pos] is next sample. */
+  s32 main[YM_BLEP_MAX_ACC];            /**< @nodoc */
+  s32 voice[3][YM_BLEP_MAX_ACC];        /**< @nodoc */
+} ym_blep_acc_t;
+
 /** @nodoc */
 typedef struct {
   /* sampling parameters */
@@ -79,12 +116,19 @@ typedef struct {
 
   /* blep stuff */
   s16 global_output_level;              /**< @nodoc */
-  u32 blep_idx;                         /**< @nodoc */
   u16 time;                             /**< @nodoc */
   s32 hp;                               /**< @nodoc */
+  ym_blep_ring_t ring;                  /**< @nodoc */
+
+  /* Voices rendered separately (see ym_run_stems()). */
+  int voices;                           /**< voices bit mask.        */
+  s16 voice_level[3];                   /**< @nodoc */
+  s32 voice_hp[3];                      /**< @nodoc */
+  ym_blep_ring_t voice_ring[3];         /**< @nodoc */
 
-  /** @nodoc */
-  ym_blep_blep_state_t blepstate[MAX_BLEPS];
+  /* Output rate accumulation (0 unless ym_blep_acc_setup()). */
+  const ym_blep_table_t * table;        /**< shared step table.      */
+  ym_blep_acc_t * acc;                  /**< accumulation buffers.   */
 } ym_blep_t;
 
 /**
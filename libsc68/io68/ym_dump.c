@@ -28,6 +28,7 @@
 #include "io68_private.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #if 0
 #ifdef HAVE_CONFIG_OPTION68_H
@@ -205,6 +206,10 @@ int run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
   for (i=0; i<len; ++i) {
     output[i] = 0;
   }
+  for (i=0; i<3; ++i) {
+    if (ym->stems[i])
+      memset(ym->stems[i], 0, len * sizeof(s32));
+  }
   return len;
 }
 
@@ -320,6 +320,16 @@ int ymio_run(const io68_t * const io, s32 * output, const cycle68_t cycles)
   return 0;
 }
 
+int ymio_run_stems(const io68_t * const io, s32 * output,
+                   s32 * const voices[3], const cycle68_t cycles)
+{
+  if (io) {
+    ym_io68_t * const ymio = (ym_io68_t *)io;
+    return ym_run_stems(&ymio->ym,output,voices,cycle_cputoym(ymio,cycles));
+  }
+  return 0;
+}
+
 /** Convert a cpu-cycle to ym-cycle. */
 cycle68_t ymio_cycle_cpu2ym(const io68_t * const io, const cycle68_t cycles)
 {
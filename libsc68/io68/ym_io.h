@@ -69,6 +69,15 @@ IO68_EXTERN
  */
 int ymio_run(const io68_t * const io, s32 * output, const cycle68_t cycles);
 
+IO68_EXTERN
+/**
+ *  Run ym emulator with per voice outputs.
+ *
+ *  @see ym_run_stems()
+ */
+int ymio_run_stems(const io68_t * const io, s32 * output,
+                   s32 * const voices[3], const cycle68_t cycles);
+
 IO68_EXTERN
 /**
  *  Get required sample buffer size.
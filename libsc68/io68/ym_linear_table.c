@@ -66,23 +66,28 @@ static const u16 ymout1c5bit[32] =
 
 
 /* Create a linear 3 channels 5 bit per channels DAC table.
+ *
+ * The output is the sum of the 3 voice contributions so only a 32
+ * entries per voice table is needed.
  */
-void ym_create_5bit_linear_table(s16 * out, unsigned int level)
+void ym_create_5bit_linear_table(ym_dac_t * dac, unsigned int level)
 {
   int i;
   const unsigned int min = ymout1c5bit[00];
   const unsigned int max = ymout1c5bit[31];
   const unsigned int div = max-min ? max-min : 1;
   const int center = ( level + 1 ) >> 1;
-  for (i=0; i<32*32*32; ++i) {
-    int tmp =
-      (  (unsigned int) ymout1c5bit[0x1F & (i>>10)] +
-         (unsigned int) ymout1c5bit[0x1F & (i>> 5)] +
-         (unsigned int) ymout1c5bit[0x1F & (i>> 0)] -
-         3u * min ) / 3u * level / div;
-    out[i] = tmp - center;
+
+  dac->model  = YM_VOL_LINEAR;
+  dac->rows  = 0;
+  for (i=0; i<32; ++i) {
+    u64 tmp = (u64) ( ymout1c5bit[i] - min ) * level << 14;
+    dac->voice[i] = tmp / ( 3u * div );
   }
+  /* Round to nearest and center. */
+  dac->bias = ( 1 << 13 ) - ( center << 14 );
+
   TRACE68(ym_cat,
           "ym-2149: volume model -- *linear* -- [%d..%d]\n",
-          out[0],out[0x7FFF]);
+          ym_dac_output(dac,0), ym_dac_output(dac,0x7FFF));
 }
@@ -38,10 +38,12 @@
 
 #include "ymemul.h"
 #include "emu68/assert68.h"
+#include "emu68/clock68.h"
 
 #include <sc68/file68_msg.h>
 #include <sc68/file68_str.h>
 #include <sc68/file68_opt.h>
+#include <string.h>
 
 extern int ym_cat;                      /* defined in ymemul.c */
 extern int ym_dac_out;                  /* defined in ymemul.c */
@@ -138,6 +140,9 @@ static int reset(ym_t * const ym, const cycle68_t ymcycle)
   PULS.btw.x[0] = PULS.btw.x[1] = 0;
   PULS.btw.y[0] = PULS.btw.y[1] = 0;
 
+  /* Voices filters are reset when first used. */
+  PULS.voices = 0;
+
   /* Butterworth low-pass cutoff=15.625khz sampling=250khz */
   PULS.btw.a[0] =  0x01eac69f; /* fix 30 */
   PULS.btw.a[1] =  0x03d58d3f;
@@ -356,7 +361,7 @@ static void simulation(ym_t * const ym, cycle68_t ymcycle)
 static inline s16 ymout(const ym_t * const ym, const int v)
 {
   assert (v >= 0 && v < (1<<15) );
-  return ym->ymout5[v];
+  return ym_dac_output(ym->dac, v);
 }
 
 static inline int clip(int o)
@@ -692,17 +697,72 @@ static void filter_2pole(ym_t * const ym)
   }
 }
 
+#define SWAP(A,B) { const int68_t t = A; A = B; B = t; }
+
+/* Exchange the filter states with the ones of a voice. */
+static void swap_filter(ym_t * const ym, const int i)
+{
+  SWAP(PULS.hipass_inp1, PULS.voice[i].hipass_inp1);
+  SWAP(PULS.hipass_out1, PULS.voice[i].hipass_out1);
+  SWAP(PULS.lopass_out1, PULS.voice[i].lopass_out1);
+  SWAP(PULS.btw.x[0], PULS.voice[i].x[0]);
+  SWAP(PULS.btw.x[1], PULS.voice[i].x[1]);
+  SWAP(PULS.btw.y[0], PULS.voice[i].y[0]);
+  SWAP(PULS.btw.y[1], PULS.voice[i].y[1]);
+}
+
+/* Filter each voice separately (see ym_run_stems()). The generator
+ * output holds 5 bits per voice so that a voice is simply masked
+ * out of it.
+ */
+static void filter_voices(ym_t * const ym, const s32 * src, const int n)
+{
+  int i, k, voices = 0;
+
+  for (i = 0; i < 3; ++i) {
+    s32 * const dst = ym->stems[i];
+    const int mask = 0x1f << (i*5);
+
+    if (!dst)
+      continue;
+    voices |= 1 << i;
+    if (!(PULS.voices & (1 << i)))
+      memset(&PULS.voice[i], 0, sizeof(PULS.voice[i]));
+
+    for (k = 0; k < n; ++k)
+      dst[k] = src[k] & mask;
+    swap_filter(ym, i);
+    ym->outbuf = dst;
+    ym->outptr = dst + n;
+    filters[PULS.ifilter].filter(ym);
+    swap_filter(ym, i);
+  }
+  PULS.voices = voices;
+}
+
 static
 int run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
 {
+  u64 t0;
+
   /* set pointers */
   ym->outbuf = ym->outptr = output;
 
   /* run the simulation */
   simulation(ym,ymcycles);
+  t0 = clock68_ns();
+
+  /* post processing of the voices before the output is filtered. */
+  if (ym->stems[0] || ym->stems[1] || ym->stems[2] || PULS.voices) {
+    const int n = ym->outptr - output;
+    filter_voices(ym, output, n);
+    ym->outbuf = output;
+    ym->outptr = output + n;
+  }
 
   /* post processing (filters, resample ...) */
   filters[ym->emu.puls.ifilter].filter(ym);
+  ym->filter_ns += clock68_ns() - t0;
 
   /* reset event list. */
   ym->event_ptr = ym->event_buf;
@@ -97,6 +97,16 @@ struct ym2149_puls_s
 
   int ifilter;                         /**< filter function to use. */
 
+  /** Per voice filter states (see ym_run_stems()). */
+  struct {
+    int68_t hipass_inp1;                /**< @nodoc */
+    int68_t hipass_out1;                /**< @nodoc */
+    int68_t lopass_out1;                /**< @nodoc */
+    int68_t x[2];                       /**< @nodoc */
+    int68_t y[2];                       /**< @nodoc */
+  } voice[3];
+  int voices;                       /**< voices rendered (bit mask). */
+
 };
 
 /**
@@ -50,10 +50,15 @@ int ym_cur_volmodel = YM_VOL_QUERY;    /* Invalid value */
 #include "ym_linear_table.c"
 #include "ym_atarist_table.c"
 
-/** 3 channels output table.
- *  Using a table for non linear mixing.
+/** 3 channels output tables (one per volume model).
+ *  Built by ym_init() and shared read-only by all instances.
  */
-static s16 ymout5[32*32*32];
+static ym_dac_t dac_atarist, dac_linear;
+
+static const ym_dac_t * ym_dac(int model)
+{
+  return model == YM_VOL_LINEAR ? &dac_linear : &dac_atarist;
+}
 
 /* ,-----------------------------------------------------------------.
  * |                         Yamaha reset                            |
@@ -118,7 +123,8 @@ static ym_parms_t default_parms;
 static const char f_pulse[]  = "pulse";
 static const char f_blep[]   = "blep";
 static const char f_dump[]   = "dump";
-static const char * f_engines[] = { f_blep, f_pulse, f_dump };
+static const char f_blepacc[] = "blep-acc";
+static const char * f_engines[] = { f_blep, f_pulse, f_dump, f_blepacc };
 
 static const char f_atari[]  = "atari";
 static const char f_linear[] = "linear";
@@ -126,9 +132,11 @@ static const char * f_volumes[] = { f_atari, f_linear };
 
 static int onchange_engine(const option68_t *opt, value68_t * val)
 {
-  static int engs[3] = { YM_ENGINE_BLEP, YM_ENGINE_PULS, YM_ENGINE_DUMP };
-  assert(val->num >= 0 && val->num < 3);
-  if (val->num >= 0 && val->num < 3) {
+  static int engs[4] = {
+    YM_ENGINE_BLEP, YM_ENGINE_PULS, YM_ENGINE_DUMP, YM_ENGINE_BLEP_ACC
+  };
+  assert(val->num >= 0 && val->num < 4);
+  if (val->num >= 0 && val->num < 4) {
     ym_engine(0, engs[val->num]);
     return 0;
   }
@@ -219,18 +227,12 @@ int ym_init(int * argc, char ** argv)
 
   check_output_level();
 
-  /* Set volume table (unique for all instance) */
-  switch (default_parms.volmodel) {
-  case YM_VOL_LINEAR:
-    ym_create_5bit_linear_table(ymout5, ym_output_level);
-    ym_cur_volmodel = YM_VOL_LINEAR;
-    break;
-  case YM_VOL_DEFAULT:
-  case YM_VOL_ATARIST:
-  default:
-    ym_create_5bit_atarist_table(ymout5, ym_output_level);
-    ym_cur_volmodel = YM_VOL_ATARIST;
-  }
+  /* Create volume tables (shared by all instances) */
+  ym_create_5bit_linear_table(&dac_linear, ym_output_level);
+  ym_create_5bit_atarist_table(&dac_atarist, ym_output_level);
+  if (default_parms.volmodel != YM_VOL_LINEAR)
+    default_parms.volmodel = YM_VOL_ATARIST;
+  ym_cur_volmodel = default_parms.volmodel;
 
   return 0;
 }
@@ -246,6 +248,14 @@ void ym_shutdown(void)
  */
 int ym_run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
 {
+  return ym_run_stems(ym, output, 0, ymcycles);
+}
+
+int ym_run_stems(ym_t * const ym, s32 * output, s32 * const voices[3],
+                 const cycle68_t ymcycles)
+{
+  int len;
+
   if (!ymcycles) {
     return 0;
   }
@@ -259,7 +269,14 @@ int ym_run(ym_t * const ym, s32 * output, const cycle68_t ymcycles)
     return -1;
   }
 
-  return ym->cb_run(ym,output,ymcycles);
+  /* Engines write the voices along with output. */
+  ym->stems[0] = voices ? voices[0] : 0;
+  ym->stems[1] = voices ? voices[1] : 0;
+  ym->stems[2] = voices ? voices[2] : 0;
+  len = ym->cb_run(ym,output,ymcycles);
+  ym->stems[0] = ym->stems[1] = ym->stems[2] = 0;
+
+  return len;
 }
 
 
@@ -346,6 +363,7 @@ const char * ym_engine_name(int emul)
   case YM_ENGINE_PULS:    return f_pulse;
   case YM_ENGINE_BLEP:    return f_blep;
   case YM_ENGINE_DUMP:    return f_dump;
+  case YM_ENGINE_BLEP_ACC: return f_blepacc;
   }
   return 0;
 }
@@ -367,6 +385,7 @@ int ym_engine(ym_t * const ym, int engine)
   case YM_ENGINE_PULS:
   case YM_ENGINE_BLEP:
   case YM_ENGINE_DUMP:
+  case YM_ENGINE_BLEP_ACC:
     /* Valid values */
     if (!ym) {
       default_parms.engine = engine;
@@ -431,12 +450,12 @@ const char * ym_volmodel_name(int model)
 
 int ym_volume_model(ym_t * const ym, int model)
 {
-  /* Set volume table (currently unique for all instances) */
+  /* Select volume table (per instance) */
 
   switch (model) {
 
   case YM_VOL_QUERY:
-    model = default_parms.volmodel;
+    model = ym ? ym->volmodel : default_parms.volmodel;
     break;
 
   default:
@@ -445,19 +464,15 @@ int ym_volume_model(ym_t * const ym, int model)
   case YM_VOL_LINEAR:
   case YM_VOL_ATARIST:
     assert(model == YM_VOL_LINEAR || model == YM_VOL_ATARIST);
-    if (ym)
-      ym->volmodel = model;             /* does nothing ATM */
-    if (model != ym_cur_volmodel) {
-      ym_cur_volmodel = model;
-      check_output_level();
-      if ( model == YM_VOL_LINEAR )
-        ym_create_5bit_linear_table(ymout5, ym_output_level);
-      else
-        ym_create_5bit_atarist_table(ymout5, ym_output_level);
-      TRACE68(ym_cat,
-              YMHD "set volume table -- *%s $%04x*\n",
-              ym_volmodel_name(model), ym_output_level);
-    }
+    if (ym) {
+      ym->volmodel = model;
+      ym->dac      = ym_dac(model);
+    } else
+      default_parms.volmodel = ym_cur_volmodel = model;
+    TRACE68(ym_cat,
+            YMHD "%s volume table -- *%s $%04x*\n",
+            ym ? "select" : "default",
+            ym_volmodel_name(model), ym_output_level);
     break;
   }
   return model;
@@ -549,7 +564,7 @@ int ym_setup(ym_t * const ym, ym_parms_t * const parms)
           p->engine,p->hz,p->clock,256);
 
   if (ym) {
-    ym->ymout5      = ymout5;
+    ym_volume_model(ym, p->volmodel);
     ym->clock       = p->clock;
     ym->voice_mute  = ym_smsk_table[7 & ym_default_chans];
     /* clearing sampling rate callback ensure requested rate to be in
@@ -571,6 +586,10 @@ int ym_setup(ym_t * const ym, ym_parms_t * const parms)
       err = ym_dump_setup(ym);
       break;
 
+    case YM_ENGINE_BLEP_ACC:
+      err = ym_blep_acc_setup(ym);
+      break;
+
     default:
       assert(!"invalid ym-engine");
       err = -1;
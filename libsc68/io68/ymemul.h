@@ -117,7 +117,8 @@ enum ym_engine_e {
   YM_ENGINE_DEFAULT = 0,  /**< Use default mode.                            */
   YM_ENGINE_PULS,         /**< sc68 original (pulse) emulation.             */
   YM_ENGINE_BLEP,         /**< Antti Lankila's Band Limited Step synthesis. */
-  YM_ENGINE_DUMP          /**< Dummy register dump.                         */
+  YM_ENGINE_DUMP,         /**< Dummy register dump.                         */
+  YM_ENGINE_BLEP_ACC      /**< Blep with output rate accumulation.          */
 };
 
 /**
@@ -130,6 +131,39 @@ enum ym_vol_e {
   YM_VOL_LINEAR        /**< Linear mixing volume table.            */
 };
 
+/**
+ * YM-2149 DAC table (3 voices, 5-bit per voice).
+ *
+ *   DAC tables are owned by the volume models and shared read-only by
+ *   all emulator instances. They are built once by ym_init().
+ *
+ *   - The linear model is the sum of three identical per voice
+ *     tables (fixed point .14).
+ *   - The Atari-ST measured table is symmetric in the three voices.
+ *     It is stored as one row of 32 levels (voice A) for each
+ *     unordered pair of voice B and C levels (528 rows instead of
+ *     1024). A row is 64 bytes so a lookup touches one cache line
+ *     of the table plus one of the row index.
+ */
+typedef struct {
+  int model;                    /**< @ref ym_vol_e "volume model".     */
+  const s16 * rows;             /**< Levels rows (0:linear model).     */
+  u16 row[32*32];               /**< Row offset for voices B and C.    */
+  s32 voice[32];                /**< Linear voice output (.14).        */
+  s32 bias;                     /**< Linear output bias (.14).         */
+} ym_dac_t;
+
+/**
+ * Get DAC output for a 15-bit packed voice levels.
+ */
+static inline int ym_dac_output(const ym_dac_t * const dac, const int v)
+{
+  if (!dac->rows)
+    return ( dac->voice[v & 31] + dac->voice[(v >> 5) & 31] +
+             dac->voice[v >> 10] + dac->bias ) >> 14;
+  return dac->rows[dac->row[v >> 5] + (v & 31)];
+}
+
 /**
  * Sampling rate special values.
  */
@@ -188,7 +222,7 @@ struct ym_s {
    * @}
    */
 
-  s16    * ymout5;            /**< DAC lookup table                      */
+  const ym_dac_t * dac;       /**< DAC table (shared by volume model).   */
   uint_t   voice_mute;        /**< Mask muted voices.                    */
   uint_t   hz;                /**< Sampling rate.                        */
   uint68_t clock;             /**< Master clock frequency in Hz.         */
@@ -204,12 +238,15 @@ struct ym_s {
    * @}
    */
 
+  u64 filter_ns;              /**< Time spent filtering (see clock68.h). */
+
   /**
    * @name  Output
    * @{
    */
   s32 * outbuf;             /**< output buffer given to ym_run()         */
   s32 * outptr;             /**< generated sample pointer (into outbuf)  */
+  s32 * stems[3];           /**< per voice buffers (0:none) while running */
   /**
    * @}
    */
@@ -356,6 +393,32 @@ IO68_EXTERN
  */
 int ym_run(ym_t * const ym, s32 * output, const cycle68_t ymcycles);
 
+IO68_EXTERN
+/**
+ * Execute Yamaha-2149 emulation with per voice outputs.
+ *
+ *   The ym_run_stems() function is the same as ym_run() but it also
+ *   renders the voices A, B and C separately in the same pass. Each
+ *   voice buffer receives the same number of samples than output, in
+ *   the same format, as if the two other voices were muted. Voices
+ *   go through the engine output filters but mixing voices buffers
+ *   does not exactly give the output buffer as the YM DAC is not
+ *   linear.
+ *
+ * @param  ym        YM-2149 emulator instance.
+ * @param  output    Output sample buffer.
+ * @param  voices    Voice A, B and C buffers (0 for none). Each
+ *                   buffer must be as large as output.
+ * @param  ymcycles  Number of cycle to mix.
+ *
+ * @return  Number of sample in output mix-buffer
+ * @retval  -1  Failure
+ *
+ * @see ym_run()
+ */
+int ym_run_stems(ym_t * const ym, s32 * output, s32 * const voices[3],
+                 const cycle68_t ymcycles);
+
 
 IO68_EXTERN
 /**
@@ -55,6 +55,58 @@
  * @}
  */
 
+/**
+ * @name  SIMD kernel sets.
+ * @{
+ */
+enum {
+  MIXER68_SIMD_QUERY = -1,  /**< Query current kernel set.            */
+  MIXER68_SIMD_AUTO  =  0,  /**< Best kernel set supported by the CPU. */
+  MIXER68_SIMD_NONE,        /**< Portable C kernels.                  */
+  MIXER68_SIMD_SSE2,        /**< x86 SSE2 kernels.                    */
+  MIXER68_SIMD_AVX2         /**< x86 AVX2 kernels.                    */
+};
+/**
+ * @}
+ */
+
+MIXER68_API
+/**
+ * Initialize the mixer.
+ *
+ *   Select the best kernel set for this CPU and register the mixer
+ *   options (--mixer-simd).
+ *
+ * @param  argc  pointer to argument count
+ * @param  argv  argument array
+ * @return error-code
+ * @retval  0  on success
+ */
+int mixer68_init(int * argc, char ** argv);
+
+MIXER68_API
+/**
+ * Set/Get mixer kernel set.
+ *
+ *   All kernel sets produce bit-identical PCM. A kernel set the CPU
+ *   does not support falls back to the best supported one.
+ *
+ * @param  simd  kernel set (@see MIXER68_SIMD_AUTO) or
+ *               MIXER68_SIMD_QUERY
+ * @return selected kernel set
+ */
+int mixer68_simd(int simd);
+
+MIXER68_API
+/**
+ * Get kernel set name.
+ *
+ * @param  simd  kernel set or MIXER68_SIMD_QUERY for the current one
+ * @return kernel set name
+ * @retval 0 on error
+ */
+const char * mixer68_simd_name(int simd);
+
 MIXER68_API
 /**
  * Copy 16-bit-stereo PCM with optionnal sign change.
@@ -100,6 +152,23 @@ MIXER68_API
 void mixer68_stereo_FL_LR(float * dst, u32 * src, int nb,
                           const u32 sign, const float norm);
 
+MIXER68_API
+/**
+ * Copy 16-bit-stereo PCM into 24-bit-stereo PCM.
+ *
+ *   Each channel is stored in a 32 bit signed integer (sign extended
+ *   24 bit value).
+ *
+ * @note     Sign change occurs before 24 bit transformation.
+ * @warning  PCM are assumed to be signed after sign transform.
+ *
+ * @param  dst   Destination PCM buffer (2*nb values).
+ * @param  src   Source PCM buffer.
+ * @param  nb    Number of PCM
+ * @param  sign  Sign transformation.
+ */
+void mixer68_stereo_24_LR(s32 * dst, u32 * src, int nb, const u32 sign);
+
 MIXER68_API
 /**
  * Copy left channel of 16-bit stereo PCM into L/R channels with
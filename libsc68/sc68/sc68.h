@@ -98,6 +98,9 @@
 /** API information. */
 typedef struct _sc68_s sc68_t;
 
+/** API background stream. */
+typedef struct _sc68_stream_s sc68_stream_t;
+
 /** API disk. */
 typedef void * sc68_disk_t;
 
@@ -242,6 +245,77 @@ enum sc68_code_e {
   SC68_ERROR  = ~0        /**< Failure return code (all bits set).  */
 };
 
+/**
+ * Stem (separated voice output) indices for sc68_process_stems().
+ */
+enum sc68_stem_e {
+  SC68_STEM_YM_A = 0,     /**< YM-2149 voice A.                     */
+  SC68_STEM_YM_B,         /**< YM-2149 voice B.                     */
+  SC68_STEM_YM_C,         /**< YM-2149 voice C.                     */
+  SC68_STEM_DMA,          /**< STE DMA sound (after LMC volumes).   */
+  SC68_STEM_PAULA_0,      /**< Amiga Paula voice 0.                 */
+  SC68_STEM_PAULA_1,      /**< Amiga Paula voice 1.                 */
+  SC68_STEM_PAULA_2,      /**< Amiga Paula voice 2.                 */
+  SC68_STEM_PAULA_3,      /**< Amiga Paula voice 3.                 */
+  SC68_STEM_MAX           /**< Number of stems.                     */
+};
+
+/**
+ * sc68_render() flags.
+ */
+enum sc68_render_e {
+  SC68_RENDER_CHANGE = (1<<0), /**< Return at track change.         */
+  SC68_MARK_MAX      = 16      /**< Maximum marks per sc68_render(). */
+};
+
+/**
+ * Render mark (event position reported by sc68_render()).
+ */
+typedef struct {
+  int pos;      /**< PCM offset of the event in the render buffer.  */
+  int code;     /**< One of SC68_LOOP, SC68_CHANGE or SC68_END.     */
+  int track;    /**< Current track after the event.                 */
+  int loop;     /**< Loop counter after the event.                  */
+} sc68_mark_t;
+
+/**
+ * Performance counter stages (see SC68_GET_STATS).
+ */
+enum sc68_stage_e {
+  SC68_STAGE_68K,         /**< 68000 emulation (play + interrupts). */
+  SC68_STAGE_YM,          /**< YM-2149 generator.                   */
+  SC68_STAGE_FILTER,      /**< YM-2149 output filter.               */
+  SC68_STAGE_PAULA,       /**< Amiga Paula.                         */
+  SC68_STAGE_MW,          /**< STE MicroWire/DMA.                   */
+  SC68_STAGE_MIXER,       /**< Mixing and PCM conversion.           */
+  SC68_STAGE_MAX          /**< Number of stages.                    */
+};
+
+/**
+ * Performance counters.
+ */
+typedef struct {
+  unsigned long long passes;       /**< Emulation passes.            */
+  unsigned long long instructions; /**< 68k instructions executed.   */
+  unsigned long long interrupts;   /**< 68k interrupts taken.        */
+  unsigned long long ym_events;    /**< YM register writes processed.*/
+  unsigned long long ym_overflows; /**< YM register writes lost.     */
+  unsigned long long reallocs;     /**< PCM buffer reallocations.    */
+  unsigned long long ns[SC68_STAGE_MAX]; /**< Nanoseconds per stage. */
+} sc68_counters_t;
+
+/**
+ * Performance statistics.
+ *
+ *   `sc68_cntl(sc68, SC68_GET_STATS, &stats)` fills the struct;
+ *   passing a null pointer resets the counters. It fails when
+ *   libsc68 was compiled without performance counters.
+ */
+typedef struct {
+  sc68_counters_t total;  /**< Cumulative counters.                 */
+  sc68_counters_t last;   /**< Counters of the last pass.           */
+} sc68_stats_t;
+
 /**
  * sc68 sampling rate values in hertz (hz).
  */
@@ -267,7 +341,8 @@ enum sc68_play_e {
  */
 enum sc68_pcm_e {
   SC68_PCM_S16 = 1,               /**< Native 16bit signed.  */
-  SC68_PCM_F32 = 2                /**< native 32bit float.   */
+  SC68_PCM_F32 = 2,               /**< native 32bit float.   */
+  SC68_PCM_S24 = 3                /**< 24bit signed in native 32bit. */
 };
 
 /**
@@ -321,6 +396,8 @@ enum sc68_cntl_e {
   SC68_SET_OPT_STR,  /**< Set options (string).     */
   SC68_SET_OPT_INT,  /**< Set options (integer).    */
   SC68_DIAL,         /**< Run a dialog.             */
+  SC68_GET_STATS,    /**< Get/reset perf counters.  */
+  SC68_GET_CRC,      /**< Get 68k CRC32 (regs+mem). */
 
   /* Always last */
   SC68_CNTL_LAST     /**< Last command #.           */
@@ -434,8 +511,18 @@ SC68_API
  *   the next one is automatically loaded. The function returns status
  *   value that report events that have occured during this pass.
  *
+ *   The PCM format is set per instance with sc68_cntl(SC68_SET_PCM).
+ *   Interleaved stereo PCM are either 16bit signed (default), float
+ *   or 24bit signed values stored in 32bit integers. For float and
+ *   24bit the last mixing stage (YM mono to stereo, STE MicroWire,
+ *   Amiga Paula and blending) is not clipped to 16bit. Float maps the
+ *   16bit range to [-1..+1] and goes beyond it on louder mixes; 24bit
+ *   saturates. The YM engines still clip their own output and stems
+ *   keep a 16bit precision.
+ *
  * @param  sc68  sc68 instance.
- * @param  buf   PCM buffer (must be at least 4*n bytes).
+ * @param  buf   PCM buffer (must be at least 4*n bytes for
+ *               SC68_PCM_S16 or 8*n bytes for the other formats).
  * @param  n     Pointer to number of PCM sample to fill.
  *
  * @return Process status
@@ -443,6 +530,76 @@ SC68_API
  */
 int sc68_process(sc68_t * sc68, void * buf, int * n);
 
+SC68_API
+/**
+ * Fill PCM buffer and per voice PCM buffers.
+ *
+ *   The sc68_process_stems() function is the same as sc68_process()
+ *   but it also fills stem buffers with each voice rendered alone in
+ *   the same emulation pass. Stems have the same PCM format than buf.
+ *
+ *   - YM voices are duplicated on both channels. They are the raw
+ *     YM-2149 output before the STE mixer (if any).
+ *   - Paula voices are on their own side without the LR blending.
+ *   - Stems of hardware not used by the current track are silent.
+ *
+ *   Stem buffers are allocated on the first call with stems. Samples
+ *   that have been emulated before this first call are silent.
+ *
+ * @param  sc68   sc68 instance.
+ * @param  buf    PCM buffer (see sc68_process()).
+ * @param  n      Pointer to number of PCM sample to fill.
+ * @param  stems  Stem PCM buffers indexed by sc68_stem_e (0 for none
+ *                or to skip individual stems).
+ *
+ * @return Process status
+ *
+ * @see sc68_process()
+ */
+int sc68_process_stems(sc68_t * sc68, void * buf, int * n,
+                       void * const stems[SC68_STEM_MAX]);
+
+SC68_API
+/**
+ * Render a large PCM buffer.
+ *
+ *   The sc68_render() function is meant for offline rendering. It
+ *   runs as many emulation passes as needed to fill the buffer (up to
+ *   the end) without returning at track changes or loops. Passes are
+ *   rendered directly into the buffer whenever possible. The position
+ *   of each loop, track change and end is recorded as a mark
+ *   available with sc68_render_marks().
+ *
+ *   The function returns before max PCM are rendered when the end is
+ *   reached, on track change with SC68_RENDER_CHANGE or when there is
+ *   no more room for marks (a new call continues the rendering).
+ *
+ * @param  sc68   sc68 instance.
+ * @param  buf    PCM buffer (see sc68_process()).
+ * @param  max    Maximum number of PCM to render.
+ * @param  done   Receive the number of PCM rendered (can be 0).
+ * @param  flags  sc68_render_e flags.
+ *
+ * @return Process status (all events of this call)
+ * @retval SC68_ERROR on error
+ *
+ * @see sc68_process()
+ * @see sc68_render_marks()
+ */
+int sc68_render(sc68_t * sc68, void * buf, int max, int * done, int flags);
+
+SC68_API
+/**
+ * Get the marks of the last sc68_render() call.
+ *
+ * @param  sc68  sc68 instance.
+ * @param  n     Receive the number of marks (can be 0).
+ *
+ * @return mark array (in buffer order)
+ * @retval 0 on error
+ */
+const sc68_mark_t * sc68_render_marks(sc68_t * sc68, int * n);
+
 SC68_API
 /**
  * Set/Get current track.
@@ -575,6 +732,114 @@ int sc68_tag_enum(sc68_t * sc68, sc68_tag_t * tag,
  */
 
 
+/**
+ * @name Streaming functions.
+ *
+ *   A stream owns a producer thread that renders the music of an
+ *   sc68 instance ahead of time into a lock-free ring buffer. The
+ *   consumer (a single thread, usually an audio callback) pulls PCM
+ *   with a wait-free sc68_stream_read(). Control commands are queued and run by the
+ *   producer thread ; PCM rendered before a command is dropped.
+ *
+ *   While a stream exists the sc68 instance belongs to its producer
+ *   thread. Only functions that do not process music (information,
+ *   tags ...) may be called on it.
+ *
+ *   Streams need libsc68 compiled with thread support.
+ *
+ * @{
+ */
+
+SC68_API
+/**
+ * Create a background stream.
+ *
+ *   The stream starts rendering the current track (if any)
+ *   immediately. Use sc68_stream_play() to change track.
+ *
+ * @param  sc68    sc68 instance (with a disk loaded).
+ * @param  frames  ring buffer size in PCM (0 for default ~1 sec).
+ *
+ * @return stream instance
+ * @retval 0 on error
+ */
+sc68_stream_t * sc68_stream_create(sc68_t * sc68, int frames);
+
+SC68_API
+/**
+ * Stop the producer thread and destroy a stream.
+ *
+ * @param  stream  stream instance (can be 0).
+ */
+void sc68_stream_destroy(sc68_stream_t * stream);
+
+SC68_API
+/**
+ * Read PCM from a stream (wait-free).
+ *
+ *   The sc68_stream_read() function copies up to n PCM already
+ *   rendered by the producer thread and returns immediately. It
+ *   never blocks ; a short count means the producer is late or the
+ *   music is over.
+ *
+ * @param  stream  stream instance.
+ * @param  buf     PCM buffer (see sc68_process()).
+ * @param  n       Maximum number of PCM to read.
+ * @param  status  Receive the events (SC68_LOOP, SC68_CHANGE or
+ *                 SC68_END) reached by this read (can be 0).
+ *
+ * @return number of PCM read
+ * @retval -1 on error
+ */
+int sc68_stream_read(sc68_stream_t * stream, void * buf, int n, int * status);
+
+SC68_API
+/**
+ * Queue a play command.
+ *
+ * @param  stream  stream instance.
+ * @param  track   track number (see sc68_play())
+ * @param  loop    number of loop (see sc68_play())
+ *
+ * @return error code
+ * @retval  0  Success.
+ * @retval -1  Failure (command queue is full).
+ */
+int sc68_stream_play(sc68_stream_t * stream, int track, int loop);
+
+SC68_API
+/**
+ * Queue a stop command.
+ *
+ * @param  stream  stream instance.
+ *
+ * @return error code
+ * @retval  0  Success.
+ * @retval -1  Failure (command queue is full).
+ */
+int sc68_stream_stop(sc68_stream_t * stream);
+
+SC68_API
+/**
+ * Queue a seek command.
+ *
+ *   The producer restarts the current track if needed and renders
+ *   (without output) up to the requested position.
+ *
+ * @param  stream  stream instance.
+ * @param  ms      position in the current track (in ms).
+ *
+ * @return error code
+ * @retval  0  Success.
+ * @retval -1  Failure (command queue is full).
+ */
+int sc68_stream_seek(sc68_stream_t * stream, int ms);
+
+/**
+ * @}
+ */
+
+
 /**
  * @name File functions.
  * @{
@@ -625,6 +890,12 @@ int sc68_load_mem(sc68_t * sc68, const void * buffer, int len);
 /**
  * Load an sc68 disk outside the API.
  *
+ *   Disks are reference counted. A loaded disk has one reference
+ *   owned by the caller. Each sc68 instance the disk is opened with
+ *   holds its own reference so that a single disk can be opened by
+ *   any number of instances, in any thread. A disk is destroyed with
+ *   its last reference. It must not be modified once it is shared.
+ *
  * @note Free it with sc68_disk_free() function.
  */
 SC68_API
@@ -633,9 +904,74 @@ SC68_API
 sc68_disk_t sc68_load_disk_uri(const char * uri);
 SC68_API
 sc68_disk_t sc68_disk_load_mem(const void * buffer, int len);
+
 SC68_API
+/**
+ * Add a reference to a disk.
+ *
+ * @param  disk  loaded or probed disk
+ * @return disk
+ * @retval 0 on error
+ */
+sc68_disk_t sc68_disk_retain(sc68_disk_t disk);
+
+SC68_API
+/**
+ * Release a reference to a disk (destroyed with the last one).
+ *
+ * @param  disk  loaded or probed disk (can be 0)
+ */
 void sc68_disk_free(sc68_disk_t disk);
 
+SC68_API
+/**
+ * Set the shared disk cache capacity.
+ *
+ *   The process-wide disk cache keeps the most recently used disks
+ *   loaded by sc68_disk_cache_uri() and sc68_disk_cache_mem(). When
+ *   it is enabled sc68_load_uri() and sc68_load_mem() use it too, so
+ *   that a file is loaded once for all instances. The default comes
+ *   from the "disk-cache" option (0 disables the cache).
+ *
+ * @param  max  maximum number of cached disks (0 flushes and
+ *              disables the cache, -1 to query)
+ * @return previous capacity
+ */
+int sc68_disk_cache(int max);
+
+SC68_API
+/**
+ * Get a disk through the shared disk cache.
+ *
+ *   sc68_disk_cache_uri() is keyed by the URI and, for local files,
+ *   by the file size and modification time so that a modified file
+ *   is loaded again. sc68_disk_cache_mem() is keyed by the content
+ *   of the buffer (a copy is kept in the cache). If the disk is not
+ *   cached it is loaded (and cached if the cache is enabled).
+ *
+ * @return disk with a reference owned by the caller
+ * @retval 0 on error
+ * @note Release it with sc68_disk_free() function.
+ */
+sc68_disk_t sc68_disk_cache_uri(const char * uri);
+SC68_API
+sc68_disk_t sc68_disk_cache_mem(const void * buffer, int len);
+
+/**
+ * Probe an sc68 disk information without loading music data.
+ *
+ *   Probed disks are much faster to get than loaded ones. They can
+ *   be used with sc68_music_info() and sc68_tag functions but can
+ *   not be played.
+ *
+ * @note Free it with sc68_disk_free() function.
+ * @see file68_probe()
+ */
+SC68_API
+sc68_disk_t sc68_probe_disk(vfs68_t * is);
+SC68_API
+sc68_disk_t sc68_probe_disk_uri(const char * uri);
+
 SC68_API
 /**
  * Change current disk.
@@ -648,9 +984,9 @@ SC68_API
  * @retval -1 Failure, no disk has been loaded (occurs if disk was 0).
  *
  * @note    Can be safely call with null sc68.
- * @warning After sc68_open() failure, the disk has been freed.
- * @warning Beware not to use disk information after sc68_close() call
- *         because the disk should have been destroyed.
+ * @note    The instance holds its own reference on the disk until
+ *          sc68_close(). The caller still has to sc68_disk_free() its
+ *          own reference, even after a failure.
  */
 int sc68_open(sc68_t * sc68, sc68_disk_t disk);
 
@@ -44,6 +44,7 @@
 #include "emu68/emu68.h"
 #include "emu68/excep68.h"
 #include "emu68/ioplug68.h"
+#include "emu68/clock68.h"
 #include "io68/io68.h"
 
 /* file68 includes */
@@ -66,6 +67,10 @@
 #include <libgen.h>
 #endif
 
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
+
 #define MK4CC(A,B,C,D) (((int)(A)<<24)|((int)(B)<<16)|((int)(C)<<8)|((int)(D)))
 
 
@@ -94,6 +99,8 @@ enum {
   SC68_MAGIC = MK4CC('s','c','6','8'),
   /* disk68_t magic identifier value. */
   DISK_MAGIC = SC68_DISK_ID,
+  /* probed disk68_t (no music data) magic identifier value. */
+  PROBE_MAGIC = SC68_PROBE_ID,
   /* Error message maximum length */
   ERRMAX = 96,
   /* Default amiga blend */
@@ -149,6 +156,8 @@ static struct {
   int asid;
   int def_time_ms;
   int spr;
+  int preload;
+  int disk_cache;
 } config;
 
 /** sc68 instance. */
@@ -170,7 +179,6 @@ struct _sc68_s {
   mw_t         * mw;          /**< MicroWire emulator.                   */
   paula_t      * paula;       /**< Amiga emulator.                       */
 
-  int            tobe3;       /**< free disk memory be release on close. */
   const disk68_t  * disk;     /**< Current loaded disk.                  */
   const music68_t * mus;      /**< Current playing music.                */
   int            track;       /**< Current playing track.                */
@@ -187,6 +195,38 @@ struct _sc68_s {
   int            seek_to;     /**< Seek to this time (-1:n/a)            */
   int            remote;      /**< Allow remote access.                  */
 
+/** Post reset templates [0:Atari,1:Amiga] (see reset_emulators()). */
+  struct {
+    u8         * low;         /**< Low memory image (0:not captured).    */
+    u8           top[32];     /**< Trap init stack image (Atari only).   */
+    reg68_t      reg;         /**< 68K registers.                        */
+    cycle68_t    cycle;       /**< 68K cycle counter.                    */
+    mfp_t        mfp;         /**< MFP state (Atari only).               */
+  } tpl[2];
+
+/** Next track pre-initialization (see preload_start()). */
+  struct {
+    int          enabled;     /**< From config "preload-track".          */
+#ifdef USE_THREADS
+    sc68_t     * spare;       /**< Spare instance for the next track.    */
+    pthread_t    thread;      /**< Thread running change_track().        */
+    int          state;       /**< PRELOAD_NONE, _RUN or _DONE.          */
+    int          track;       /**< Track being prepared.                 */
+    int          status;      /**< change_track() return code.           */
+#endif
+  } next;
+
+#ifdef USE_STATS
+/** Performance counters (see SC68_GET_STATS). */
+  struct {
+    sc68_stats_t    cnt;      /**< Public counters.                      */
+    sc68_counters_t cur;      /**< Counters of the running pass.         */
+    uint68_t        nirq;     /**< 68K interrupts at pass start.         */
+    unsigned int    ym_ovf;   /**< YM overflows at pass start.           */
+    u64             ym_flt;   /**< YM filter time at pass start.         */
+  } stats;
+#endif
+
   struct {
     int org_ms;
     int len_ms;
@@ -219,6 +259,15 @@ struct _sc68_s {
     int            stdlen;       /**< Default number of PCM per pass.    */
     unsigned int   cycleperpass; /**< Number of 68K cycles per pass.     */
     int            aga_blend;    /**< Amiga LR blend factor [0..65535].  */
+    int            pcmfmt;       /**< Output PCM format (sc68_pcm_e).    */
+    int            nmarks;       /**< Marks of the last sc68_render().   */
+    sc68_mark_t    marks[SC68_MARK_MAX]; /**< Render marks.              */
+    u32          * stembuf;      /**< Stems buffers (SC68_STEM_MAX).     */
+    int            stemmax;      /**< Allocated size of each stem.       */
+    int            stemok;       /**< Current pass has rendered stems.   */
+    s32          * wide;         /**< Unclipped L/R pairs (wide formats).*/
+    int            widemax;      /**< Allocated size of wide (in PCM).   */
+    int            wideok;       /**< Current pass has rendered wide.    */
 
     unsigned int   pass_count;   /**< Pass counter.                      */
     unsigned int   loop_count;   /**< Loop counter.                      */
@@ -273,6 +322,7 @@ static sc68_disk_t get_dt(sc68_t * sc68, int * ptr_track, sc68_disk_t disk);
 static int calc_disk_len(const disk68_t * disk, const int loop);
 static unsigned int calc_track_len(const disk68_t * d, int track, int loop);
 static unsigned int calc_pos(sc68_t * const sc68);
+static void preload_destroy(sc68_t * sc68);
 static void music_info(sc68_t * sc68, sc68_music_info_t * f,
                        const disk68_t * d, int track, int loops);
 
@@ -310,6 +360,11 @@ static inline int is_disk(const disk68_t * const disk) {
   return disk && disk->magic == DISK_MAGIC;
 }
 
+/* loaded or probed disk (only usable for information) */
+static inline int is_info_disk(const disk68_t * const disk) {
+  return disk && (disk->magic == DISK_MAGIC || disk->magic == PROBE_MAGIC);
+}
+
 static inline int null_or_disk(const disk68_t * const disk) {
   return !disk || disk->magic == DISK_MAGIC;
 }
@@ -370,18 +425,6 @@ static void appname_from_path(char *path, char * appname, int max)
  * Emulators functions
  **********************************************************************/
 
-static int stream_read_68k(sc68_t * sc68, unsigned int dest,
-                           vfs68_t * is, unsigned int sz)
-{
-  u8 * mem68 = emu68_memptr(sc68->emu68, dest, sz);
-
-  if (!mem68)
-    return error_addx(sc68,
-                      "libsc68: %s -- %s\n",
-                      "vfs error", emu68_error_get(sc68->emu68));
-  return (vfs68_read(is, mem68, sz) == sz) ? 0 : -1;
-}
-
 static int init_emu68(int * argc, char ** argv)
 {
   int err;
@@ -423,6 +466,8 @@ static void safe_emu68_destroy(emu68_t **pemu)
 static void safe_destroy(sc68_t * sc68)
 {
   assert(sc68);
+  free(sc68->tpl[0].low); sc68->tpl[0].low = 0;
+  free(sc68->tpl[1].low); sc68->tpl[1].low = 0;
   emu68_ioplug_unplug_all(sc68->emu68);
   safe_io68_destroy(&sc68->ymio);
   safe_io68_destroy(&sc68->mwio);
@@ -874,6 +919,8 @@ static void config_default(void)
 #endif
   config.def_time_ms  = TIME_DEF * 1000;
   config.spr          = SPR_DEF;
+  config.preload      = 0;
+  config.disk_cache   = 0;
 }
 
 #define set_CONFIG(KEY,NAME) config.KEY = optcfg_get_int(NAME,config.KEY)
@@ -899,6 +946,9 @@ static int config_load(const char * appname)
   set_CONFIG(asid,"asid");
   config.def_time_ms = optcfg_get_int("default-time", TIME_DEF) * 1000;
   set_CONFIG(spr,"sampling-rate");
+  set_CONFIG(preload,"preload-track");
+  set_CONFIG(disk_cache,"disk-cache");
+  sc68_disk_cache(config.disk_cache);
 
   sc68_debug(0,"libsc68: load config -- %s\n", strok68(err));
   return err;
@@ -986,6 +1036,7 @@ static void config_apply(sc68_t * sc68)
     /* sc68->cfg_asid      = config.asid; */
     sc68->time.def_ms   = config.def_time_ms;
     sc68->mix.spr       = config.spr;
+    sc68->next.enabled  = config.preload;
     TRACE68(sc68_cat,
             "libsc68: sc68<%s> %s\n",
             sc68->name, "config applied");
@@ -1078,6 +1129,9 @@ int sc68_init(sc68_init_t * init)
   /* Setup init flags. */
   initflags = init->flags;
 
+  /* Initialize mixer. */
+  mixer68_init(&init->argc, init->argv);
+
   /* Add and parse local options. */
   option68_append(debug_options,sizeof(debug_options)/sizeof(*debug_options));
   init->argc = option68_parse(init->argc, init->argv);
@@ -1120,6 +1174,7 @@ void sc68_shutdown(void)
 
   if (sc68_init_flag) {
     sc68_init_flag = 0;
+    sc68_disk_cache(0);
     file68_shutdown();
     config68_shutdown();          /* always after file68_shutdown() */
   }
@@ -1162,6 +1217,7 @@ sc68_t * sc68_create(sc68_create_t * create)
   config_apply(sc68);
 
   /* Override config. */
+  sc68->mix.pcmfmt = SC68_PCM_S16;
   if (create->sampling_rate) {
     sc68->mix.spr = create->sampling_rate;
   }
@@ -1226,7 +1282,10 @@ void sc68_destroy(sc68_t * sc68)
 {
   if (is_sc68(sc68)) {
     free(sc68->mix.buffer);
+    free(sc68->mix.stembuf);
+    free(sc68->mix.wide);
     sc68_close(sc68);
+    preload_destroy(sc68);
     safe_destroy(sc68);
     sc68_debug(sc68,"libsc68: sc68<%s> destroyed\n", sc68->name);
     free(sc68);
@@ -1266,12 +1325,99 @@ static int set_spr(sc68_t * sc68, int hz)
 
 static int get_pcm_fmt(sc68_t * sc68)
 {
-  return SC68_PCM_S16;
+  return is_sc68(sc68) ? sc68->mix.pcmfmt : SC68_PCM_S16;
 }
 
 static int set_pcm_fmt(sc68_t * sc68, int pcmfmt)
 {
-  return -(pcmfmt != SC68_PCM_S16);
+  switch (pcmfmt) {
+  case SC68_PCM_S16: case SC68_PCM_F32: case SC68_PCM_S24:
+    if (is_sc68(sc68)) {
+      TRACE68(sc68_cat,"libsc68: pcm format -- *%d*\n", pcmfmt);
+      sc68->mix.pcmfmt = pcmfmt;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* Size of a stereo PCM in the output format. */
+static int pcm_size(const int pcmfmt)
+{
+  return pcmfmt == SC68_PCM_S16 ? 4 : 8;
+}
+
+/* Convert 16-bit stereo PCM to the output format. */
+static void pcm_convert(const int pcmfmt, void * dst, u32 * src, int n)
+{
+  switch (pcmfmt) {
+  case SC68_PCM_F32:
+    mixer68_stereo_FL_LR(dst, src, n, 0, 1.0f);
+    break;
+  case SC68_PCM_S24:
+    mixer68_stereo_24_LR(dst, src, n, 0);
+    break;
+  default:
+    mixer68_copy(dst, src, n);
+  }
+}
+
+/* Convert the unclipped 32-bit pairs of a wide pass to the output
+ * format. Clipping only happens here (not at all for float).
+ */
+static void pcm_convert_wide(const int pcmfmt, void * _dst,
+                             const s32 * src, int n)
+{
+  int i;
+
+  n <<= 1;
+  switch (pcmfmt) {
+  case SC68_PCM_F32: {
+    float * const dst = _dst;
+    for (i = 0; i < n; ++i)
+      dst[i] = (float) src[i] * (1.0f / 32768.0f);
+  } break;
+  case SC68_PCM_S24: {
+    s32 * const dst = _dst;
+    for (i = 0; i < n; ++i) {
+      const int v = src[i];
+      dst[i] = v < -32768 ? -0x800000 : v > 32767 ? 0x7FFFFF : v * 256;
+    }
+  } break;
+  default: {
+    u32 * const dst = _dst;
+    for (i = 0; i < n; i += 2) {
+      const int l = src[i+0] < -32768 ? -32768
+        : src[i+0] > 32767 ? 32767 : src[i+0];
+      const int r = src[i+1] < -32768 ? -32768
+        : src[i+1] > 32767 ? 32767 : src[i+1];
+      dst[i>>1] = (u16) l | ( (u32) r << 16 );
+    }
+  }
+  }
+}
+
+/* Duplicate mono samples into 32-bit pairs. */
+static void wide_dup(s32 * dst, const s32 * src, int n)
+{
+  while (n-- > 0) {
+    *dst++ = *src;
+    *dst++ = *src++;
+  }
+}
+
+/* Blend 32-bit pairs left and right (same as mixer68_blend_LR()). */
+static void wide_blend(s32 * dst, int n, const int factor)
+{
+  const s64 oof = 65536 - factor;
+
+  if (factor <= 0)
+    return;
+  while (n-- > 0) {
+    const s64 l = dst[0], r = dst[1];
+    *dst++ = ( l * oof + r * factor ) >> 16;
+    *dst++ = ( r * oof + l * factor ) >> 16;
+  }
 }
 
 static int get_asid(const sc68_t * sc68)
@@ -1359,6 +1505,88 @@ static void stop_track(sc68_t * sc68, const int real_stop)
   sc68->mix.buflen      = 0;
 }
 
+#ifdef USE_STATS
+
+# define stats_count(S,F) (++(S)->stats.cur.F)
+
+/* Start counting an emulation pass. */
+static u64 stats_begin(sc68_t * sc68)
+{
+  sc68->stats.nirq   = sc68->emu68->nirq;
+  sc68->stats.ym_ovf = sc68->ym->event_ovf;
+  sc68->stats.ym_flt = sc68->ym->filter_ns;
+  return clock68_ns();
+}
+
+/* Account time spent in a stage since t0. */
+static u64 stats_lap(sc68_t * sc68, int stage, u64 t0)
+{
+  const u64 t1 = clock68_ns();
+  sc68->stats.cur.ns[stage] += t1 - t0;
+  return t1;
+}
+
+/* Account the 68K stage (must be called before the YM runs). */
+static u64 stats_emu(sc68_t * sc68, u64 t0)
+{
+  sc68_counters_t * const cur = &sc68->stats.cur;
+  const ym_t * const ym = sc68->ym;
+
+  cur->instructions += PLAY_MAX_INST - sc68->emu68->instructions;
+  cur->interrupts   += sc68->emu68->nirq - sc68->stats.nirq;
+  cur->ym_events    += ym->event_ptr - ym->event_buf;
+  cur->ym_overflows += ym->event_ovf >= sc68->stats.ym_ovf
+    ? ym->event_ovf - sc68->stats.ym_ovf
+    : ym->event_ovf;                    /* YM has been reset */
+  return stats_lap(sc68, SC68_STAGE_68K, t0);
+}
+
+/* Close the pass counters. */
+static void stats_end(sc68_t * sc68)
+{
+  sc68_counters_t * const cur = &sc68->stats.cur;
+  sc68_counters_t * const tot = &sc68->stats.cnt.total;
+  const u64 flt = sc68->ym->filter_ns - sc68->stats.ym_flt;
+  int i;
+
+  /* The YM generator time includes its filter. */
+  cur->ns[SC68_STAGE_FILTER] += flt;
+  cur->ns[SC68_STAGE_YM]     -= flt;
+  cur->passes = 1;
+
+  tot->passes       += cur->passes;
+  tot->instructions += cur->instructions;
+  tot->interrupts   += cur->interrupts;
+  tot->ym_events    += cur->ym_events;
+  tot->ym_overflows += cur->ym_overflows;
+  tot->reallocs     += cur->reallocs;
+  for (i = 0; i < SC68_STAGE_MAX; ++i)
+    tot->ns[i] += cur->ns[i];
+  sc68->stats.cnt.last = *cur;
+  memset(cur, 0, sizeof(*cur));
+}
+
+static int get_stats(sc68_t * sc68, sc68_stats_t * stats)
+{
+  if (!stats)
+    memset(&sc68->stats, 0, sizeof(sc68->stats));
+  else
+    *stats = sc68->stats.cnt;
+  return 0;
+}
+
+#else
+
+# define stats_count(S,F) ((void)0)
+
+static u64 stats_begin(sc68_t * sc68) { return 0; }
+static u64 stats_lap(sc68_t * sc68, int stage, u64 t0) { return 0; }
+static u64 stats_emu(sc68_t * sc68, u64 t0) { return 0; }
+static void stats_end(sc68_t * sc68) { }
+static int get_stats(sc68_t * sc68, sc68_stats_t * stats) { return -1; }
+
+#endif
+
 static int finish(sc68_t * sc68, addr68_t pc, int sr, uint68_t maxinst)
 {
   int status;
@@ -1421,6 +1649,70 @@ static int finish(sc68_t * sc68, addr68_t pc, int sr, uint68_t maxinst)
   return status;
 }
 
+/* Post reset templates.
+ *
+ *   After a reset the 68K memory holds the cleared system variables,
+ *   the exception detection code and, for Atari hardware, the TOS
+ *   trap emulator already initialized by running its init code. This
+ *   state only depends on the hardware family so it is captured the
+ *   first time and then restored by copying the memory areas it
+ *   touches (including the stack used by the trap init code below
+ *   the finish() stack pointer) along with the 68K registers and the
+ *   MFP state. Not used in debug mode as the whole memory and its
+ *   access-control are cleared instead.
+ */
+static int tpl_size(const hwflags68_t hw)
+{
+  return (hw & SC68_AGA) ? TRAP_ADDR : TRAP_ADDR + sizeof(trap_func);
+}
+
+static int tpl_top(const emu68_t * emu68)
+{
+  return emu68->memmsk + 1 - 16 - sizeof(((sc68_t *)0)->tpl[0].top);
+}
+
+static void tpl_save(sc68_t * sc68, const hwflags68_t hw)
+{
+  emu68_t * const emu68 = sc68->emu68;
+  const int aga = !!(hw & SC68_AGA), size = tpl_size(hw);
+
+  if (emu68_debugmode(emu68) || sc68->tpl[aga].low)
+    return;
+  sc68->tpl[aga].low = malloc(size);
+  if (!sc68->tpl[aga].low)
+    return;
+  memcpy(sc68->tpl[aga].low, emu68->mem, size);
+  sc68->tpl[aga].reg   = emu68->reg;
+  sc68->tpl[aga].cycle = emu68->cycle;
+  if (!aga) {
+    memcpy(sc68->tpl[aga].top, emu68->mem + tpl_top(emu68),
+           sizeof(sc68->tpl[aga].top));
+    sc68->tpl[aga].mfp = *mfpio_emulator(sc68->mfpio);
+  }
+  TRACE68(sc68_cat," -> %s template captured (%d bytes)\n",
+          aga ? "amiga" : "atari", size);
+}
+
+/* Restore a captured template (emulators must have been reset). */
+static int tpl_restore(sc68_t * sc68, const hwflags68_t hw)
+{
+  emu68_t * const emu68 = sc68->emu68;
+  const int aga = !!(hw & SC68_AGA);
+
+  if (emu68_debugmode(emu68) || !sc68->tpl[aga].low)
+    return -1;
+  memcpy(emu68->mem, sc68->tpl[aga].low, tpl_size(hw));
+  emu68->reg   = sc68->tpl[aga].reg;
+  emu68->cycle = sc68->tpl[aga].cycle;
+  if (!aga) {
+    memcpy(emu68->mem + tpl_top(emu68), sc68->tpl[aga].top,
+           sizeof(sc68->tpl[aga].top));
+    *mfpio_emulator(sc68->mfpio) = sc68->tpl[aga].mfp;
+  }
+  TRACE68(sc68_cat," -> %s template restored\n", aga ? "amiga" : "atari");
+  return 0;
+}
+
 static int reset_emulators(sc68_t * sc68, const hwflags68_t hw)
 {
   u8 * memptr;
@@ -1457,10 +1749,18 @@ static int reset_emulators(sc68_t * sc68, const hwflags68_t hw)
   }
   emu68_reset(sc68->emu68);
 
+  /* Give back the memory pages touched by the previous track. */
+  if (!emu68_debugmode(sc68->emu68) && !emu68_memdiscard(sc68->emu68,0,0))
+    TRACE68(sc68_cat," -> %s\n","discard 68k memory");
+
+  if (!tpl_restore(sc68, hw))
+    return SC68_OK;
+
   /* disable that we should not need it */
   if (emu68_debugmode(sc68->emu68)) {
     TRACE68(sc68_cat," -> %s\n","clear 68k memory");
-    emu68_memset(sc68->emu68,0,0,0);
+    if (emu68_memdiscard(sc68->emu68,0,0))
+      emu68_memset(sc68->emu68,0,0,0);
     /* This is done by emu68_reset() */
     /* emu68_chkset(sc68->emu68,0,0,0); */
   }
@@ -1523,30 +1823,25 @@ static int reset_emulators(sc68_t * sc68, const hwflags68_t hw)
       return SC68_ERROR;
     }
   }
+  tpl_save(sc68, hw);
   return SC68_OK;
 }
 
 static int load_replay(sc68_t * sc68, const char * replay, int a0)
 {
-  int err, size;
-  vfs68_t * is;
-  char rname[256];
+  const void * data;
+  int size;
   assert(sc68);
   assert(replay);
 
   TRACE68(sc68_cat, " -> external replay -- %s\n", replay);
-  strcpy(rname,"sc68://replay/");
-  strcat68(rname, replay, sizeof(rname)-1);
-  rname[sizeof(rname)-1] = 0;
-  is = uri68_vfs(rname, 1, 0);
-  err = vfs68_open(is);
-  err = err || (size = vfs68_length(is), size < 0);
-  err = err || stream_read_68k(sc68, a0, is, size);
-  vfs68_destroy(is);
-  if (err) {
+
+  /* Replay images are shared and cached by the resource manager. */
+  if (rsc68_get_replay(replay, &data, &size) ||
+      emu68_memput(sc68->emu68, a0, (const u8 *)data, size)) {
     error_add(sc68,
               "libsc68: failed to load external replay -- %s",
-              rname);
+              replay);
     return SC68_ERROR;
   }
   TRACE68(sc68_cat," -> external replay -- [%06x-%06x]\n", a0, a0+size-1);
@@ -1832,6 +2127,7 @@ static int change_track(sc68_t * sc68, int track)
         error_add(sc68,"libsc68: %s\n", strerror(errno));
         return SC68_ERROR;
       }
+      stats_count(sc68, reallocs);
       sc68->mix.bufmax = sc68->mix.bufreq;
     }
   }
@@ -1864,6 +2160,204 @@ static int check_track_range(sc68_t * const sc68,
   return 0;
 }
 
+/***********************************************************************
+ * Next track pre-initialization
+ *
+ *   Initializing a track (change_track()) resets the emulators, loads
+ *   the replay and the music data and runs the music init code. Some
+ *   replays take many milliseconds to do so. When the current track
+ *   is going to be followed by the next one, this next track is
+ *   initialized in background on a spare set of emulators owned by a
+ *   spare sc68 instance. At the boundary both sets are swapped.
+ **********************************************************************/
+
+#ifdef USE_THREADS
+
+enum {
+  PRELOAD_NONE, PRELOAD_RUN, PRELOAD_DONE
+};
+
+static void * preload_thread(void * arg)
+{
+  sc68_t * const sc68 = arg;
+  sc68->next.status = change_track(sc68->next.spare, sc68->next.track);
+  return 0;
+}
+
+/* Wait for the preparation thread. */
+static void preload_wait(sc68_t * sc68)
+{
+  if (sc68->next.state == PRELOAD_RUN) {
+    pthread_join(sc68->next.thread, 0);
+    sc68->next.state = PRELOAD_DONE;
+  }
+}
+
+/* Forget the prepared track. */
+static void preload_cancel(sc68_t * sc68)
+{
+  preload_wait(sc68);
+  sc68->next.state = PRELOAD_NONE;
+  if (sc68->next.spare)
+    sc68->next.spare->disk = 0;
+}
+
+/* Destroy the spare instance. */
+static void preload_destroy(sc68_t * sc68)
+{
+  sc68_t * const spare = sc68->next.spare;
+
+  preload_cancel(sc68);
+  if (spare) {
+    free(spare->mix.buffer);
+    safe_destroy(spare);
+    free(spare);
+    sc68->next.spare = 0;
+  }
+}
+
+/* Check that the spare emulators have the settings of the instance
+ * ones (sampling rate apart) as they are swapped at the boundary.
+ */
+static int preload_same(const sc68_t * sc68, const sc68_t * spare)
+{
+  const ym_t * const ym = sc68->ym, * const sym = spare->ym;
+
+  return ym->engine == sym->engine && ym->volmodel == sym->volmodel
+    && ym->clock == sym->clock && ym->voice_mute == sym->voice_mute
+    && (ym->engine != YM_ENGINE_PULS
+        || ym->emu.puls.ifilter == sym->emu.puls.ifilter)
+    && sc68->paula->engine == spare->paula->engine
+    && sc68->paula->clock  == spare->paula->clock
+    && sc68->mw->engine    == spare->mw->engine;
+}
+
+/* Create the spare instance and copy the emulators settings. A YM
+ * engine can not be changed once set up: a spare created with
+ * another engine is created again with the current defaults and no
+ * track is prepared if it still differs.
+ */
+static sc68_t * preload_spare(sc68_t * sc68)
+{
+  sc68_t * spare = sc68->next.spare;
+
+  if (spare && spare->ym->engine != sc68->ym->engine) {
+    preload_destroy(sc68);
+    spare = 0;
+  }
+  if (!spare) {
+    spare = calloc(sizeof(sc68_t),1);
+    if (!spare)
+      return 0;
+    spare->magic = SC68_MAGIC;
+    snprintf(spare->name, sizeof(spare->name), "%.14s+", sc68->name);
+    if (init68k(spare, sc68->emu68_parms.log2mem, sc68->emu68_parms.debug)) {
+      free(spare);
+      return 0;
+    }
+    sc68->next.spare = spare;
+  }
+  if (spare->ym->engine != sc68->ym->engine)
+    return 0;
+  ym_volume_model(spare->ym, sc68->ym->volmodel);
+  spare->ym->voice_mute = sc68->ym->voice_mute;
+  if (sc68->ym->engine == YM_ENGINE_PULS)
+    spare->ym->emu.puls.ifilter = sc68->ym->emu.puls.ifilter;
+  paula_engine(spare->paula, sc68->paula->engine);
+  paula_clock(spare->paula, sc68->paula->clock);
+  if (spare->mw->engine != sc68->mw->engine)
+    mw_engine(spare->mw, sc68->mw->engine);
+  if (spare->mix.spr != sc68->mix.spr)
+    set_spr(spare, sc68->mix.spr);
+  spare->asid        = sc68->asid;
+  spare->time.def_ms = sc68->time.def_ms;
+  spare->loop_to     = sc68->loop_to;
+  spare->disk        = sc68->disk;
+  memcpy(spare->tinfo, sc68->tinfo, sizeof(sc68->tinfo));
+  return spare;
+}
+
+/* Start preparing the track following the current one (if any). */
+static void preload_start(sc68_t * sc68)
+{
+  const int track = sc68->track + 1;
+
+  if (!sc68->next.enabled || !sc68->mix.pass_total ||
+      sc68->disk->force_track || track > sc68->disk->nb_mus)
+    return;
+
+  preload_cancel(sc68);
+  if (!preload_spare(sc68))
+    return;
+  sc68->next.track = track;
+  if (!pthread_create(&sc68->next.thread, 0, preload_thread, sc68)) {
+    sc68->next.state = PRELOAD_RUN;
+    TRACE68(sc68_cat,"libsc68: preload track -- *%02d*\n", track);
+  }
+}
+
+#define SWAP(A,B,T) do { T _t = (A); (A) = (B); (B) = _t; } while (0)
+
+/* Swap with the prepared track if it is the requested one. */
+static int preload_swap(sc68_t * sc68, int track)
+{
+  sc68_t * const spare = sc68->next.spare;
+
+  if (sc68->next.state == PRELOAD_NONE)
+    return -1;
+  preload_wait(sc68);
+  sc68->next.state = PRELOAD_NONE;
+  if (sc68->next.status != SC68_OK || sc68->next.track != track ||
+      spare->loop_to != sc68->loop_to || spare->asid != sc68->asid ||
+      spare->mix.spr != sc68->mix.spr || !preload_same(sc68, spare))
+    return -1;
+
+  stop_track(sc68, 0);
+  SWAP(sc68->emu68,     spare->emu68,     emu68_t *);
+  SWAP(sc68->ymio,      spare->ymio,      io68_t *);
+  SWAP(sc68->mwio,      spare->mwio,      io68_t *);
+  SWAP(sc68->shifterio, spare->shifterio, io68_t *);
+  SWAP(sc68->paulaio,   spare->paulaio,   io68_t *);
+  SWAP(sc68->mfpio,     spare->mfpio,     io68_t *);
+  SWAP(sc68->ym,        spare->ym,        ym_t *);
+  SWAP(sc68->mw,        spare->mw,        mw_t *);
+  SWAP(sc68->paula,     spare->paula,     paula_t *);
+  emu68_set_cookie(sc68->emu68, sc68);
+  emu68_set_cookie(spare->emu68, spare);
+
+  sc68->irq         = spare->irq;
+  sc68->playaddr    = spare->playaddr;
+  sc68->asid_timers = spare->asid_timers;
+  sc68->mus         = spare->mus;
+  sc68->track       = spare->track;
+  sc68->info        = spare->info;
+  SWAP(sc68->mix.buffer, spare->mix.buffer, u32 *);
+  SWAP(sc68->mix.bufmax, spare->mix.bufmax, int);
+  sc68->mix.bufreq       = spare->mix.bufreq;
+  sc68->mix.stdlen       = spare->mix.stdlen;
+  sc68->mix.cycleperpass = spare->mix.cycleperpass;
+  sc68->mix.loop_total   = spare->mix.loop_total;
+  sc68->mix.pass_total   = spare->mix.pass_total;
+  sc68->mix.pass_2loop   = spare->mix.pass_2loop;
+  sc68->mix.pass_3loop   = spare->mix.pass_3loop;
+#ifdef USE_STATS
+  sc68->stats.cur.reallocs += spare->stats.cur.reallocs;
+  spare->stats.cur.reallocs = 0;
+#endif
+
+  TRACE68(sc68_cat,"libsc68: preloaded track -- *%02d*\n", track);
+  return 0;
+}
+
+#else
+
+static void preload_cancel(sc68_t * sc68) {}
+static void preload_destroy(sc68_t * sc68) {}
+static void preload_start(sc68_t * sc68) {}
+static int preload_swap(sc68_t * sc68, int track) { return -1; }
+
+#endif
+
 /** Start current music of current disk.
  */
 static int apply_change_track(sc68_t * const sc68)
@@ -1893,135 +2387,374 @@ static int apply_change_track(sc68_t * const sc68)
   if (check_track_range(sc68, sc68->disk, track))
     return SC68_ERROR;
 
-  if (change_track(sc68, track/* , loop */) != SC68_OK)
+  if (preload_swap(sc68, track) &&
+      change_track(sc68, track/* , loop */) != SC68_OK)
     return SC68_ERROR;
 
   return SC68_CHANGE;
 }
 
-int sc68_process(sc68_t * sc68, void * buf16st, int * _n)
+/* Get stem buffers for the next pass (0 if not requested). */
+static u32 * stems_setup(sc68_t * sc68, void * const stems[SC68_STEM_MAX])
 {
-  int ret;
+  int i;
 
-  if (!is_sc68(sc68)) {
-    ret = SC68_ERROR;
-  } else if (!_n) {
-    /* Flush internal PCM buffer and apply change track request. */
-    ret = SC68_IDLE | apply_change_track(sc68);
-  } else if (!buf16st) {
-    ret = SC68_ERROR;
-  } else {
-    int n = *_n;
-    ret = (n < 0) ? SC68_ERROR : SC68_IDLE;
+  sc68->mix.stemok = 0;
+  if (!stems)
+    return 0;
+  for (i = 0; i < SC68_STEM_MAX && !stems[i]; ++i)
+    ;
+  if (i == SC68_STEM_MAX)
+    return 0;
 
-    while (n > 0) {
-      int len;
+  if (sc68->mix.stemmax < sc68->mix.bufmax) {
+    free(sc68->mix.stembuf);
+    sc68->mix.stemmax = 0;
+    sc68->mix.stembuf =
+      malloc(sc68->mix.bufmax * SC68_STEM_MAX * sizeof(u32));
+    if (!sc68->mix.stembuf) {
+      error_add(sc68,"libsc68: %s\n", strerror(errno));
+      return 0;
+    }
+    sc68->mix.stemmax = sc68->mix.bufmax;
+  }
+  sc68->mix.stemok = 1;
+  return sc68->mix.stembuf;
+}
 
-      /* No more pcm in internal buffer ... */
-      if (!sc68->mix.buflen) {
-        int status;
+/* Get the wide buffer for the next pass (0 if not needed or on
+ * error, setting mix.wideok accordingly).
+ */
+static s32 * wide_setup(sc68_t * sc68)
+{
+  sc68->mix.wideok = 0;
+  if (sc68->mix.pcmfmt == SC68_PCM_S16)
+    return 0;
 
-        /* Checking for loop */
-        if (sc68->mix.pass_2loop && !--sc68->mix.pass_2loop) {
-          sc68->mix.pass_2loop = sc68->mix.pass_3loop;
-          sc68->mix.loop_count++;
-          ret |= SC68_LOOP;
-        }
+  if (sc68->mix.widemax < sc68->mix.bufmax) {
+    free(sc68->mix.wide);
+    sc68->mix.widemax = 0;
+    sc68->mix.wide = malloc(sc68->mix.bufmax * 2 * sizeof(s32));
+    if (!sc68->mix.wide) {
+      error_add(sc68,"libsc68: %s\n", strerror(errno));
+      return 0;
+    }
+    sc68->mix.widemax = sc68->mix.bufmax;
+  }
+  sc68->mix.wideok = 1;
+  return sc68->mix.wide;
+}
 
-        /* Checking for end */
-        if (sc68->mix.pass_total &&
-            sc68->mix.pass_count >= sc68->mix.pass_total) {
-          int next_track = sc68->track+1;
-          sc68->track_to =
-            (sc68->disk->force_track || next_track > sc68->disk->nb_mus)
-            ? -1                        /* stop */
-            : next_track                /* next track */
-            ;
-          sc68->seek_to  = -1;
-        }
+/* Clear stems [from..to[ */
+static void stems_clear(s32 * const st[SC68_STEM_MAX],
+                        int from, int to, int len)
+{
+  for ( ; from < to; ++from)
+    mixer68_fill((u32 *)st[from], len, 0);
+}
 
-        ret |= apply_change_track(sc68);
-        if (ret & (SC68_END|SC68_CHANGE)) /* exit on error|end|change */
-          break;
-        ret &= ~SC68_IDLE;              /* No more idle */
-
-        /* setup aSID */
-        if (sc68->asid_timers)
-          sc68->emu68->mem[sc68->playaddr+17] = -!!(sc68->asid & SC68_ASID_ON);
-
-        /* Run 68K emulator */
-        status = finish(sc68, sc68->playaddr+8, 0x2300, PLAY_MAX_INST);
-        if (status == EMU68_NRM) {
-          /* $$$ Fix some replays (tao's intensity 200 for one) that
-             assumes the music driver is running under interruption
-             and do not restore the SR by themself. Need to be sure
-             this does not disrupt other musics. */
-          sc68->emu68->reg.sr = 0x2300;
-          status = emu68_interrupt(sc68->emu68, sc68->mix.cycleperpass);
-        }
-        if (status != EMU68_NRM) {
-          error_addx(sc68,
-                     "libsc68: abnormal 68K status %d (%s) in play pass %u\n",
-                     status, emu68_status_name(status),
-                     sc68->mix.pass_count);
-          ret = SC68_ERROR;
-          break;
-        }
+/* Run a new emulation pass into out (at least mix.bufreq PCM). No
+ * pass is run on track change or end (mix.buflen stays 0).
+ *
+ * @return sc68_process() status bits or SC68_ERROR
+ */
+static int run_pass(sc68_t * sc68, u32 * out,
+                    void * const stems[SC68_STEM_MAX])
+{
+  int ret = 0, status, i;
+  s32 * st[SC68_STEM_MAX];
+  u32 * stembuf;
+  s32 * wide;
+  u64 t;
+
+  /* Checking for loop */
+  if (sc68->mix.pass_2loop && !--sc68->mix.pass_2loop) {
+    sc68->mix.pass_2loop = sc68->mix.pass_3loop;
+    sc68->mix.loop_count++;
+    ret |= SC68_LOOP;
+  }
+
+  /* Checking for end */
+  if (sc68->mix.pass_total &&
+      sc68->mix.pass_count >= sc68->mix.pass_total) {
+    int next_track = sc68->track+1;
+    sc68->track_to =
+      (sc68->disk->force_track || next_track > sc68->disk->nb_mus)
+      ? -1                        /* stop */
+      : next_track                /* next track */
+      ;
+    sc68->seek_to  = -1;
+  }
+
+  ret |= apply_change_track(sc68);
+  if (ret & (SC68_END|SC68_CHANGE)) /* exit on error|end|change */
+    return ret;
+
+  t = stats_begin(sc68);
 
-        /* Reset pcm pointer. */
-        sc68->mix.bufpos = 0;
-        sc68->mix.buflen = sc68->mix.bufreq;
-
-        /* Fill pcm buufer depending on architecture */
-        if (sc68->mus->hwflags & SC68_AGA) {
-          /* Amiga - Paula */
-          paula_mix(sc68->paula,(s32*)sc68->mix.buffer,sc68->mix.buflen);
-          mixer68_blend_LR(sc68->mix.buffer, sc68->mix.buffer, sc68->mix.buflen,
-                           sc68->mix.aga_blend, 0, 0);
-        } else {
-          if (sc68->mus->hwflags & SC68_PSG) {
-            int err =
-              ymio_run(sc68->ymio, (s32*)sc68->mix.buffer,
+  /* setup aSID */
+  if (sc68->asid_timers)
+    sc68->emu68->mem[sc68->playaddr+17] = -!!(sc68->asid & SC68_ASID_ON);
+
+  /* Run 68K emulator */
+  status = finish(sc68, sc68->playaddr+8, 0x2300, PLAY_MAX_INST);
+  if (status == EMU68_NRM) {
+    /* $$$ Fix some replays (tao's intensity 200 for one) that
+       assumes the music driver is running under interruption
+       and do not restore the SR by themself. Need to be sure
+       this does not disrupt other musics. */
+    sc68->emu68->reg.sr = 0x2300;
+    status = emu68_interrupt(sc68->emu68, sc68->mix.cycleperpass);
+  }
+  if (status != EMU68_NRM) {
+    error_addx(sc68,
+               "libsc68: abnormal 68K status %d (%s) in play pass %u\n",
+               status, emu68_status_name(status),
+               sc68->mix.pass_count);
+    return SC68_ERROR;
+  }
+  t = stats_emu(sc68, t);
+
+  /* Reset pcm pointer. */
+  sc68->mix.bufpos = 0;
+  sc68->mix.buflen = sc68->mix.bufreq;
+
+  /* Stem buffers for this pass. */
+  stembuf = stems_setup(sc68, stems);
+  if (stembuf) {
+    for (i = 0; i < SC68_STEM_MAX; ++i)
+      st[i] = (s32 *)stembuf + i * sc68->mix.stemmax;
+  }
+
+  /* Wide formats get the final stage unclipped in 32-bit pairs. */
+  wide = wide_setup(sc68);
+
+  /* Fill pcm buufer depending on architecture */
+  if (sc68->mus->hwflags & SC68_AGA) {
+    /* Amiga - Paula */
+    if (wide) {
+      paula_mix_wide(sc68->paula, wide,
+                     stembuf ? st+SC68_STEM_PAULA_0 : 0,
+                     sc68->mix.buflen);
+      t = stats_lap(sc68, SC68_STAGE_PAULA, t);
+      wide_blend(wide, sc68->mix.buflen, sc68->mix.aga_blend);
+    } else {
+      paula_mix_stems(sc68->paula,(s32*)out,
+                      stembuf ? st+SC68_STEM_PAULA_0 : 0,
+                      sc68->mix.buflen);
+      t = stats_lap(sc68, SC68_STAGE_PAULA, t);
+      mixer68_blend_LR(out, out, sc68->mix.buflen,
+                       sc68->mix.aga_blend, 0, 0);
+    }
+    if (stembuf)
+      stems_clear(st, SC68_STEM_YM_A, SC68_STEM_PAULA_0,
+                  sc68->mix.buflen);
+  } else {
+    if (sc68->mus->hwflags & SC68_PSG) {
+      int err =
+        ymio_run_stems(sc68->ymio, (s32*)out,
+                       stembuf ? st+SC68_STEM_YM_A : 0,
                        sc68->mix.cycleperpass);
-            if (err < 0) {
-              ret = SC68_ERROR;
-              sc68->mix.buflen = 0;
-              break;
-            }
-            sc68->mix.buflen = err;
-          } else {
-            mixer68_fill(sc68->mix.buffer, sc68->mix.buflen=sc68->mix.bufreq, 0);
-          }
+      t = stats_lap(sc68, SC68_STAGE_YM, t);
+      if (err < 0) {
+        sc68->mix.buflen = 0;
+        return SC68_ERROR;
+      }
+      sc68->mix.buflen = err;
+      if (stembuf) {
+        for (i = SC68_STEM_YM_A; i <= SC68_STEM_YM_C; ++i)
+          mixer68_dup_L_to_R((u32 *)st[i], (u32 *)st[i],
+                             sc68->mix.buflen, 0);
+      }
+    } else {
+      mixer68_fill(out, sc68->mix.buflen=sc68->mix.bufreq, 0);
+      if (stembuf)
+        stems_clear(st, SC68_STEM_YM_A, SC68_STEM_DMA,
+                    sc68->mix.buflen);
+    }
 
-          if (sc68->mus->hwflags & (SC68_DMA|SC68_LMC))
-            /* STE / MicroWire */
-            mw_mix(sc68->mw, (s32 *)sc68->mix.buffer, sc68->mix.buflen);
-          else
-            /* Else simply process with left channel duplication. */
-            mixer68_dup_L_to_R(sc68->mix.buffer, sc68->mix.buffer,
-                               sc68->mix.buflen, 0);
-        }
+    if (sc68->mus->hwflags & (SC68_DMA|SC68_LMC)) {
+      /* STE / MicroWire */
+      t = stats_lap(sc68, SC68_STAGE_MIXER, t);
+      if (wide)
+        mw_mix_wide(sc68->mw, (s32 *)out, wide,
+                    stembuf ? st[SC68_STEM_DMA] : 0, sc68->mix.buflen);
+      else
+        mw_mix_stems(sc68->mw, (s32 *)out,
+                     stembuf ? st[SC68_STEM_DMA] : 0, sc68->mix.buflen);
+      t = stats_lap(sc68, SC68_STAGE_MW, t);
+    } else {
+      /* Else simply process with left channel duplication. */
+      if (wide)
+        wide_dup(wide, (s32 *)out, sc68->mix.buflen);
+      else
+        mixer68_dup_L_to_R(out, out, sc68->mix.buflen, 0);
+      if (stembuf)
+        stems_clear(st, SC68_STEM_DMA, SC68_STEM_PAULA_0,
+                    sc68->mix.buflen);
+    }
+    if (stembuf)
+      stems_clear(st, SC68_STEM_PAULA_0, SC68_STEM_MAX,
+                  sc68->mix.buflen);
+  }
+
+  stats_lap(sc68, SC68_STAGE_MIXER, t);
+  stats_end(sc68);
 
-        /* Advance time */
-        calc_pos(sc68);
-        sc68->mix.pass_count++;
+  /* Advance time */
+  calc_pos(sc68);
+  if (!sc68->mix.pass_count++)
+    preload_start(sc68);              /* once the track is running */
+  return ret;
+}
+
+/* Internal render flag: bulk mode (sc68_render()). */
+#define RENDER_BULK (1<<16)
+
+/* Record a render mark. */
+static void add_marks(sc68_t * sc68, const int code, const int pos)
+{
+  static const int codes[] = { SC68_LOOP, SC68_CHANGE, SC68_END };
+  int i;
+
+  for (i = 0; i < sizeof(codes)/sizeof(*codes); ++i) {
+    if ( (code & codes[i]) && sc68->mix.nmarks < SC68_MARK_MAX ) {
+      sc68_mark_t * const mark = sc68->mix.marks + sc68->mix.nmarks++;
+      mark->pos   = pos;
+      mark->code  = codes[i];
+      mark->track = sc68->track;
+      mark->loop  = sc68->mix.loop_count;
+    }
+  }
+}
+
+/* sc68_process_stems() and sc68_render() */
+static int process(sc68_t * sc68, void * buf, int * _n,
+                   void * const stems[SC68_STEM_MAX], const int flags)
+{
+  const int pcmfmt = sc68->mix.pcmfmt;
+  const int pcmsz  = pcm_size(pcmfmt);
+  int n = *_n, i;
+  int ret = (n < 0) ? SC68_ERROR : SC68_IDLE;
+
+  while (n > 0) {
+    int len, direct = 0;
+    u64 t;
+
+    /* No more pcm in internal buffer ... */
+    if (!sc68->mix.buflen) {
+      int code;
+
+      /* Room for the marks of one more pass (loop + change|end). */
+      if ( (flags & RENDER_BULK) && sc68->mix.nmarks > SC68_MARK_MAX-2 )
+        break;
+
+      /* Render straight into the destination buffer when the whole
+       * pass fits in it and no conversion is needed (zero-copy).
+       */
+      direct = pcmfmt == SC68_PCM_S16 && n >= sc68->mix.bufreq;
+      code = run_pass(sc68, direct ? (u32 *) buf : sc68->mix.buffer, stems);
+      ret |= code;
+      if (code == SC68_ERROR)
+        break;
+
+      if (flags & RENDER_BULK) {
+        add_marks(sc68, code, *_n - n);
+        if ( (code & SC68_END) ||
+             ( (code & SC68_CHANGE) && (flags & SC68_RENDER_CHANGE) ) )
+          break;
+        if (!sc68->mix.buflen)
+          continue;                     /* changed track, go on */
+      } else if (code & (SC68_END|SC68_CHANGE)) {
+        break;
       }
+      ret &= ~SC68_IDLE;                /* No more idle */
+    }
+
+    assert(sc68->mix.buflen > 0);
+
+    /* Copy to destination buffer (converted to output format). */
+    len = sc68->mix.buflen <= n ? sc68->mix.buflen : n;
+    t = clock68_ns();
+    if (sc68->mix.wideok)
+      pcm_convert_wide(pcmfmt, buf, sc68->mix.wide+2*sc68->mix.bufpos, len);
+    else if (!direct)
+      pcm_convert(pcmfmt, buf, sc68->mix.buffer+sc68->mix.bufpos, len);
+    if (stems) {
+      const int done = *_n - n;
+      for (i = 0; i < SC68_STEM_MAX; ++i) {
+        void * dst;
+        if (!stems[i])
+          continue;
+        dst = (char *)stems[i] + done * pcmsz;
+        if (sc68->mix.stemok)
+          pcm_convert(pcmfmt, dst, sc68->mix.stembuf + i * sc68->mix.stemmax
+                      + sc68->mix.bufpos, len);
+        else
+          memset(dst, 0, len * pcmsz);
+      }
+    }
+    stats_lap(sc68, SC68_STAGE_MIXER, t);
+    buf = (char *)buf + len * pcmsz;
+    sc68->mix.bufpos += len;
+    sc68->mix.buflen -= len;
+    n                -= len;
+  }
+  *_n -= n;
+  return ret;
+}
+
+int sc68_process(sc68_t * sc68, void * buf, int * _n)
+{
+  return sc68_process_stems(sc68, buf, _n, 0);
+}
+
+int sc68_process_stems(sc68_t * sc68, void * buf, int * _n,
+                       void * const stems[SC68_STEM_MAX])
+{
+  int ret;
+
+  if (!is_sc68(sc68)) {
+    ret = SC68_ERROR;
+  } else if (!_n) {
+    /* Flush internal PCM buffer and apply change track request. */
+    ret = SC68_IDLE | apply_change_track(sc68);
+  } else if (!buf) {
+    ret = SC68_ERROR;
+  } else {
+    ret = process(sc68, buf, _n, stems, 0);
+  }
+  return ret;
+}
 
-      assert(sc68->mix.buflen > 0);
+int sc68_render(sc68_t * sc68, void * buf, int max, int * done, int flags)
+{
+  int ret = SC68_ERROR, n = 0;
 
-      /* Copy to destination buffer. */
-      len = sc68->mix.buflen <= n ? sc68->mix.buflen : n;
-      mixer68_copy((u32 *)buf16st,sc68->mix.buffer+sc68->mix.bufpos,len);
-      buf16st = (u32 *)buf16st + len;
-      sc68->mix.bufpos += len;
-      sc68->mix.buflen -= len;
-      n                -= len;
+  if (is_sc68(sc68)) {
+    sc68->mix.nmarks = 0;
+    if (buf && max >= 0) {
+      n   = max;
+      ret = process(sc68, buf, &n, 0,
+                    (flags & SC68_RENDER_CHANGE) | RENDER_BULK);
     }
-    *_n -= n;
   }
+  if (done)
+    *done = n;
   return ret;
 }
 
+const sc68_mark_t * sc68_render_marks(sc68_t * sc68, int * n)
+{
+  if (!is_sc68(sc68)) {
+    if (n) *n = 0;
+    return 0;
+  }
+  if (n)
+    *n = sc68->mix.nmarks;
+  return sc68->mix.marks;
+}
+
 int sc68_is_our_uri(const char * uri, const char *exts, int * is_remote)
 {
   assert(!"TO DO");
@@ -2029,7 +2762,10 @@ int sc68_is_our_uri(const char * uri, const char *exts, int * is_remote)
   /* return file68_is_our_uri(uri,exts,is_remote); */
 }
 
-static int load_disk(sc68_t * sc68, disk68_t * d, int free_on_close)
+/* Open a disk. The instance takes over one reference of the disk
+ * which is released by sc68_close() or on failure.
+ */
+static int load_disk(sc68_t * sc68, const disk68_t * d)
 {
   if (!is_sc68(sc68) || !is_disk(d))
     goto error;
@@ -2039,7 +2775,6 @@ static int load_disk(sc68_t * sc68, disk68_t * d, int free_on_close)
     goto error;
   }
 
-  sc68->tobe3 = !!free_on_close;
   sc68->disk  = d;
   sc68->track = 0;
   sc68->mus   = 0;
@@ -2052,23 +2787,25 @@ static int load_disk(sc68_t * sc68, disk68_t * d, int free_on_close)
   return 0;
 
 error:
-  free(d);
+  if (is_sc68(sc68) && sc68->disk == d)
+    sc68->disk = 0;
+  file68_free(d);
   return -1;
 }
 
 int sc68_load(sc68_t * sc68, vfs68_t * is)
 {
-  return load_disk(sc68, file68_load(is), 1);
+  return load_disk(sc68, file68_load(is));
 }
 
 int sc68_load_uri(sc68_t * sc68, const char * uri)
 {
-  return load_disk(sc68, file68_load_uri(uri), 1);
+  return load_disk(sc68, sc68_disk_cache_uri(uri));
 }
 
 int sc68_load_mem(sc68_t * sc68, const void * buffer, int len)
 {
-  return load_disk(sc68, file68_load_mem(buffer, len), 1);
+  return load_disk(sc68, sc68_disk_cache_mem(buffer, len));
 }
 
 
@@ -2087,10 +2824,27 @@ sc68_disk_t sc68_disk_load_mem(const void * buffer, int len)
   return (sc68_disk_t) file68_load_mem(buffer, len);
 }
 
+sc68_disk_t sc68_probe_disk(vfs68_t * is)
+{
+  return (sc68_disk_t) file68_probe(is);
+}
+
+sc68_disk_t sc68_probe_disk_uri(const char * uri)
+{
+  return (sc68_disk_t) file68_probe_uri(uri);
+}
+
+sc68_disk_t sc68_disk_retain(sc68_disk_t disk)
+{
+  return is_info_disk(disk)
+    ? (sc68_disk_t) file68_retain(disk)
+    : 0;
+}
+
 void sc68_disk_free(sc68_disk_t disk)
 {
-  if (is_disk(disk))
-    file68_free(disk);                    /* $$$ check this */
+  if (is_info_disk(disk))
+    file68_free(disk);
 }
 
 int sc68_open(sc68_t * sc68, sc68_disk_t disk)
@@ -2099,20 +2853,19 @@ int sc68_open(sc68_t * sc68, sc68_disk_t disk)
     sc68_close(sc68);
     return -1; /* Not an error but notifiy no disk has been loaded */
   }
-  if (!sc68) {
+  if (!is_sc68(sc68) || !is_disk(disk)) {
     return -1;
   }
-  return load_disk(sc68, disk, 0);
+  return load_disk(sc68, file68_retain(disk));
 }
 
 void sc68_close(sc68_t * sc68)
 {
   if (sc68 && sc68->disk) {
+    preload_cancel(sc68);
     sc68->mix.buflen = 0; /* warning removal in stop_track() */
     stop_track(sc68, 1);
-    if (sc68->tobe3)
-      file68_free((disk68_t *)sc68->disk);
-    sc68->tobe3     = 0;
+    file68_free(sc68->disk);
     sc68->disk      = 0;
   }
 }
@@ -2242,7 +2995,7 @@ static unsigned int calc_track_len(const disk68_t * d, int track, int loop)
   const music68_t * m;
   unsigned force_ms;
 
-  assert(in_disk(d,track));
+  assert(is_info_disk(d) && in_range(d,track));
 
   m = d->mus + track - 1;
 
@@ -2265,7 +3018,7 @@ static int calc_disk_len(const disk68_t * disk, const int loop)
 {
   int i, len = 0;
 
-  assert(is_disk(disk));
+  assert(is_info_disk(disk));
   for (i = 1; i <= disk->nb_mus; ++i)
     len += calc_track_len(disk,i,loop);
   return len;
@@ -2300,7 +3053,7 @@ static void music_info(sc68_t * sc68, sc68_music_info_t * f, const disk68_t * d,
   int i, maxtag = &f->_lasttag - &f->album;
 
   assert(f);
-  assert(in_disk(d, track));
+  assert(is_info_disk(d) && in_range(d, track));
   m = d->mus + track - 1;
   f->tracks      = d->nb_mus;
   f->addr        = m->a0;
@@ -2389,7 +3142,7 @@ static sc68_disk_t get_dt(sc68_t * sc68, int * ptr_track, sc68_disk_t disk)
     d = (sc68_disk_t)sc68->disk;
   else
     d = 0;
-  if (!is_disk(d))
+  if (!is_info_disk(d))
     return 0;
 
   switch (track = *ptr_track) {
@@ -2501,6 +3254,37 @@ static void sc68_debug(sc68_t * sc68, const char * fmt, ...)
   va_end(list);
 }
 
+/* 68K CRC32 (registers and memory). The library version stored in
+ * the "SC68" cookie of the TOS trap emulator is masked so that the
+ * CRC only depends on the emulation and not on the build.
+ */
+static unsigned int crc68(sc68_t * sc68)
+{
+  static int cookie = -1;             /* cookie offset in trap_func */
+  unsigned int crc;
+  u8 * ver, save[4];
+
+  if (cookie < 0) {
+    int i;
+    for (i = 0; i + 8 <= (int) sizeof(trap_func); i += 2)
+      if (!memcmp(trap_func + i, "SC68", 4)) {
+        cookie = i + 4;
+        break;
+      }
+  }
+  ver = cookie < 0 ? 0 : emu68_memptr(sc68->emu68, TRAP_ADDR + cookie, 4);
+  if (ver && memcmp(ver - 4, "SC68", 4))
+    ver = 0;
+  if (ver) {
+    memcpy(save, ver, 4);
+    memset(ver, 0, 4);
+  }
+  crc = emu68_crc32(sc68->emu68);
+  if (ver)
+    memcpy(ver, save, 4);
+  return crc;
+}
+
 /* static int track_now_or_next(const sc68_t * sc68) { */
 /*   if (!is_disk(sc68)) */
 /*     return -1; */
@@ -2703,6 +3487,15 @@ int sc68_cntl(sc68_t * sc68, int fct, ...)
       res = 0;
       break;
 
+    case SC68_GET_STATS:
+      res = get_stats(sc68, va_arg(list, sc68_stats_t *));
+      break;
+
+    case SC68_GET_CRC:
+      *va_arg(list, unsigned int *) = crc68(sc68);
+      res = 0;
+      break;
+
     case SC68_SET_POS:
     default:
       res = error_addx(sc68,
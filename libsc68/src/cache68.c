@@ -0,0 +1,275 @@
+/*
+ * @file    cache68.c
+ * @brief   sc68 shared disk cache
+ * @author  http://sourceforge.net/users/benjihan
+ *
+ * Copyright (c) 1998-2016 Benjamin Gerard
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include "sc68_private.h"
+
+#include "sc68.h"
+#include "emu68/type68.h"
+#include <sc68/file68.h>
+#include <sc68/file68_msg.h>
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_SYS_STAT_H
+# include <sys/types.h>
+# include <sys/stat.h>
+#endif
+
+extern int sc68_cat;                    /* in api68.c */
+
+#ifdef USE_THREADS
+# include <pthread.h>
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+# define LOCK()   pthread_mutex_lock(&lock)
+# define UNLOCK() pthread_mutex_unlock(&lock)
+#else
+# define LOCK()
+# define UNLOCK()
+#endif
+
+/* Cached disks.
+ *
+ * Entries are kept in a doubly linked list, most recently used
+ * first. Each entry owns one reference to its disk so that evicting
+ * an entry never destroys a disk still opened by some instance.
+ * Disks loaded by URI are keyed by the URI and, for local files, by
+ * the file size and modification time so that a modified file is
+ * loaded again. Disks loaded from memory are keyed by the content
+ * hash and length and keep a copy of the content which is compared
+ * on hit.
+ */
+typedef struct entry_s entry_t;
+struct entry_s {
+  entry_t        * prev, * next;        /* LRU list                  */
+  const disk68_t * disk;                /* cached disk (1 reference) */
+  u64              hash;                /* FNV-1a of the key         */
+  u64              stamp;               /* URI file stamp (0: none)  */
+  int              len;                 /* content length (-1: URI)  */
+  const u8       * data;                /* content copy (memory)     */
+  char             uri[1];              /* URI (empty for memory)    */
+};
+
+static struct {
+  entry_t * head, * tail;
+  int       count;                      /* number of entries         */
+  int       max;                        /* capacity (0: disabled)    */
+} cache;
+
+static u64 fnv64(const void * data, int len)
+{
+  const u8 * s = data;
+  u64 h = 0xCBF29CE484222325ull;
+  while (len-- > 0)
+    h = (h ^ *s++) * 0x100000001B3ull;
+  return h;
+}
+
+/* Size and modification time of a local file URI (0: unknown). */
+static u64 uri_stamp(const char * uri)
+{
+#ifdef HAVE_SYS_STAT_H
+  static const char * const local[] = { "file://", "local://", "mmap://" };
+  struct stat st;
+  int i;
+
+  for (i = 0; i < (int)(sizeof(local)/sizeof(*local)); ++i)
+    if (!strncmp(uri, local[i], strlen(local[i]))) {
+      uri += strlen(local[i]);
+      break;
+    }
+  if (!stat(uri, &st) && S_ISREG(st.st_mode))
+    return (u64) st.st_size << 40 ^ (u64) st.st_mtime ^ 1;
+#endif
+  return 0;
+}
+
+static void unlink_entry(entry_t * e)
+{
+  if (e->prev) e->prev->next = e->next; else cache.head = e->next;
+  if (e->next) e->next->prev = e->prev; else cache.tail = e->prev;
+  --cache.count;
+}
+
+static void push_entry(entry_t * e)
+{
+  e->prev = 0;
+  e->next = cache.head;
+  if (cache.head) cache.head->prev = e; else cache.tail = e;
+  cache.head = e;
+  ++cache.count;
+}
+
+/* Drop least recently used entries (locked). Disks are added to the
+ * drop list to be released outside the lock.
+ */
+static entry_t * trim(int max, entry_t * drop)
+{
+  while (cache.count > max) {
+    entry_t * e = cache.tail;
+    unlink_entry(e);
+    e->next = drop;
+    drop = e;
+  }
+  return drop;
+}
+
+static void release(entry_t * drop)
+{
+  while (drop) {
+    entry_t * next = drop->next;
+    TRACE68(sc68_cat, "libsc68: disk cache drop -- %s\n",
+            drop->len < 0 ? drop->uri : "<mem>");
+    file68_free(drop->disk);
+    free(drop);
+    drop = next;
+  }
+}
+
+static int match(const entry_t * e, u64 hash, u64 stamp,
+                 const void * data, int len, const char * uri)
+{
+  return e->hash == hash && e->stamp == stamp && e->len == len
+    && !strcmp(e->uri, uri) && (len < 0 || !memcmp(e->data, data, len));
+}
+
+/* Find and retain a cached disk (locked). */
+static const disk68_t * find(u64 hash, u64 stamp,
+                             const void * data, int len, const char * uri)
+{
+  entry_t * e;
+
+  for (e = cache.head; e; e = e->next)
+    if (match(e, hash, stamp, data, len, uri)) {
+      if (e != cache.head) {
+        unlink_entry(e);
+        push_entry(e);
+      }
+      return file68_retain(e->disk);
+    }
+  return 0;
+}
+
+/* Insert a freshly loaded disk unless another thread did meanwhile.
+ * Entries of an older version of the same URI are dropped. Returns a
+ * retained disk for the caller.
+ */
+static const disk68_t * insert(disk68_t * disk, u64 hash, u64 stamp,
+                               const void * data, int len, const char * uri)
+{
+  const int ulen = strlen(uri);
+  const disk68_t * dup;
+  entry_t * e = 0, * old, * next, * drop = 0;
+
+  if (!disk)
+    return 0;
+
+  LOCK();
+  dup = find(hash, stamp, data, len, uri);
+  if (!dup && cache.max > 0
+      && (e = malloc(sizeof(*e) + ulen + (len > 0 ? len : 0)), e)) {
+    /* Older versions of this URI can not be found anymore. */
+    for (old = cache.head; len < 0 && old; old = next) {
+      next = old->next;
+      if (old->len < 0 && !strcmp(old->uri, uri)) {
+        unlink_entry(old);
+        old->next = drop;
+        drop = old;
+      }
+    }
+    e->disk  = file68_retain(disk);
+    e->hash  = hash;
+    e->stamp = stamp;
+    e->len   = len;
+    e->data  = 0;
+    memcpy(e->uri, uri, ulen + 1);
+    if (len > 0)
+      e->data = memcpy(e->uri + ulen + 1, data, len);
+    push_entry(e);
+    drop = trim(cache.max, drop);
+  }
+  UNLOCK();
+
+  release(drop);
+  if (dup) {
+    file68_free(disk);
+    return dup;
+  }
+  return disk;
+}
+
+int sc68_disk_cache(int max)
+{
+  entry_t * drop;
+  int old;
+
+  if (max < 0)
+    return cache.max;
+
+  LOCK();
+  old = cache.max;
+  cache.max = max;
+  drop = trim(max, 0);
+  UNLOCK();
+
+  release(drop);
+  return old;
+}
+
+sc68_disk_t sc68_disk_cache_uri(const char * uri)
+{
+  const disk68_t * disk = 0;
+  u64 hash, stamp;
+
+  if (!uri)
+    return 0;
+  hash  = fnv64(uri, strlen(uri));
+  stamp = uri_stamp(uri);
+  LOCK();
+  if (cache.max > 0)
+    disk = find(hash, stamp, 0, -1, uri);
+  UNLOCK();
+  if (!disk)
+    disk = insert(file68_load_uri(uri), hash, stamp, 0, -1, uri);
+  return (sc68_disk_t) disk;
+}
+
+sc68_disk_t sc68_disk_cache_mem(const void * buffer, int len)
+{
+  const disk68_t * disk = 0;
+  u64 hash;
+
+  if (!buffer || len <= 0)
+    return 0;
+  hash = fnv64(buffer, len);
+  LOCK();
+  if (cache.max > 0)
+    disk = find(hash, 0, buffer, len, "");
+  UNLOCK();
+  if (!disk)
+    disk = insert(file68_load_mem(buffer, len), hash, 0, buffer, len, "");
+  return (sc68_disk_t) disk;
+}
@@ -103,6 +103,13 @@ static option68_t opts[] = {
   OPT68_IRNG(prefix,"default-time",optcat,
              "default track time (in second)",
              0,MAX_TIME,1,0),
+
+  OPT68_BOOL(prefix,"preload-track",optcat,
+             "prepare next track in background",1,0),
+
+  OPT68_IRNG(prefix,"disk-cache",optcat,
+             "number of shared loaded disks {0:off}",
+             0,4096,1,0),
 };
 
 static const char config_header[] =
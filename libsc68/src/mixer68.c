@@ -28,6 +28,7 @@
 #include "sc68_private.h"
 
 #include "mixer68.h"
+#include <sc68/file68_opt.h>
 
 /* ARM compliant version */
 /* #define SWAP_16BITWORD(V) ((V^=V<<16), (V^=V>>16), (V^=V<<16)) */
@@ -43,16 +44,10 @@
  *  sign=0x80000000 : Change right channel sign
  *  sign=0x80008000 : Change both channel
  */
-void mixer68_stereo_16_LR(u32 * dst, u32 * src, int nb, const u32 sign)
+static void stereo_16_LR_c(u32 * dst, u32 * src, int nb, const u32 sign)
 {
-  u32 *end;
-
-  /* Optimize trivial case : same buffer, no sign change */
-  if (!sign && dst == src) {
-    return;
-  }
+  u32 * const end = dst+nb;
 
-  end = dst+nb;
   if (nb&1) {
     *dst++ = (*src++) ^ sign;
   }
@@ -73,7 +68,7 @@ void mixer68_stereo_16_LR(u32 * dst, u32 * src, int nb, const u32 sign)
 
 /*  Mix 16-bit-stereo PCM into 16-bit-stereo PCM with channel swapping.
  */
-void mixer68_stereo_16_RL(u32 * dst, u32 * src, int nb, const u32 sign)
+static void stereo_16_RL_c(u32 * dst, u32 * src, int nb, const u32 sign)
 {
   u32 *end;
 
@@ -106,7 +101,7 @@ void mixer68_stereo_16_RL(u32 * dst, u32 * src, int nb, const u32 sign)
 
 /*  Mix 16-bit-stereo PCM into 32-bit-stereo-float (-norm..norm)
  */
-void mixer68_stereo_FL_LR (float * dst, u32 * src, int nb,
+static void stereo_FL_LR_c(float * dst, u32 * src, int nb,
                            const u32 sign, const float norm)
 {
   const float mult = norm / 32768.0f;
@@ -121,10 +116,25 @@ void mixer68_stereo_FL_LR (float * dst, u32 * src, int nb,
   }
 }
 
+/*  Mix 16-bit-stereo PCM into 24-bit-stereo (in 32-bit words)
+ */
+static void stereo_24_LR_c(s32 * dst, u32 * src, int nb, const u32 sign)
+{
+  int v;
+  s32 * const  end = dst + (nb<<1);
+  if (dst < end) {
+    do {
+      v = (int)(s32)(*src++ ^ sign);
+      *dst++ = (int)(s16)(v) * 256;
+      *dst++ = (v>>16) * 256;
+    } while (dst < end);
+  }
+}
+
 /*  Duplicate left channel into right channel and change sign.
  *  PCM' = ( PCM-L | (PCM-L<<16) ) ^ sign
  */
-void mixer68_dup_L_to_R(u32 *dst, u32 *src, int nb,
+static void dup_L_to_R_c(u32 *dst, u32 *src, int nb,
                         const u32 sign)
 {
   u32 * const end = dst+nb;
@@ -152,7 +162,7 @@ void mixer68_dup_L_to_R(u32 *dst, u32 *src, int nb,
 /*  Duplicate right channel into left channel and change sign.
  *  PCM = ( PCM-R | (PCM-R>>16) ) ^ sign
  */
-void mixer68_dup_R_to_L(u32 *dst, u32 *src, int nb, const u32 sign)
+static void dup_R_to_L_c(u32 *dst, u32 *src, int nb, const u32 sign)
 {
   u32 * const end = dst+nb;
 
@@ -180,19 +190,13 @@ void mixer68_dup_R_to_L(u32 *dst, u32 *src, int nb, const u32 sign)
 /*  Blend Left and right voice :
  *  factor [0..65536], 0:blend nothing, 65536:swap L/R
  */
-void mixer68_blend_LR(u32 * dst, u32 * src, int nb,
-                      int factor,
-                      const u32 sign_r, const u32 sign_w)
+static void blend_LR_c(u32 * dst, u32 * src, int nb,
+                       const int factor,
+                       const u32 sign_r, const u32 sign_w)
 {
   u32 *end;
   int oof;
 
-  if (factor < 0) {
-    factor = 0;
-  } else if (factor > 65536) {
-    factor = 65536;
-  }
-
 #undef  MIX_ONE
 #define MIX_ONE                                                         \
   r = (int)(s32)(*src++ ^ sign_r);                                      \
@@ -230,24 +234,12 @@ void mixer68_blend_LR(u32 * dst, u32 * src, int nb,
 
 /*  Multiply left/right (signed) channel by ml/mr factor [-65536..65536]
  */
-void mixer68_mult_LR(u32 *dst, u32 *src, int nb,
-                     const int ml, const int mr,
-                     const u32 sign_r, const u32 sign_w)
+static void mult_LR_c(u32 *dst, u32 *src, int nb,
+                      const int ml, const int mr,
+                      const u32 sign_r, const u32 sign_w)
 {
   u32 * end;
 
-  /* Optimize some trivial case. */
-
-  if (ml == 65536 && mr == 65536) {
-    mixer68_stereo_16_LR(dst, src, nb, sign_r ^ sign_w);
-    return;
-  }
-
-  if (ml==0 && mr==0) {
-    mixer68_fill(dst, nb, sign_w);
-    return;
-  }
-
 #undef  MIX_ONE
 #define MIX_ONE                                                 \
   r = (int)(s32)(*src++ ^ sign_r);                              \
@@ -282,9 +274,9 @@ void mixer68_mult_LR(u32 *dst, u32 *src, int nb,
 
 /*  Fill buffer sign with value (RRRRLLLL)
  */
-void mixer68_fill(u32 * dst, int nb, const u32 sign)
+static void fill_c(u32 * dst, int nb, const u32 sign)
 {
-  u32 * const end = dst+nb;;
+  u32 * const end = dst+nb;
 
   if (nb&1) {
     *dst++ = sign;
@@ -303,27 +295,547 @@ void mixer68_fill(u32 * dst, int nb, const u32 sign)
   }
 }
 
+static void copy_c(u32 * dst, u32 * src, int nb)
+{
+  u32 * const end = dst+nb;
+  if (nb&1) {
+    *dst++ = *src++;
+  }
+  if (nb&2) {
+    *dst++ = *src++;
+    *dst++ = *src++;
+  }
+  if (dst<end) {
+    do {
+      *dst++ = *src++;
+      *dst++ = *src++;
+      *dst++ = *src++;
+      *dst++ = *src++;
+    } while (dst < end);
+  }
+}
+
+/* ,-----------------------------------------------------------------.
+ * |                      x86 SIMD kernels                           |
+ * `-----------------------------------------------------------------'
+ *
+ * Kernels are compiled with per function target attributes so the
+ * library does not require any special compiler flags. They are only
+ * selected when the CPU supports them (see mixer68_simd()). Every
+ * kernel gives bit-identical results to the C version; the remaining
+ * PCM (less than a vector) are processed by the C version.
+ *
+ * Signed 16 bit by unsigned 16 bit products: the high word is the
+ * unsigned high word minus the unsigned factor for minus PCM.
+ */
+
+#if !defined(MIXER68_NO_SIMD) && defined(__GNUC__)                      \
+  && (defined(__x86_64__) || defined(__i386__))                         \
+  && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__==4 && __GNUC_MINOR__>=9))
+# define MIXER68_X86 1
+#endif
+
+#ifdef MIXER68_X86
+
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+/* ---------------------------------------------------------------- */
+/* SSE2: 4 PCM per vector                                            */
+/* ---------------------------------------------------------------- */
+
+SSE2 static __m128i mulhi_su_sse2(const __m128i x, const __m128i u)
+{
+  return _mm_sub_epi16(_mm_mulhi_epu16(x, u),
+                       _mm_and_si128(u, _mm_srai_epi16(x, 15)));
+}
+
+SSE2 static void stereo_16_LR_sse2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4)
+    _mm_storeu_si128((__m128i *)(dst+i),
+                     _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), s));
+  stereo_16_LR_c(dst+i, src+i, nb-i, sign);
+}
+
+SSE2 static void stereo_16_RL_sse2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    __m128i v = _mm_loadu_si128((__m128i *)(src+i));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+    _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(v, s));
+  }
+  stereo_16_RL_c(dst+i, src+i, nb-i, sign);
+}
+
+SSE2 static void stereo_FL_LR_sse2(float * dst, u32 * src, int nb,
+                                   const u32 sign, const float norm)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  const __m128  m = _mm_set1_ps(norm / 32768.0f);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    const __m128i v  = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), s);
+    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(dst+2*i+0, _mm_mul_ps(m, _mm_cvtepi32_ps(lo)));
+    _mm_storeu_ps(dst+2*i+4, _mm_mul_ps(m, _mm_cvtepi32_ps(hi)));
+  }
+  stereo_FL_LR_c(dst+2*i, src+i, nb-i, sign, norm);
+}
+
+SSE2 static void stereo_24_LR_sse2(s32 * dst, u32 * src, int nb,
+                                   const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  const __m128i z = _mm_setzero_si128();
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    const __m128i v = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), s);
+    _mm_storeu_si128((__m128i *)(dst+2*i+0),
+                     _mm_srai_epi32(_mm_unpacklo_epi16(z, v), 8));
+    _mm_storeu_si128((__m128i *)(dst+2*i+4),
+                     _mm_srai_epi32(_mm_unpackhi_epi16(z, v), 8));
+  }
+  stereo_24_LR_c(dst+2*i, src+i, nb-i, sign);
+}
+
+SSE2 static void dup_L_to_R_sse2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    __m128i v = _mm_loadu_si128((__m128i *)(src+i));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xA0), 0xA0);
+    _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(v, s));
+  }
+  dup_L_to_R_c(dst+i, src+i, nb-i, sign);
+}
+
+SSE2 static void dup_R_to_L_sse2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    __m128i v = _mm_loadu_si128((__m128i *)(src+i));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xF5), 0xF5);
+    _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(v, s));
+  }
+  dup_R_to_L_c(dst+i, src+i, nb-i, sign);
+}
+
+/* factor in [1..65535] (trivial cases are handled by the caller). */
+SSE2 static void blend_LR_sse2(u32 * dst, u32 * src, int nb,
+                               const int factor,
+                               const u32 sign_r, const u32 sign_w)
+{
+  const __m128i sr = _mm_set1_epi32(sign_r);
+  const __m128i sw = _mm_set1_epi32(sign_w);
+  const __m128i f  = _mm_set1_epi16((short)factor);
+  const __m128i o  = _mm_set1_epi16((short)(65536-factor));
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    const __m128i x  = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), sr);
+    const __m128i y  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+    const __m128i xl = _mm_mullo_epi16(x, o), xh = mulhi_su_sse2(x, o);
+    const __m128i yl = _mm_mullo_epi16(y, f), yh = mulhi_su_sse2(y, f);
+    const __m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(xl, xh),
+                                     _mm_unpacklo_epi16(yl, yh));
+    const __m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(xl, xh),
+                                     _mm_unpackhi_epi16(yl, yh));
+    const __m128i v  = _mm_packs_epi32(_mm_srai_epi32(lo, 16),
+                                       _mm_srai_epi32(hi, 16));
+    _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(v, sw));
+  }
+  blend_LR_c(dst+i, src+i, nb-i, factor, sign_r, sign_w);
+}
+
+SSE2 static void mult_LR_sse2(u32 * dst, u32 * src, int nb,
+                              const int ml, const int mr,
+                              const u32 sign_r, const u32 sign_w)
+{
+  const __m128i sr = _mm_set1_epi32(sign_r);
+  const __m128i sw = _mm_set1_epi32(sign_w);
+  /* factor = hi * 65536 + lo with lo unsigned and hi in [-1..1] */
+  const __m128i lo = _mm_set1_epi32(((u32)mr<<16) | (u16)ml);
+  const __m128i hi = _mm_set1_epi32(((u32)(mr>>16)<<16) | (u16)(ml>>16));
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    const __m128i x = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), sr);
+    const __m128i v = _mm_add_epi16(mulhi_su_sse2(x, lo),
+                                    _mm_mullo_epi16(x, hi));
+    _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(v, sw));
+  }
+  mult_LR_c(dst+i, src+i, nb-i, ml, mr, sign_r, sign_w);
+}
+
+SSE2 static void fill_sse2(u32 * dst, int nb, const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4)
+    _mm_storeu_si128((__m128i *)(dst+i), s);
+  fill_c(dst+i, nb-i, sign);
+}
+
+SSE2 static void copy_sse2(u32 * dst, u32 * src, int nb)
+{
+  int i;
+  for (i = 0; i+4 <= nb; i += 4)
+    _mm_storeu_si128((__m128i *)(dst+i),
+                     _mm_loadu_si128((__m128i *)(src+i)));
+  copy_c(dst+i, src+i, nb-i);
+}
+
+/* ---------------------------------------------------------------- */
+/* AVX2: 8 PCM per vector                                            */
+/* ---------------------------------------------------------------- */
+
+AVX2 static __m256i mulhi_su_avx2(const __m256i x, const __m256i u)
+{
+  return _mm256_sub_epi16(_mm256_mulhi_epu16(x, u),
+                          _mm256_and_si256(u, _mm256_srai_epi16(x, 15)));
+}
+
+AVX2 static void stereo_16_LR_avx2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m256i s = _mm256_set1_epi32(sign);
+  int i;
+  for (i = 0; i+8 <= nb; i += 8)
+    _mm256_storeu_si256((__m256i *)(dst+i),
+                        _mm256_xor_si256(
+                          _mm256_loadu_si256((__m256i *)(src+i)), s));
+  stereo_16_LR_c(dst+i, src+i, nb-i, sign);
+}
+
+AVX2 static void stereo_16_RL_avx2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m256i s = _mm256_set1_epi32(sign);
+  int i;
+  for (i = 0; i+8 <= nb; i += 8) {
+    __m256i v = _mm256_loadu_si256((__m256i *)(src+i));
+    v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xB1), 0xB1);
+    _mm256_storeu_si256((__m256i *)(dst+i), _mm256_xor_si256(v, s));
+  }
+  stereo_16_RL_c(dst+i, src+i, nb-i, sign);
+}
+
+AVX2 static void stereo_FL_LR_avx2(float * dst, u32 * src, int nb,
+                                   const u32 sign, const float norm)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  const __m256  m = _mm256_set1_ps(norm / 32768.0f);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    const __m128i v = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), s);
+    _mm256_storeu_ps(dst+2*i,
+                     _mm256_mul_ps(m, _mm256_cvtepi32_ps(
+                                     _mm256_cvtepi16_epi32(v))));
+  }
+  stereo_FL_LR_c(dst+2*i, src+i, nb-i, sign, norm);
+}
+
+AVX2 static void stereo_24_LR_avx2(s32 * dst, u32 * src, int nb,
+                                   const u32 sign)
+{
+  const __m128i s = _mm_set1_epi32(sign);
+  int i;
+  for (i = 0; i+4 <= nb; i += 4) {
+    const __m128i v = _mm_xor_si128(_mm_loadu_si128((__m128i *)(src+i)), s);
+    _mm256_storeu_si256((__m256i *)(dst+2*i),
+                        _mm256_slli_epi32(_mm256_cvtepi16_epi32(v), 8));
+  }
+  stereo_24_LR_c(dst+2*i, src+i, nb-i, sign);
+}
+
+AVX2 static void dup_L_to_R_avx2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m256i s = _mm256_set1_epi32(sign);
+  int i;
+  for (i = 0; i+8 <= nb; i += 8) {
+    __m256i v = _mm256_loadu_si256((__m256i *)(src+i));
+    v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xA0), 0xA0);
+    _mm256_storeu_si256((__m256i *)(dst+i), _mm256_xor_si256(v, s));
+  }
+  dup_L_to_R_c(dst+i, src+i, nb-i, sign);
+}
+
+AVX2 static void dup_R_to_L_avx2(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  const __m256i s = _mm256_set1_epi32(sign);
+  int i;
+  for (i = 0; i+8 <= nb; i += 8) {
+    __m256i v = _mm256_loadu_si256((__m256i *)(src+i));
+    v = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xF5), 0xF5);
+    _mm256_storeu_si256((__m256i *)(dst+i), _mm256_xor_si256(v, s));
+  }
+  dup_R_to_L_c(dst+i, src+i, nb-i, sign);
+}
+
+/* factor in [1..65535] (trivial cases are handled by the caller). */
+AVX2 static void blend_LR_avx2(u32 * dst, u32 * src, int nb,
+                               const int factor,
+                               const u32 sign_r, const u32 sign_w)
+{
+  const __m256i sr = _mm256_set1_epi32(sign_r);
+  const __m256i sw = _mm256_set1_epi32(sign_w);
+  const __m256i f  = _mm256_set1_epi16((short)factor);
+  const __m256i o  = _mm256_set1_epi16((short)(65536-factor));
+  int i;
+  for (i = 0; i+8 <= nb; i += 8) {
+    const __m256i x  = _mm256_xor_si256(
+      _mm256_loadu_si256((__m256i *)(src+i)), sr);
+    const __m256i y  = _mm256_shufflehi_epi16(
+      _mm256_shufflelo_epi16(x, 0xB1), 0xB1);
+    const __m256i xl = _mm256_mullo_epi16(x, o), xh = mulhi_su_avx2(x, o);
+    const __m256i yl = _mm256_mullo_epi16(y, f), yh = mulhi_su_avx2(y, f);
+    /* unpack and pack work within 128 bit lanes: order is kept. */
+    const __m256i lo = _mm256_add_epi32(_mm256_unpacklo_epi16(xl, xh),
+                                        _mm256_unpacklo_epi16(yl, yh));
+    const __m256i hi = _mm256_add_epi32(_mm256_unpackhi_epi16(xl, xh),
+                                        _mm256_unpackhi_epi16(yl, yh));
+    const __m256i v  = _mm256_packs_epi32(_mm256_srai_epi32(lo, 16),
+                                          _mm256_srai_epi32(hi, 16));
+    _mm256_storeu_si256((__m256i *)(dst+i), _mm256_xor_si256(v, sw));
+  }
+  blend_LR_c(dst+i, src+i, nb-i, factor, sign_r, sign_w);
+}
+
+AVX2 static void mult_LR_avx2(u32 * dst, u32 * src, int nb,
+                              const int ml, const int mr,
+                              const u32 sign_r, const u32 sign_w)
+{
+  const __m256i sr = _mm256_set1_epi32(sign_r);
+  const __m256i sw = _mm256_set1_epi32(sign_w);
+  const __m256i lo = _mm256_set1_epi32(((u32)mr<<16) | (u16)ml);
+  const __m256i hi = _mm256_set1_epi32(((u32)(mr>>16)<<16) | (u16)(ml>>16));
+  int i;
+  for (i = 0; i+8 <= nb; i += 8) {
+    const __m256i x = _mm256_xor_si256(
+      _mm256_loadu_si256((__m256i *)(src+i)), sr);
+    const __m256i v = _mm256_add_epi16(mulhi_su_avx2(x, lo),
+                                       _mm256_mullo_epi16(x, hi));
+    _mm256_storeu_si256((__m256i *)(dst+i), _mm256_xor_si256(v, sw));
+  }
+  mult_LR_c(dst+i, src+i, nb-i, ml, mr, sign_r, sign_w);
+}
+
+AVX2 static void fill_avx2(u32 * dst, int nb, const u32 sign)
+{
+  const __m256i s = _mm256_set1_epi32(sign);
+  int i;
+  for (i = 0; i+8 <= nb; i += 8)
+    _mm256_storeu_si256((__m256i *)(dst+i), s);
+  fill_c(dst+i, nb-i, sign);
+}
+
+AVX2 static void copy_avx2(u32 * dst, u32 * src, int nb)
+{
+  int i;
+  for (i = 0; i+8 <= nb; i += 8)
+    _mm256_storeu_si256((__m256i *)(dst+i),
+                        _mm256_loadu_si256((__m256i *)(src+i)));
+  copy_c(dst+i, src+i, nb-i);
+}
+
+#undef SSE2
+#undef AVX2
+
+#endif /* MIXER68_X86 */
+
+/* ,-----------------------------------------------------------------.
+ * |                        Kernel dispatch                          |
+ * `-----------------------------------------------------------------'
+ */
+
+typedef struct {
+  void (*stereo_16_LR)(u32 *, u32 *, int, const u32);
+  void (*stereo_16_RL)(u32 *, u32 *, int, const u32);
+  void (*stereo_FL_LR)(float *, u32 *, int, const u32, const float);
+  void (*stereo_24_LR)(s32 *, u32 *, int, const u32);
+  void (*dup_L_to_R)(u32 *, u32 *, int, const u32);
+  void (*dup_R_to_L)(u32 *, u32 *, int, const u32);
+  void (*blend_LR)(u32 *, u32 *, int, const int, const u32, const u32);
+  void (*mult_LR)(u32 *, u32 *, int, const int, const int,
+                  const u32, const u32);
+  void (*fill)(u32 *, int, const u32);
+  void (*copy)(u32 *, u32 *, int);
+} kernels_t;
+
+#define KERNELS(S) {                                                    \
+    stereo_16_LR_##S, stereo_16_RL_##S, stereo_FL_LR_##S,               \
+      stereo_24_LR_##S, dup_L_to_R_##S, dup_R_to_L_##S,                 \
+      blend_LR_##S, mult_LR_##S, fill_##S, copy_##S }
+
+static const kernels_t kernels[] = {
+  KERNELS(c),
+#ifdef MIXER68_X86
+  KERNELS(sse2),
+  KERNELS(avx2),
+#endif
+};
+
+static const char * f_simd[] = { "auto", "none", "sse2", "avx2" };
+
+static const kernels_t * kern = kernels; /* Start with C kernels. */
+static int kern_simd = MIXER68_SIMD_NONE;
+
+/* Best kernel set supported by this CPU. */
+static int simd_best(void)
+{
+#ifdef MIXER68_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return MIXER68_SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return MIXER68_SIMD_SSE2;
+#endif
+  return MIXER68_SIMD_NONE;
+}
+
+int mixer68_simd(int simd)
+{
+  int best;
+
+  if (simd == MIXER68_SIMD_QUERY)
+    return kern_simd;
+
+  best = simd_best();
+  if (simd <= MIXER68_SIMD_AUTO || simd > best)
+    simd = best;
+  kern = kernels + ( simd - MIXER68_SIMD_NONE );
+  kern_simd = simd;
+  return simd;
+}
+
+const char * mixer68_simd_name(int simd)
+{
+  if (simd == MIXER68_SIMD_QUERY)
+    simd = kern_simd;
+  return simd >= MIXER68_SIMD_AUTO && simd <= MIXER68_SIMD_AVX2
+    ? f_simd[simd]
+    : 0
+    ;
+}
+
+static int onchange_simd(const option68_t * opt, value68_t * val)
+{
+  mixer68_simd(val->num);
+  return 0;
+}
+
+/* Command line options */
+#define prefix 0
+static const char mixcat[] = "mixer";
+static option68_t opts[] = {
+  OPT68_ENUM(prefix,"mixer-simd",mixcat,"set mixer SIMD kernels",
+             f_simd,sizeof(f_simd)/sizeof(*f_simd),0,onchange_simd),
+};
+#undef prefix
+
+int mixer68_init(int * argc, char ** argv)
+{
+  mixer68_simd(MIXER68_SIMD_AUTO);
+
+  /* Register mixer options */
+  option68_append(opts,sizeof(opts)/sizeof(*opts));
+  option68_iset(opts+0, MIXER68_SIMD_AUTO, opt68_NOTSET, opt68_CFG);
+
+  /* Parse options */
+  *argc = option68_parse(*argc,argv);
+  return 0;
+}
+
+/* ,-----------------------------------------------------------------.
+ * |                           Mixer API                             |
+ * `-----------------------------------------------------------------'
+ */
+
+void mixer68_stereo_16_LR(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  /* Optimize trivial case : same buffer, no sign change */
+  if (!sign && dst == src) {
+    return;
+  }
+  kern->stereo_16_LR(dst, src, nb, sign);
+}
+
+void mixer68_stereo_16_RL(u32 * dst, u32 * src, int nb, const u32 sign)
+{
+  kern->stereo_16_RL(dst, src, nb, sign);
+}
+
+void mixer68_stereo_FL_LR(float * dst, u32 * src, int nb,
+                          const u32 sign, const float norm)
+{
+  kern->stereo_FL_LR(dst, src, nb, sign, norm);
+}
+
+void mixer68_stereo_24_LR(s32 * dst, u32 * src, int nb, const u32 sign)
+{
+  kern->stereo_24_LR(dst, src, nb, sign);
+}
+
+void mixer68_dup_L_to_R(u32 *dst, u32 *src, int nb, const u32 sign)
+{
+  kern->dup_L_to_R(dst, src, nb, sign);
+}
+
+void mixer68_dup_R_to_L(u32 *dst, u32 *src, int nb, const u32 sign)
+{
+  kern->dup_R_to_L(dst, src, nb, sign);
+}
+
+void mixer68_blend_LR(u32 * dst, u32 * src, int nb,
+                      int factor,
+                      const u32 sign_r, const u32 sign_w)
+{
+  if (factor <= 0) {
+    /* blend nothing */
+    mixer68_stereo_16_LR(dst, src, nb, sign_r ^ sign_w);
+  } else if (factor >= 65536) {
+    /* swap L/R */
+    kern->stereo_16_RL(dst, src, nb, SWAP_16BITWORD(sign_r) ^ sign_w);
+  } else {
+    kern->blend_LR(dst, src, nb, factor, sign_r, sign_w);
+  }
+}
+
+void mixer68_mult_LR(u32 *dst, u32 *src, int nb,
+                     const int ml, const int mr,
+                     const u32 sign_r, const u32 sign_w)
+{
+  /* Optimize some trivial case. */
+
+  if (ml == 65536 && mr == 65536) {
+    mixer68_stereo_16_LR(dst, src, nb, sign_r ^ sign_w);
+    return;
+  }
+
+  if (ml==0 && mr==0) {
+    kern->fill(dst, nb, sign_w);
+    return;
+  }
+
+  kern->mult_LR(dst, src, nb, ml, mr, sign_r, sign_w);
+}
+
+void mixer68_fill(u32 * dst, int nb, const u32 sign)
+{
+  kern->fill(dst, nb, sign);
+}
+
 void mixer68_copy(u32 * dst, u32 * src, int nb)
 {
   /* Optimize trivial case : same buffer */
   if (dst == src || nb <= 0) {
     return;
-  } else {
-    u32 * const end = dst+nb;
-    if (nb&1) {
-      *dst++ = *src++;
-    }
-    if (nb&2) {
-      *dst++ = *src++;
-      *dst++ = *src++;
-    }
-    if (dst<end) {
-      do {
-        *dst++ = *src++;
-        *dst++ = *src++;
-        *dst++ = *src++;
-        *dst++ = *src++;
-      } while (dst < end);
-    }
   }
+  kern->copy(dst, src, nb);
 }
@@ -0,0 +1,462 @@
+/*
+ * @file    stream68.c
+ * @brief   sc68 background streaming
+ * @author  http://sourceforge.net/users/benjihan
+ *
+ * Copyright (c) 1998-2016 Benjamin Gerard
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include "sc68_private.h"
+
+#include "sc68.h"
+#include "emu68/type68.h"
+#include <sc68/file68_msg.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef USE_THREADS
+
+sc68_stream_t * sc68_stream_create(sc68_t * sc68, int frames)
+{
+  msg68_error("libsc68: stream -- %s\n", "compiled without thread support");
+  return 0;
+}
+
+void sc68_stream_destroy(sc68_stream_t * stream) {}
+
+int sc68_stream_read(sc68_stream_t * stream, void * buf, int n, int * status)
+{
+  return -1;
+}
+
+int sc68_stream_play(sc68_stream_t * stream, int track, int loop)
+{
+  return -1;
+}
+
+int sc68_stream_stop(sc68_stream_t * stream)
+{
+  return -1;
+}
+
+int sc68_stream_seek(sc68_stream_t * stream, int ms)
+{
+  return -1;
+}
+
+#else /* USE_THREADS */
+
+#include <pthread.h>
+#include <time.h>
+
+/* Ring indices are free running unsigned counters. Each one has a
+ * single writer: head, evw, cut and gen for the producer thread; tail
+ * and evr for the consumer. The other side reads them with acquire
+ * semantic so that the ring content is visible before the index. The
+ * producer increments gen once per command run so gen != cmdw means
+ * commands are pending.
+ */
+#if defined(__ATOMIC_ACQUIRE)
+static inline unsigned int load_acq(unsigned int * p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void store_rel(unsigned int * p, unsigned int v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+#else
+static inline unsigned int load_acq(unsigned int * p) {
+  unsigned int v = *(volatile unsigned int *)p;
+  __sync_synchronize();
+  return v;
+}
+static inline void store_rel(unsigned int * p, unsigned int v) {
+  __sync_synchronize();
+  *(volatile unsigned int *)p = v;
+}
+#endif
+
+enum {
+  STREAM_CMD_MAX  = 8,                  /* command queue size (2^N) */
+  STREAM_EVT_MAX  = 64,                 /* event ring size (2^N)    */
+  STREAM_SKIP_MAX = 1024,               /* seek render chunk (PCM)  */
+
+  CMD_PLAY = 1, CMD_STOP, CMD_SEEK
+};
+
+typedef struct {
+  int op, arg1, arg2;
+} stream_cmd_t;
+
+typedef struct {
+  unsigned int pos;                     /* ring position of event   */
+  unsigned int gen;                     /* cut generation           */
+  int code;                             /* SC68_LOOP|CHANGE|END     */
+} stream_evt_t;
+
+struct _sc68_stream_s {
+  sc68_t        * sc68;                 /* owned by producer        */
+  int             pcmsz;                /* bytes per PCM            */
+  unsigned int    size;                 /* ring size in PCM (2^N)   */
+  char          * ring;                 /* ring buffer              */
+  char          * skip;                 /* seek scratch buffer      */
+  struct timespec nap;                  /* producer wait when full  */
+
+  unsigned int    head;                 /* producer write position  */
+  unsigned int    tail;                 /* consumer read position   */
+  unsigned int    cut;                  /* first PCM after command  */
+  unsigned int    gen;                  /* cut generation           */
+  unsigned int    seen;                 /* last cut seen (consumer) */
+
+  stream_evt_t    evt[STREAM_EVT_MAX];  /* event ring               */
+  unsigned int    evw, evr;             /* event write/read         */
+
+  pthread_t       thread;
+  pthread_mutex_t lock;                 /* command queue and quit   */
+  pthread_cond_t  wake;
+  stream_cmd_t    cmd[STREAM_CMD_MAX];
+  unsigned int    cmdw, cmdr;
+  int             quit;
+  int             idle;                 /* no track (end or stop)   */
+};
+
+/* Producer: queue an event at ring position pos. */
+static void push_events(sc68_stream_t * st, int code, unsigned int pos)
+{
+  static const int codes[] = { SC68_LOOP, SC68_CHANGE, SC68_END };
+  int i;
+
+  for (i = 0; i < sizeof(codes)/sizeof(*codes); ++i)
+    if ( (code & codes[i]) &&
+         st->evw - load_acq(&st->evr) < STREAM_EVT_MAX ) {
+      stream_evt_t * const evt = st->evt + (st->evw & (STREAM_EVT_MAX-1));
+      evt->pos  = pos;
+      evt->gen  = st->gen;
+      evt->code = codes[i];
+      store_rel(&st->evw, st->evw+1);
+    }
+}
+
+/* Producer: drop everything rendered so far. */
+static void cut(sc68_stream_t * st)
+{
+  store_rel(&st->cut, st->head);
+  store_rel(&st->gen, st->gen+1);
+}
+
+/* Producer: render and discard up to ms in the current track. */
+static int seek(sc68_stream_t * st, int ms)
+{
+  sc68_t * const sc68 = st->sc68;
+  int code = 0, pos, track = sc68_cntl(sc68, SC68_GET_TRACK);
+  unsigned int skip;
+
+  if (track <= 0)
+    return SC68_END;
+  if (ms < 0)
+    ms = 0;
+
+  if (ms < (pos = sc68_cntl(sc68, SC68_GET_POS))) {
+    int loops = sc68_cntl(sc68, SC68_GET_LOOPS);
+    if (sc68_play(sc68, track, loops > 0 ? loops : SC68_INF_LOOP) < 0)
+      return SC68_ERROR;
+    code = sc68_process(sc68, 0, 0);
+    if (code == SC68_ERROR || (code & SC68_END))
+      return code;
+    code &= SC68_CHANGE;
+    pos = 0;
+  }
+
+  skip = (unsigned int)(ms - pos) * (u64)sc68_cntl(sc68, SC68_GET_SPR) / 1000u;
+  while (skip > 0) {
+    int n, ret;
+    ret = sc68_render(sc68, st->skip,
+                      skip < STREAM_SKIP_MAX ? skip : STREAM_SKIP_MAX, &n,
+                      SC68_RENDER_CHANGE);
+    if (ret == SC68_ERROR)
+      return ret;
+    code |= ret & (SC68_CHANGE|SC68_END);
+    if (ret & (SC68_CHANGE|SC68_END))
+      break;
+    skip -= n;
+  }
+  return code;
+}
+
+/* Producer: run a queued command. */
+static void command(sc68_stream_t * st, const stream_cmd_t * cmd)
+{
+  sc68_t * const sc68 = st->sc68;
+  int code = SC68_ERROR;
+
+  switch (cmd->op) {
+  case CMD_PLAY:
+    if (!sc68_play(sc68, cmd->arg1, cmd->arg2))
+      code = sc68_process(sc68, 0, 0);
+    break;
+  case CMD_STOP:
+    if (!sc68_stop(sc68))
+      code = sc68_process(sc68, 0, 0);
+    break;
+  case CMD_SEEK:
+    code = seek(st, cmd->arg1);
+    break;
+  }
+  cut(st);
+  if (code == SC68_ERROR) {
+    msg68_error("libsc68: stream -- command #%d failed -- %s\n",
+                cmd->op, sc68_error(sc68));
+    code = SC68_END;
+  }
+  push_events(st, code, st->head);
+  st->idle = !!(code & SC68_END);
+}
+
+/* Producer thread. */
+static void * producer(void * arg)
+{
+  sc68_stream_t * const st = arg;
+  const unsigned int min = st->size >> 3;
+
+  pthread_mutex_lock(&st->lock);
+  while (!st->quit) {
+    unsigned int room, off, n;
+    int code, done, i;
+    const sc68_mark_t * marks;
+
+    if (st->cmdr != st->cmdw) {
+      stream_cmd_t cmd = st->cmd[st->cmdr++ & (STREAM_CMD_MAX-1)];
+      pthread_mutex_unlock(&st->lock);
+      command(st, &cmd);
+      pthread_mutex_lock(&st->lock);
+      continue;
+    }
+
+    if (st->idle) {
+      pthread_cond_wait(&st->wake, &st->lock);
+      continue;
+    }
+
+    room = st->size - (st->head - load_acq(&st->tail));
+    if (room < min ||
+        STREAM_EVT_MAX - (st->evw - load_acq(&st->evr)) < SC68_MARK_MAX+1) {
+      /* The consumer never signals (wait-free read) so just nap. */
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec  += st->nap.tv_sec;
+      ts.tv_nsec += st->nap.tv_nsec;
+      if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++; ts.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&st->wake, &st->lock, &ts);
+      continue;
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    /* Render up to the end of the ring (or the free room). */
+    off = st->head & (st->size-1);
+    n = st->size - off;
+    if (n > room)
+      n = room;
+    code = sc68_render(st->sc68, st->ring + off * st->pcmsz, n, &done, 0);
+    if (code == SC68_ERROR) {
+      msg68_error("libsc68: stream -- %s\n", sc68_error(st->sc68));
+      push_events(st, code = SC68_END, st->head + done);
+    } else {
+      marks = sc68_render_marks(st->sc68, &i);
+      for (marks += i; i; --i)
+        push_events(st, marks[-i].code, st->head + marks[-i].pos);
+    }
+    store_rel(&st->head, st->head + done);
+    st->idle = !!(code & SC68_END);
+
+    pthread_mutex_lock(&st->lock);
+  }
+  pthread_mutex_unlock(&st->lock);
+  return 0;
+}
+
+sc68_stream_t * sc68_stream_create(sc68_t * sc68, int frames)
+{
+  sc68_stream_t * st;
+  unsigned int size;
+  int spr, pcmsz, code;
+
+  if (sc68_cntl(sc68, SC68_GET_TRACKS) <= 0) {
+    msg68_error("libsc68: stream -- %s\n", "no disk");
+    return 0;
+  }
+  spr   = sc68_cntl(sc68, SC68_GET_SPR);
+  pcmsz = sc68_cntl(sc68, SC68_GET_PCM) == SC68_PCM_S16 ? 4 : 8;
+  if (frames <= 0)
+    frames = spr;
+  for (size = STREAM_SKIP_MAX; size < frames && size < (1u<<24); size <<= 1)
+    ;
+
+  st = calloc(1, sizeof(*st) + (size + STREAM_SKIP_MAX) * pcmsz);
+  if (!st) {
+    msg68_error("libsc68: stream -- %s\n", "alloc error");
+    return 0;
+  }
+  st->sc68  = sc68;
+  st->pcmsz = pcmsz;
+  st->size  = size;
+  st->ring  = (char *)(st+1);
+  st->skip  = st->ring + size * pcmsz;
+
+  /* Nap a quarter of the ring duration when it is full. */
+  {
+    const u64 ns = (u64)size * 250000000u / (spr > 0 ? spr : 44100);
+    st->nap.tv_sec  = ns / 1000000000u;
+    st->nap.tv_nsec = ns % 1000000000u;
+  }
+
+  /* Apply pending change track (sc68_play() before creation). */
+  code = sc68_process(sc68, 0, 0);
+  push_events(st, code & (SC68_CHANGE|SC68_END), 0);
+  st->idle = (code & SC68_END) || sc68_cntl(sc68, SC68_GET_TRACK) <= 0;
+
+  if (pthread_mutex_init(&st->lock, 0)) {
+    free(st);
+    return 0;
+  }
+  if (pthread_cond_init(&st->wake, 0)) {
+    pthread_mutex_destroy(&st->lock);
+    free(st);
+    return 0;
+  }
+  if (pthread_create(&st->thread, 0, producer, st)) {
+    msg68_error("libsc68: stream -- %s\n", "unable to create thread");
+    pthread_cond_destroy(&st->wake);
+    pthread_mutex_destroy(&st->lock);
+    free(st);
+    return 0;
+  }
+  return st;
+}
+
+void sc68_stream_destroy(sc68_stream_t * st)
+{
+  if (st) {
+    pthread_mutex_lock(&st->lock);
+    st->quit = 1;
+    pthread_cond_signal(&st->wake);
+    pthread_mutex_unlock(&st->lock);
+    pthread_join(st->thread, 0);
+    pthread_cond_destroy(&st->wake);
+    pthread_mutex_destroy(&st->lock);
+    free(st);
+  }
+}
+
+int sc68_stream_read(sc68_stream_t * st, void * buf, int n, int * status)
+{
+  unsigned int tail, gen, cmdw, avail, off, evr, evw;
+  int code = 0;
+
+  if (!st || n < 0 || (n && !buf))
+    return -1;
+
+  /* Nothing to read until the producer has run the queued commands,
+   * then skip PCM rendered before the last one. */
+  tail = st->tail;
+  cmdw = load_acq(&st->cmdw);
+  gen  = load_acq(&st->gen);
+  if (gen != cmdw)
+    n = 0;
+  if (gen != st->seen) {
+    const unsigned int cut = load_acq(&st->cut);
+    if ((int)(cut - tail) > 0)
+      tail = cut;
+    st->seen = gen;
+  }
+
+  avail = load_acq(&st->head) - tail;
+  if (n > avail)
+    n = avail;
+
+  /* Copy (in 2 parts when the ring wraps). */
+  off = tail & (st->size-1);
+  if (n > 0) {
+    const unsigned int n1 = off + n > st->size ? st->size - off : n;
+    memcpy(buf, st->ring + off * st->pcmsz, n1 * st->pcmsz);
+    if (n1 < n)
+      memcpy((char *)buf + n1 * st->pcmsz, st->ring, (n - n1) * st->pcmsz);
+  }
+  tail += n;
+  store_rel(&st->tail, tail);
+
+  /* Collect reached events (dropping the ones before the last cut). */
+  evr = st->evr;
+  evw = load_acq(&st->evw);
+  for (; evr != evw; ++evr) {
+    const stream_evt_t * const evt = st->evt + (evr & (STREAM_EVT_MAX-1));
+    if ((int)(evt->gen - gen) > 0 ||
+        (evt->gen == gen && (int)(evt->pos - tail) > 0))
+      break;
+    if (evt->gen == gen)
+      code |= evt->code;
+  }
+  store_rel(&st->evr, evr);
+
+  if (status)
+    *status = code;
+  return n;
+}
+
+/* Queue a command for the producer thread. */
+static int queue(sc68_stream_t * st, int op, int arg1, int arg2)
+{
+  int err = -1;
+
+  if (st) {
+    pthread_mutex_lock(&st->lock);
+    if (st->cmdw - st->cmdr < STREAM_CMD_MAX) {
+      stream_cmd_t * const cmd = st->cmd + (st->cmdw & (STREAM_CMD_MAX-1));
+      cmd->op   = op;
+      cmd->arg1 = arg1;
+      cmd->arg2 = arg2;
+      store_rel(&st->cmdw, st->cmdw+1);
+      pthread_cond_signal(&st->wake);
+      err = 0;
+    }
+    pthread_mutex_unlock(&st->lock);
+  }
+  return err;
+}
+
+int sc68_stream_play(sc68_stream_t * st, int track, int loop)
+{
+  return queue(st, CMD_PLAY, track, loop);
+}
+
+int sc68_stream_stop(sc68_stream_t * st)
+{
+  return queue(st, CMD_STOP, 0, 0);
+}
+
+int sc68_stream_seek(sc68_stream_t * st, int ms)
+{
+  return queue(st, CMD_SEEK, ms, 0);
+}
+
+#endif /* USE_THREADS */
@@ -48,6 +48,7 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
 
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
@@ -78,6 +79,9 @@ static int opt_list = 0;
 static int opt_owav = 0;
 static int opt_conf = 0;
 static int opt_info = 0;
+static int opt_stat = 0;
+static int opt_bench = 0;
+static int opt_digest = 0;
 
 struct sc68_debug_data_s {
   FILE * out;
@@ -227,6 +231,12 @@ static int print_usage(void)
       "  -n --null           No output (--output=null://)\n"
       "  -w --wav            Riff Wav output. Use in combination with -o.\n"
       "  -m --memory=<val>   68k memory to allocate (2^<val> bytes)\n"
+      "  -S --stats          Print performance counters summary\n"
+      "  -B --bench[=<sec>]  Benchmark engines/filters/rates/aSID on all\n"
+      "                      URIs rendering <sec> seconds each (CSV output)\n"
+      "  -H --digest[=<sec>] Hash 68k, YM, DMA, Paula and mixed outputs of\n"
+      "                      all tracks, engines and filters (CSV output)\n"
+      "  -G --golden=<file>  Check --digest against a previous output\n"
       );
 
   if (opt_help > 1) {
@@ -243,6 +253,7 @@ static int print_usage(void)
       "  null:<name>       Null/Zero\n"
       "  <path> or file://path or local://path\n"
       "                    Local file\n"
+      "  mmap://path       Local file (memory mapped, read only)\n"
       "  http://path or ftp://path\n"
       "   or others          Remote scheme (see curl)\n"
       "  sc68://author/hw/title[/:track[:loop:[time]]]\n"
@@ -441,7 +452,7 @@ static char * codestr(int code) {
 /* track:  0:all -1:default */
 static int PlayLoop(vfs68_t * out, int track, int loop, int asid)
 {
-  static char buffer[256 << 2];
+  static char buffer[16384 << 2];
   const int max = sizeof(buffer) >> 2;
   int all = 0;
   int code;
@@ -526,7 +537,7 @@ static int PlayLoop(vfs68_t * out, int track, int loop, int asid)
     loop    = sc68_cntl(sc68,SC68_GET_LOOP)+1;
     loops   = sc68_cntl(sc68,SC68_GET_LOOPS);
 
-    code = sc68_process(sc68, buffer, &n);
+    code = sc68_render(sc68, buffer, max, &n, SC68_RENDER_CHANGE);
 
     if (dsk_pos - last_dskpos >= 1000) {
       last_dskpos = dsk_pos;
@@ -539,6 +550,11 @@ static int PlayLoop(vfs68_t * out, int track, int loop, int asid)
     if (code == SC68_ERROR)
       break;
 
+    /* Send audio PCM to stdout (including the PCM rendered before a
+     * track change). */
+    if (n > 0 && vfs68_write(out, buffer, n<<2) != (n<<2))
+      return -1;
+
     if (code & SC68_LOOP) {
       last_dskpos = dsk_pos - 1000;
     }
@@ -554,15 +570,363 @@ static int PlayLoop(vfs68_t * out, int track, int loop, int asid)
         DisplayInfo(-1);
       }
     }
-
-    /* if (n > 0) */
-    /* Send audio PCM to stdout. */
-    if (vfs68_write(out, buffer, n<<2) != (n<<2))
-      return -1;
   }
   return -(code == SC68_ERROR);
 }
 
+/* Print performance counters summary (on error output). */
+static void PrintStats(void)
+{
+  static const char * const stages[SC68_STAGE_MAX] = {
+    "68k", "ym", "filter", "paula", "mw", "mixer"
+  };
+  FILE * const err = sc68_debug_data.err;
+  sc68_stats_t stats;
+  const sc68_counters_t * const c = &stats.total;
+  unsigned long long ns = 0;
+  int i;
+
+  if (sc68_cntl(sc68, SC68_GET_STATS, &stats)) {
+    fprintf(err, "sc68: performance counters not available\n");
+    return;
+  }
+  for (i = 0; i < SC68_STAGE_MAX; ++i)
+    ns += c->ns[i];
+
+  fprintf(err,
+          "sc68: %llu passes, %llu instructions, %llu interrupts\n"
+          "sc68: %llu YM events (%llu overflows), %llu buffer reallocs\n",
+          c->passes, c->instructions, c->interrupts,
+          c->ym_events, c->ym_overflows, c->reallocs);
+  for (i = 0; i < SC68_STAGE_MAX; ++i)
+    fprintf(err, "sc68: %-8s %10.3f ms %5.1f%%\n", stages[i],
+            c->ns[i] / 1E6, ns ? c->ns[i] * 100.0 / ns : 0.0);
+  fprintf(err, "sc68: %-8s %10.3f ms\n", "total", ns / 1E6);
+}
+
+/* YM blep engines and pulse engine filters swept by --bench and
+ * --digest. Configuration f < 0 is bleps[f+NBLEPS], f >= 0 is the
+ * pulse engine with filters[f]. */
+static const char * const bleps[] = { "blep", "blep-acc" };
+static const char * const filters[] = {
+  "2-poles", "mixed", "1-pole", "boxcar", "none"
+};
+#define NBLEPS ((int)(sizeof(bleps)/sizeof(*bleps)))
+
+/* Wall clock time in seconds. */
+static double WallTime(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1E-9;
+#else
+  return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Create the sc68 instance for a benchmark or digest configuration
+ * and start the track.
+ *
+ * @retval  1  skipped (aSID not possible)
+ * @retval  0  success
+ * @retval -1  failure
+ */
+static int BenchCreate(const char * uri, int track, int loop,
+                       int rate, int log2m, int debug,
+                       const char * engine, const char * filter, int asid)
+{
+  sc68_create_t create68;
+
+  sc68_cntl(0, SC68_SET_OPT_STR, "ym-engine", engine);
+  if (filter)
+    sc68_cntl(0, SC68_SET_OPT_STR, "ym-filter", filter);
+
+  memset(&create68,0,sizeof(create68));
+  create68.sampling_rate = rate;
+  create68.log2mem = log2m;
+  create68.emu68_debug = debug;
+  sc68 = sc68_create(&create68);
+  if (!sc68 || sc68_load_uri(sc68, uri))
+    return -1;
+  if (asid && sc68_cntl(sc68, SC68_CAN_ASID, track) != 1)
+    return 1;
+  sc68_cntl(sc68, SC68_SET_ASID, asid);
+  if (sc68_play(sc68, track, loop) == SC68_ERROR ||
+      sc68_process(sc68, 0, 0) == SC68_ERROR)
+    return -1;
+  sc68_cntl(sc68, SC68_GET_STATS, 0);
+  return 0;
+}
+
+/* Render one benchmark configuration to a null sink and print its
+ * CSV line.
+ *
+ * @retval  1  skipped (aSID not possible)
+ * @retval  0  success
+ * @retval -1  failure
+ */
+static int BenchOne(const char * uri, int track, int rate, int log2m,
+                    const char * engine, const char * filter, int asid)
+{
+  static char buffer[16384 << 2];
+  const int max = sizeof(buffer) >> 2;
+  sc68_stats_t stats;
+  int err, code = 0, len, i;
+  double t;
+
+  err = BenchCreate(uri, track, SC68_INF_LOOP, rate, log2m, 0,
+                    engine, filter, asid);
+  if (err)
+    goto error;
+  err = -1;
+  track = sc68_cntl(sc68, SC68_GET_TRACK);
+  rate  = sc68_cntl(sc68, SC68_GET_SPR);
+
+  t = WallTime();
+  for (len = opt_bench * rate;
+       len > 0 && !(code & SC68_END); len -= i) {
+    i = len < max ? len : max;
+    code = sc68_process(sc68, buffer, &i);
+    if (code == SC68_ERROR)
+      goto error;
+  }
+  t = WallTime() - t;
+  len = opt_bench * rate - len;
+
+  printf("\"%s\",%d,%s,%s,%u,%s,%.3f,%.3f,%.2f",
+         uri, track, engine, filter ? filter : "", rate,
+         asid ? "on" : "off", (double) len / rate, t,
+         t > 0 ? len / (t * rate) : 0.0);
+  if (!sc68_cntl(sc68, SC68_GET_STATS, &stats))
+    for (i = 0; i < SC68_STAGE_MAX; ++i)
+      printf(",%.3f", stats.total.ns[i] / 1E6);
+  else
+    for (i = 0; i < SC68_STAGE_MAX; ++i)
+      printf(",");
+  printf("\n");
+  fflush(stdout);
+  err = 0;
+
+error:
+  sc68_destroy(sc68);
+  sc68 = 0;
+  return err;
+}
+
+/* Benchmark files sweeping YM engine, filter, sampling rate and aSID.
+ * Results are printed as CSV on the standard output.
+ */
+static int Bench(int argc, char ** argv, int track, int rate, int log2m)
+{
+  static const int rates[] = { 44100, 48000, 96000 };
+  const int nrates = rate ? 1 : sizeof(rates) / sizeof(*rates);
+  int i, f, r, a, err = 0;
+
+  if (track <= 0)
+    track = SC68_DEF_TRACK;
+  printf("uri,track,engine,filter,rate,asid,emulated_s,wall_s,realtime"
+         ",68k_ms,ym_ms,filter_ms,paula_ms,mw_ms,mixer_ms\n");
+
+  for (i = 0; i < argc; ++i)
+    for (f = -NBLEPS; f < (int)(sizeof(filters)/sizeof(*filters)); ++f)
+      for (r = 0; r < nrates; ++r)
+        for (a = 0; a < 2; ++a)
+          if (BenchOne(argv[i], track, rate ? rate : rates[r], log2m,
+                       f < 0 ? bleps[f+NBLEPS] : "pulse", f < 0 ? 0 : filters[f],
+                       a ? SC68_ASID_ON : SC68_ASID_OFF) < 0) {
+            fprintf(stderr, "sc68: bench failed -- %s\n", argv[i]);
+            err = -1;
+            f = a = r = 1<<16;          /* next file */
+          }
+  return err;
+}
+
+/* Digest stages in processing order (first mismatch is the culprit). */
+enum {
+  DIGEST_68K, DIGEST_YM, DIGEST_DMA, DIGEST_PAULA, DIGEST_MIX, DIGEST_MAX
+};
+
+/* FNV-1a hash of native 32-bit PCM (byte order independent). */
+static unsigned int Fnv(unsigned int h, const unsigned int * pcm, int n)
+{
+  while (n-- > 0) {
+    const unsigned int v = *pcm++;
+    h = (h ^ (v & 255)) * 16777619u;
+    h = (h ^ (v >> 8 & 255)) * 16777619u;
+    h = (h ^ (v >> 16 & 255)) * 16777619u;
+    h = (h ^ (v >> 24)) * 16777619u;
+  }
+  return h;
+}
+
+/* Compare a digest line with the reference (golden) digests.
+ *
+ * @retval  1  mismatch or no reference
+ * @retval  0  match
+ */
+static int DigestCheck(const char * golden, const char * key, int frames,
+                       const unsigned int h[DIGEST_MAX])
+{
+  static const char * const stages[DIGEST_MAX] = {
+    "68k (registers and memory)", "YM", "STE DMA", "Paula", "mixer"
+  };
+  const int len = strlen(key);
+  const char * ref;
+  unsigned int r[DIGEST_MAX];
+  int i, n;
+
+  for (ref = golden; ref; ref = strchr(ref, '\n'), ref = ref ? ref+1 : 0)
+    if (!strncmp(ref, key, len))
+      break;
+  if (!ref) {
+    fprintf(stderr, "sc68: digest -- %s -- no reference\n", key);
+    return 1;
+  }
+  if (sscanf(ref + len, "%d,%x,%x,%x,%x,%x",
+             &n, r+0, r+1, r+2, r+3, r+4) != 1+DIGEST_MAX) {
+    fprintf(stderr, "sc68: digest -- %s -- invalid reference\n", key);
+    return 1;
+  }
+  if (n != frames) {
+    fprintf(stderr, "sc68: digest -- %s -- %d frames, expected %d\n",
+            key, frames, n);
+    return 1;
+  }
+  for (i = 0; i < DIGEST_MAX && h[i] == r[i]; ++i)
+    ;
+  if (i == DIGEST_MAX)
+    return 0;
+  fprintf(stderr, "sc68: digest -- %s -- diverges in %s\n",
+          key, stages[i]);
+  return 1;
+}
+
+/* Render one track for the digest and print its CSV line.
+ *
+ * @retval  1  mismatch with the reference
+ * @retval  0  success
+ * @retval -1  failure
+ */
+static int DigestOne(const char * uri, int track, int rate, int log2m,
+                     const char * engine, const char * filter,
+                     const char * golden, int * tracks)
+{
+  enum { max = 4096 };
+  static unsigned int buffer[max], st[SC68_STEM_MAX][max];
+  void * stems[SC68_STEM_MAX];
+  unsigned int h[DIGEST_MAX];
+  char key[512];
+  int err, code, frames, len, ms, i;
+  double t;
+
+  err = BenchCreate(uri, track, SC68_INF_LOOP, rate, log2m, 1,
+                    engine, filter, SC68_ASID_OFF);
+  if (err)
+    goto error;
+  err = -1;
+  *tracks = sc68_cntl(sc68, SC68_GET_TRACKS);
+  rate = sc68_cntl(sc68, SC68_GET_SPR);
+
+  /* Render the track length (at most --digest seconds). */
+  ms = sc68_cntl(sc68, SC68_GET_LEN);
+  frames = opt_digest * rate;
+  if (ms > 0 && (double) ms * rate / 1000 < frames)
+    frames = (int) ((double) ms * rate / 1000);
+
+  for (i = 0; i < SC68_STEM_MAX; ++i)
+    stems[i] = st[i];
+  for (i = 0; i < DIGEST_MAX; ++i)
+    h[i] = 2166136261u;
+
+  t = WallTime();
+  for (len = frames; len > 0; len -= i) {
+    i = len < max ? len : max;
+    code = sc68_process_stems(sc68, buffer, &i, stems);
+    if (code == SC68_ERROR || (code & SC68_END))
+      goto error;
+    h[DIGEST_YM]    = Fnv(h[DIGEST_YM],    st[SC68_STEM_YM_A],    i);
+    h[DIGEST_YM]    = Fnv(h[DIGEST_YM],    st[SC68_STEM_YM_B],    i);
+    h[DIGEST_YM]    = Fnv(h[DIGEST_YM],    st[SC68_STEM_YM_C],    i);
+    h[DIGEST_DMA]   = Fnv(h[DIGEST_DMA],   st[SC68_STEM_DMA],     i);
+    h[DIGEST_PAULA] = Fnv(h[DIGEST_PAULA], st[SC68_STEM_PAULA_0], i);
+    h[DIGEST_PAULA] = Fnv(h[DIGEST_PAULA], st[SC68_STEM_PAULA_1], i);
+    h[DIGEST_PAULA] = Fnv(h[DIGEST_PAULA], st[SC68_STEM_PAULA_2], i);
+    h[DIGEST_PAULA] = Fnv(h[DIGEST_PAULA], st[SC68_STEM_PAULA_3], i);
+    h[DIGEST_MIX]   = Fnv(h[DIGEST_MIX],   buffer,                i);
+  }
+  t = WallTime() - t;
+  if (sc68_cntl(sc68, SC68_GET_CRC, &h[DIGEST_68K]))
+    goto error;
+
+  sprintf(key, "\"%.400s\",%d,%s,%s,%d,",
+          uri, track, engine, filter ? filter : "", rate);
+  printf("%s%d,%08x,%08x,%08x,%08x,%08x,%.3f\n", key, frames,
+         h[0], h[1], h[2], h[3], h[4], t);
+  fflush(stdout);
+  err = golden ? DigestCheck(golden, key, frames, h) : 0;
+
+error:
+  sc68_destroy(sc68);
+  sc68 = 0;
+  return err;
+}
+
+/* Load a whole text file. */
+static char * LoadText(const char * path)
+{
+  FILE * f = fopen(path, "rb");
+  char * buf = 0;
+  long len;
+
+  if (f && !fseek(f, 0, SEEK_END) && (len = ftell(f)) >= 0 &&
+      !fseek(f, 0, SEEK_SET) && (buf = malloc(len+1)) != 0) {
+    if (fread(buf, 1, len, f) != len) {
+      free(buf);
+      buf = 0;
+    } else
+      buf[len] = 0;
+  }
+  if (!buf)
+    fprintf(stderr, "sc68: %s -- %s\n", path, strerror(errno));
+  if (f)
+    fclose(f);
+  return buf;
+}
+
+/* Digest every track of files for every YM engine and filter.
+ * Results are printed as CSV on the standard output and optionally
+ * checked against a previous output (golden).
+ */
+static int Digest(int argc, char ** argv, int track, int rate, int log2m,
+                  const char * goldname)
+{
+  char * golden = 0;
+  int i, t, f, res, err = 0, tracks;
+
+  if (goldname && !(golden = LoadText(goldname)))
+    return -1;
+  printf("uri,track,engine,filter,rate,frames,68k,ym,dma,paula,mix,wall_s\n");
+
+  for (i = 0; i < argc; ++i)
+    for (t = track > 0 ? track : 1, tracks = t; t <= tracks; ++t)
+      for (f = -NBLEPS; f < (int)(sizeof(filters)/sizeof(*filters)); ++f) {
+        res = DigestOne(argv[i], t, rate, log2m,
+                        f < 0 ? bleps[f+NBLEPS] : "pulse", f < 0 ? 0 : filters[f],
+                        golden, &tracks);
+        if (res < 0) {
+          fprintf(stderr, "sc68: digest failed -- %s #%d\n", argv[i], t);
+          err = -1;
+          f = t = 1<<16;                /* next file */
+        } else if (res > 0 && !err)
+          err = 1;
+        if (track > 0)
+          tracks = track;
+      }
+  free(golden);
+  return err;
+}
+
 /* Build output URI for wav output.
  *
  * !!! Notice !!!
@@ -616,6 +980,7 @@ int main(int argc, char *argv[])
   const char * loops   = "def";
   const char * rates   = "def";
   const char * memory  = "def";
+  const char * goldname = 0;
   char sc68_name[] = "sc68"; /* !!! MUST BE in writable memory for
                                 basename() !!! */
 
@@ -649,6 +1014,10 @@ int main(int argc, char *argv[])
     {"loop",       1, 0, 'l'},
     {"rate",       1, 0, 'r'},
     {"memory",     1, 0, 'm'},
+    {"stats",      0, 0, 'S'},
+    {"bench",      2, 0, 'B'},
+    {"digest",     2, 0, 'H'},
+    {"golden",     1, 0, 'G'},
     {0,0,0,0}
   };
   char shortopts[(sizeof(longopts)/sizeof(*longopts))*3];
@@ -691,6 +1060,25 @@ int main(int argc, char *argv[])
     case 'D': opt_list = 1; break;  /* --debug-list  */
     case 'C': opt_conf = 1; break;  /* --config      */
     case 'I': opt_info = 1; break;  /* --info        */
+    case 'S': opt_stat = 1; break;  /* --stats       */
+    case 'B':                       /* --bench=      */
+      opt_bench = optarg ? strtoul(optarg,0,10) : 10;
+      if (opt_bench <= 0) {
+        fprintf(stderr,"%s: invalid bench duration -- '%s'\n",
+                argv[0], optarg);
+        goto error;
+      }
+      break;
+    case 'H':                       /* --digest=     */
+      opt_digest = optarg ? strtoul(optarg,0,10) : 60;
+      if (opt_digest <= 0) {
+        fprintf(stderr,"%s: invalid digest duration -- '%s'\n",
+                argv[0], optarg);
+        goto error;
+      }
+      break;
+    case 'G':
+      goldname = optarg; break;     /* --golden=     */
     case 'v': ++opt_verb; break;    /* --verbose     */
     case 'q': --opt_verb; break;    /* --quiet       */
     case 'n': case 'c': case 'o':
@@ -778,6 +1166,43 @@ int main(int argc, char *argv[])
     goto exit;
   }
 
+  /* Parse --loop= */
+  if (!strcmp(loops,"def")) {
+    loop = 0;
+  } else if (!strcmp(loops,"inf")) {
+    loop = -1;
+  } else {
+    loop = strtoul(loops,0,10);
+  }
+
+  /* Parse --rate= */
+  if (!strcmp(rates,"def")) {
+    rate = 0;
+  } else {
+    rate = strtoul(rates,0,10);
+  }
+
+  /* Parse --memory= */
+  if (!strcmp(memory,"def")) {
+    log2m = 0;
+  } else {
+    log2m = strtoul(memory,0,10);
+  }
+
+  /* Digest mode */
+  if (opt_digest) {
+    err = Digest(argc-i, argv+i, isdigit((int)*tracks) ? atoi(tracks) : 0,
+                 rate, log2m, goldname);
+    goto exit;
+  }
+
+  /* Benchmark mode */
+  if (opt_bench) {
+    err = Bench(argc-i, argv+i, isdigit((int)*tracks) ? atoi(tracks) : 0,
+                rate, log2m);
+    goto exit;
+  }
+
   /* Select output
    *
    *  - Doing this earlier so that proper message handler can be set.
@@ -820,29 +1245,6 @@ int main(int argc, char *argv[])
   Debug("sc68: output '%s'\n", outname);
 
 
-  /* Parse --loop= */
-  if (!strcmp(loops,"def")) {
-    loop = 0;
-  } else if (!strcmp(loops,"inf")) {
-    loop = -1;
-  } else {
-    loop = strtoul(loops,0,10);
-  }
-
-  /* Parse --rate= */
-  if (!strcmp(rates,"def")) {
-    rate = 0;
-  } else {
-    rate = strtoul(rates,0,10);
-  }
-
-  /* Parse --memory= */
-  if (!strcmp(memory,"def")) {
-    log2m = 0;
-  } else {
-    log2m = strtoul(memory,0,10);
-  }
-
   /* Create emulator instance */
   memset(&create68,0,sizeof(create68));
   create68.sampling_rate = rate;
@@ -893,6 +1295,8 @@ int main(int argc, char *argv[])
     goto error;
   }
   Debug("sc68: Exit Playloop normally\n");
+  if (opt_stat)
+    PrintStats();
   err = 0;
 
 error:
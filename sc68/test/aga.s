@@ -0,0 +1,90 @@
+;;; sc68 --digest test corpus: Amiga (Paula) sc68 file
+;;;
+;;; Voice 0 plays a square wave with a period sweep, voice 1 a saw
+;;; with a volume ramp. The sc68 container is written by hand: chunk
+;;; sizes are little endian.
+;;;
+;;; Assemble with: as68 aga.s -o aga.sc68
+;;;
+
+	org	0
+
+	dc.b	"SC68 Music-file / (c) (BeN)jamin Gerard / SasHipA-Dev  ",0
+file:	dc.b	"SC68"
+	dc.b	(eof-file)&255,((eof-file)>>8)&255,0,0
+
+	dc.b	"SCFN"
+	dc.b	fn1-fn0,0,0,0
+fn0:	dc.b	"aga digest test",0
+fn1:
+	dc.b	"SCMU",0,0,0,0
+	dc.b	"SCMN"
+	dc.b	mn1-mn0,0,0,0
+mn0:	dc.b	"sc68",0,0
+mn1:
+	dc.b	"SCTY",4,0,0,0
+	dc.b	4,0,0,0
+	dc.b	"SCFR",4,0,0,0
+	dc.b	200,0,0,0
+	dc.b	"SCDA"
+	dc.b	(da1-da0)&255,((da1-da0)>>8)&255,0,0
+
+da0:
+	bra.w	init
+	rts
+	nop
+	bra.w	play
+
+init:
+	lea	count(pc),a0
+	clr.w	(a0)
+
+	;; build a 64 bytes saw
+	lea	saw(pc),a0
+	moveq	#63,d1
+	moveq	#-128,d0
+fill:
+	move.b	d0,(a0)+
+	addq.b	#4,d0
+	dbf	d1,fill
+
+	lea	$dff000,a0
+	lea	square(pc),a1
+	move.l	a1,$a0(a0)
+	move.w	#32,$a4(a0)
+	move.w	#$100,$a6(a0)
+	move.w	#48,$a8(a0)
+	lea	saw(pc),a1
+	move.l	a1,$b0(a0)
+	move.w	#32,$b4(a0)
+	move.w	#$1c0,$b6(a0)
+	move.w	#0,$b8(a0)
+	move.w	#$8203,$96(a0)
+	rts
+
+play:
+	lea	count(pc),a1
+	addq.w	#1,(a1)
+	move.w	(a1),d0
+	lea	$dff000,a0
+
+	;; voice 0: period sweep
+	move.w	d0,d1
+	and.w	#63,d1
+	lsl.w	#2,d1
+	add.w	#$c0,d1
+	move.w	d1,$a6(a0)
+
+	;; voice 1: volume ramp
+	move.w	d0,d1
+	and.w	#63,d1
+	move.w	d1,$b8(a0)
+	rts
+
+count:	dc.w	0
+square:	dcb.b	32,$7f
+	dcb.b	32,$81
+saw:	ds.b	64
+da1:
+	dc.b	"SCEF",0,0,0,0
+eof:
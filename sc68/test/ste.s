@@ -0,0 +1,133 @@
+;;; sc68 --digest test corpus: STE sndh
+;;;
+;;; YM tone, looping DMA sample with a changing replay rate and
+;;; LMC-1992 (microwire) bass, treble and balance commands.
+;;;
+;;; Assemble with: as68 ste.s -o ste.sndh
+;;;
+
+	bra.w	init
+	bra.w	exit
+	bra.w	play
+
+	dc.b	"SNDH"
+	dc.b	"TITLste digest test",0
+	dc.b	"COMMsc68",0
+	dc.b	"##01"
+	dc.b	"TC50"
+	dc.b	"FLAG~yel",0
+	even
+	dc.b	"TIME"
+	dc.w	4
+	dc.b	"HDNS"
+
+init:
+	lea	count(pc),a0
+	clr.w	(a0)
+
+	;; build a 512 bytes saw + square sample
+	lea	sample(pc),a0
+	move.w	#511,d1
+	moveq	#0,d0
+fill:
+	move.b	d0,d2
+	btst	#6,d1
+	beq.s	fill2
+	eor.b	#$40,d2
+fill2:
+	move.b	d2,(a0)+
+	addq.b	#3,d0
+	dbf	d1,fill
+
+	;; YM A: quiet tone
+	lea	$ffff8800.w,a0
+	move.b	#7,(a0)
+	move.b	#$3e,2(a0)
+	move.b	#8,(a0)
+	move.b	#10,2(a0)
+	move.b	#0,(a0)
+	move.b	#$c0,2(a0)
+	move.b	#1,(a0)
+	move.b	#1,2(a0)
+
+	;; DMA: loop the sample, 12.5 kHz mono
+	lea	$ffff8900.w,a0
+	lea	sample(pc),a1
+	move.l	a1,d0
+	move.b	d0,7(a0)
+	lsr.l	#8,d0
+	move.b	d0,5(a0)
+	lsr.l	#8,d0
+	move.b	d0,3(a0)
+	lea	sampend(pc),a1
+	move.l	a1,d0
+	move.b	d0,$13(a0)
+	lsr.l	#8,d0
+	move.b	d0,$11(a0)
+	lsr.l	#8,d0
+	move.b	d0,$f(a0)
+	move.b	#$81,$21(a0)
+	move.b	#3,1(a0)
+
+	;; LMC: master 0dB, flat tone
+	move.w	#$4e8,d0
+	bsr.s	lmc
+	move.w	#$446,d0
+	bsr.s	lmc
+	move.w	#$486,d0
+
+;;; d0: microwire command (%10 address, 3 bits register, 6 bits data)
+lmc:
+	move.w	#$07ff,$ffff8924.w
+	move.w	d0,$ffff8922.w
+	rts
+
+exit:
+	clr.b	$ffff8901.w
+	rts
+
+play:
+	lea	count(pc),a1
+	addq.w	#1,(a1)
+	move.w	(a1),d0
+
+	;; DMA rate change every 32 frames (12.5, 25, 50, 25 kHz)
+	move.w	d0,d1
+	and.w	#31,d1
+	bne.s	tone
+	move.w	d0,d1
+	lsr.w	#5,d1
+	and.w	#3,d1
+	move.b	rates(pc,d1.w),d1
+	move.b	d1,$ffff8921.w
+
+tone:
+	;; every 8 frames: bass up, treble down, left balance
+	move.w	d0,d1
+	and.w	#7,d1
+	bne.s	done
+	move.w	d0,d3
+	lsr.w	#3,d3
+	and.w	#15,d3
+	cmp.w	#12,d3
+	bls.s	tone2
+	moveq	#12,d3
+tone2:
+	move.w	d3,d0
+	or.w	#$440,d0
+	bsr.s	lmc
+	moveq	#12,d0
+	sub.w	d3,d0
+	or.w	#$480,d0
+	bsr.s	lmc
+	moveq	#20,d0
+	sub.w	d3,d0
+	or.w	#$540,d0
+	bsr.s	lmc
+done:
+	rts
+
+rates:	dc.b	$81,$82,$83,$82
+count:	dc.w	0
+sample:	ds.b	512
+sampend:
@@ -0,0 +1,132 @@
+;;; sc68 --digest test corpus: YM-2149 only sndh
+;;;
+;;; Track 1: tone on A and B, envelope on C.
+;;; Track 2: noise on A, buzzer envelope on B.
+;;;
+;;; Assemble with: as68 ym.s -o ym.sndh
+;;;
+
+	bra.w	init
+	bra.w	exit
+	bra.w	play
+
+	dc.b	"SNDH"
+	dc.b	"TITLym digest test",0
+	dc.b	"COMMsc68",0
+	dc.b	"##02"
+	dc.b	"TC50"
+	dc.b	"FLAG~y",0
+	even
+	dc.b	"TIME"
+	dc.w	4,4
+	dc.b	"HDNS"
+
+;;; d0: track number (1-based)
+init:
+	lea	track(pc),a0
+	move.w	d0,(a0)
+	clr.w	count-track(a0)
+	lea	regs1(pc),a1
+	cmp.w	#1,d0
+	beq.s	setym
+	lea	regs2(pc),a1
+setym:
+	lea	$ffff8800.w,a0
+setloop:
+	move.b	(a1)+,d1
+	bmi.s	setdone
+	move.b	d1,(a0)
+	move.b	(a1)+,2(a0)
+	bra.s	setloop
+setdone:
+	rts
+
+exit:
+	lea	regsoff(pc),a1
+	bra.s	setym
+
+play:
+	lea	count(pc),a1
+	addq.w	#1,(a1)
+	move.w	(a1),d0
+	lea	$ffff8800.w,a0
+	lea	notes(pc),a1
+	cmp.w	#1,track-notes(a1)
+	bne.s	play2
+
+	;; A: rising period, decaying volume
+	move.w	d0,d1
+	and.w	#$ff,d1
+	add.w	#$100,d1
+	move.b	#0,(a0)
+	move.b	d1,2(a0)
+	move.b	#1,(a0)
+	lsr.w	#8,d1
+	move.b	d1,2(a0)
+	move.w	d0,d1
+	lsr.w	#1,d1
+	and.w	#15,d1
+	moveq	#15,d2
+	sub.w	d1,d2
+	move.b	#8,(a0)
+	move.b	d2,2(a0)
+
+	;; B: arpeggio
+	move.w	d0,d1
+	lsr.w	#2,d1
+	and.w	#7,d1
+	add.w	d1,d1
+	move.w	0(a1,d1.w),d1
+	move.b	#2,(a0)
+	move.b	d1,2(a0)
+	move.b	#3,(a0)
+	lsr.w	#8,d1
+	move.b	d1,2(a0)
+	rts
+
+play2:
+	;; A: noise period sweep
+	move.w	d0,d1
+	and.w	#31,d1
+	move.b	#6,(a0)
+	move.b	d1,2(a0)
+
+	;; B: bass line under the buzzer
+	move.w	d0,d1
+	lsr.w	#3,d1
+	and.w	#7,d1
+	add.w	d1,d1
+	move.w	0(a1,d1.w),d1
+	add.w	d1,d1
+	move.b	#2,(a0)
+	move.b	d1,2(a0)
+	move.b	#3,(a0)
+	lsr.w	#8,d1
+	move.b	d1,2(a0)
+
+	;; retrigger the envelope every 16 frames
+	move.w	d0,d1
+	and.w	#15,d1
+	bne.s	play2done
+	moveq	#$08,d1
+	btst	#4,d0
+	beq.s	play2env
+	moveq	#$0c,d1
+play2env:
+	move.b	#13,(a0)
+	move.b	d1,2(a0)
+play2done:
+	rts
+
+notes:	dc.w	478,379,319,239,190,159,119,95
+track:	dc.w	0
+count:	dc.w	0
+
+;;; register/value pairs, -1 terminated
+regs1:	dc.b	7,$38,8,15,9,12,10,$10
+	dc.b	4,$80,5,0,11,0,12,8,13,$0e,-1
+regs2:	dc.b	7,$35,8,13,9,$10,10,0
+	dc.b	6,1,11,$40,12,0,13,$08,-1
+regsoff:
+	dc.b	7,$3f,8,0,9,0,10,0,-1
+	even
@@ -0,0 +1,205 @@
+/*
+ * @file    bench68.c
+ * @brief   68k instruction handlers micro-benchmark
+ * @author  http://sourceforge.net/users/benjihan
+ *
+ * Copyright (c) 1998-2016 Benjamin Gerard
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Companion of insttest68: where insttest68 checks the instruction
+ * semantics this one times the emu68 instruction handlers. There is
+ * one handler per entry of the gen68 generated line table (line,
+ * op-mode and effective address mode). For each of them an
+ * instruction is assembled with D1/A1 as reg9 and D2/A2 as reg0
+ * (abs.w for mode 7) and repeated in a block run by emu68_finish().
+ *
+ * Handlers that do not fall through to the next instruction (branch
+ * taken, exception, stop ...) are reported as skipped.
+ *
+ * Results are printed in JSON on stdout.
+ */
+
+#include <emu68/emu68.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+  VECT   = 0x00F00,         /* exceptions land on a STOP here */
+  CODE   = 0x10000,         /* instruction block              */
+  DATA   = 0x40000,         /* address registers point here   */
+  STACK  = 0x80000,         /* initial stack pointer          */
+  AREA   = 0x10000,         /* data area restored per handler */
+  COPIES = 1000             /* instructions per block         */
+};
+
+static int verbose = 1;
+static int runs = 100;
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+/* Fill data with $0003 words (non zero divisor, small shift count)
+ * and make all exception vectors point to a STOP.
+ */
+static void setup_mem(u8 * mem)
+{
+  int i;
+
+  for (i = DATA - AREA; i < DATA + AREA; i += 2) {
+    mem[i+0] = 0x00;
+    mem[i+1] = 0x03;
+  }
+  for (i = 0; i < 0x400; i += 4) {
+    mem[i+0] = VECT >> 24 & 255;
+    mem[i+1] = VECT >> 16 & 255;
+    mem[i+2] = VECT >> 8 & 255;
+    mem[i+3] = VECT & 255;
+  }
+  mem[VECT+0] = 0x4e;                   /* stop #$2700 */
+  mem[VECT+1] = 0x72;
+  mem[VECT+2] = 0x27;
+  mem[VECT+3] = 0x00;
+}
+
+static void setup_regs(emu68_t * emu68)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    emu68->reg.d[i] = 3;
+    emu68->reg.a[i] = DATA;
+  }
+  emu68->reg.a[7] = emu68->reg.usp = STACK;
+  emu68->reg.sr   = 0x2700;
+  emu68->reg.pc   = CODE;
+}
+
+/* Run a single instruction at CODE and get its length (0 if it did
+ * not fall through).
+ */
+static int probe(emu68_t * emu68, u8 * mem, int opw)
+{
+  int i, len;
+
+  setup_mem(mem);
+  mem[CODE+0] = opw >> 8;
+  mem[CODE+1] = opw;
+  for (i = 2; i < 10; i += 2) {         /* extension words $0100 */
+    mem[CODE+i+0] = 0x01;
+    mem[CODE+i+1] = 0x00;
+  }
+  setup_regs(emu68);
+  if (emu68_finish(emu68, 1) != EMU68_BRK)
+    return 0;
+  len = emu68->reg.pc - CODE;
+  return len >= 2 && len <= 10 ? len : 0;
+}
+
+/* Time an instruction in nanoseconds (negative if skipped). */
+static double bench(emu68_t * emu68, u8 * mem, int opw, int * plen)
+{
+  const int len = *plen = probe(emu68, mem, opw);
+  double t;
+  int i;
+
+  if (!len)
+    return -1;
+  for (i = 1; i < COPIES; ++i)
+    memcpy(mem + CODE + i * len, mem + CODE, len);
+  setup_mem(mem);
+
+  t = now();
+  for (i = 0; i < runs; ++i) {
+    setup_regs(emu68);
+    if (emu68_finish(emu68, COPIES) != EMU68_BRK ||
+        emu68->reg.pc != CODE + COPIES * len)
+      return -1;
+  }
+  return (now() - t) * 1E9 / ((double) runs * COPIES);
+}
+
+int main(int argc, char ** argv)
+{
+  emu68_parms_t parms;
+  emu68_t * emu68;
+  u8 * mem;
+  int i, j, len, n;
+  double ns;
+
+  /* parse options */
+  for (i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      for (j = 1; argv[i][j]; ++j) {
+        switch (argv[i][j]) {
+        case 'v': ++verbose; break;
+        case 'q': --verbose; break;
+        case 'r':
+          if (++i < argc && (runs = atoi(argv[i])) > 0)
+            break;
+          fprintf(stderr, "bench68: -r needs a positive number of runs\n");
+          return 1;
+        }
+        if (argv[i][0] != '-')
+          break;
+      }
+    }
+  }
+
+  emu68_init(&argc, argv);
+  memset(&parms, 0, sizeof(parms));
+  parms.log2mem = 20;
+  emu68 = emu68_create(&parms);
+  if (!emu68) {
+    fprintf(stderr, "bench68: failed to create emu68 instance\n");
+    return 2;
+  }
+  mem = emu68_memptr(emu68, 0, 1 << parms.log2mem);
+
+  ns = bench(emu68, mem, 0x4e71, &len);
+  printf("{\n  \"copies\": %d,\n  \"runs\": %d,\n  \"nop_ns\": %.3f,\n"
+         "  \"handlers\": [", COPIES, runs, ns);
+
+  for (i = n = 0; i < 1024; ++i) {
+    const int line = i >> 6, opmode = (i >> 3) & 7, ea = i & 7;
+    const int opw =
+      (line << 12) | (1 << 9) | (opmode << 6) | (ea << 3) | (ea == 7 ? 0 : 2);
+
+    ns = bench(emu68, mem, opw, &len);
+    if (verbose > 1)
+      fprintf(stderr, "bench68: %03x %04x %s\n", i, opw,
+              ns < 0 ? "skipped" : "ok");
+    if (ns < 0)
+      continue;
+    printf("%s\n    { \"index\": %d, \"line\": %d, \"opmode\": %d,"
+           " \"ea\": %d, \"opcode\": \"%04x\", \"length\": %d,"
+           " \"ns\": %.3f }",
+           n++ ? "," : "", i, line, opmode, ea, opw, len, ns);
+  }
+  printf("\n  ],\n  \"skipped\": %d\n}\n", 1024 - n);
+
+  emu68_destroy(emu68);
+  emu68_shutdown();
+  return 0;
+}
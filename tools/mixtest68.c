@@ -0,0 +1,286 @@
+/*
+ * @file    mixtest68.c
+ * @brief   mixer68 SIMD kernels test and benchmark
+ * @author  http://sourceforge.net/users/benjihan
+ *
+ * Copyright (c) 1998-2016 Benjamin Gerard
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Checks every mixer68 kernel of every SIMD set the CPU supports
+ * against the portable C kernel on random buffers: odd lengths,
+ * misaligned (relative to the vector size) and in-place buffers, all
+ * sign modes, extreme factors and extreme samples. The destination
+ * is compared with its guard words so that writing past the end is
+ * caught as well. The exit code is 1 if any kernel mismatches.
+ *
+ * With -b it instead times each kernel of each set on in-cache
+ * buffers and prints the throughput (PCM bytes written per second)
+ * in CSV on stdout.
+ */
+
+#include <sc68/mixer68.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+  MAXPCM = 1024,                /* max PCM per test               */
+  GUARD  = 16,                  /* guard words around destination */
+  BENCH  = 1024                 /* PCM per benchmark call         */
+};
+
+static int verbose = 1;
+static int iters = 2000;
+static unsigned int seed = 68;
+
+/* Kernels under test. */
+enum {
+  K_16_LR, K_16_RL, K_FL_LR, K_24_LR, K_DUP_L, K_DUP_R,
+  K_BLEND, K_MULT, K_FILL, K_COPY, K_MAX
+};
+
+static const char * knames[K_MAX] = {
+  "stereo_16_LR", "stereo_16_RL", "stereo_FL_LR", "stereo_24_LR",
+  "dup_L_to_R", "dup_R_to_L", "blend_LR", "mult_LR", "fill", "copy"
+};
+
+/* Output words per PCM. */
+static int kwords(int k)
+{
+  return (k == K_FL_LR || k == K_24_LR) ? 2 : 1;
+}
+
+typedef struct {
+  u32   sign_r, sign_w;         /* sign (only sign_w for 1 sign) */
+  int   f1, f2;                 /* blend factor or ml, mr        */
+  float norm;                   /* float normalization           */
+} args_t;
+
+static unsigned int rnd(void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static const u32 signs[4] = {
+  MIXER68_SAME_SIGN, MIXER68_CHANGE_LEFT_CHANNEL_SIGN,
+  MIXER68_CHANGE_RIGHT_CHANNEL_SIGN, MIXER68_CHANGE_SIGN
+};
+
+/* Random factor biased toward the range limits. */
+static int rnd_factor(int min, int max)
+{
+  const int special[] = { min, min+1, -1, 0, 1, 32768, max-1, max };
+  const int n = sizeof(special)/sizeof(*special);
+  int v = rnd() % (2*n);
+
+  if (v < n)
+    v = special[v];
+  else
+    v = min + (int)(rnd() % (unsigned)(max - min + 1));
+  return v < min ? min : v > max ? max : v;
+}
+
+/* Random sample biased toward the s16 limits. */
+static u32 rnd_pcm(void)
+{
+  static const u16 special[] = { 0x0000, 0x0001, 0x7FFF, 0x8000, 0xFFFF };
+  u16 l = rnd(), r = rnd() >> 16;
+
+  if (!(rnd() & 3)) l = special[rnd() % 5];
+  if (!(rnd() & 3)) r = special[rnd() % 5];
+  return ((u32)r << 16) | l;
+}
+
+static void call(int k, u32 * dst, u32 * src, int nb, const args_t * a)
+{
+  switch (k) {
+  case K_16_LR: mixer68_stereo_16_LR(dst, src, nb, a->sign_w); break;
+  case K_16_RL: mixer68_stereo_16_RL(dst, src, nb, a->sign_w); break;
+  case K_FL_LR:
+    mixer68_stereo_FL_LR((float *)dst, src, nb, a->sign_w, a->norm); break;
+  case K_24_LR: mixer68_stereo_24_LR((s32 *)dst, src, nb, a->sign_w); break;
+  case K_DUP_L: mixer68_dup_L_to_R(dst, src, nb, a->sign_w); break;
+  case K_DUP_R: mixer68_dup_R_to_L(dst, src, nb, a->sign_w); break;
+  case K_BLEND:
+    mixer68_blend_LR(dst, src, nb, a->f1, a->sign_r, a->sign_w); break;
+  case K_MULT:
+    mixer68_mult_LR(dst, src, nb, a->f1, a->f2, a->sign_r, a->sign_w); break;
+  case K_FILL: mixer68_fill(dst, nb, a->sign_w); break;
+  case K_COPY: mixer68_copy(dst, src, nb); break;
+  }
+}
+
+/* Run one random case for kernel k with set simd. Returns 0 if the
+ * result matches the C kernel.
+ */
+static int test(int k, int simd)
+{
+  static u32 src[MAXPCM+8], ref[2*MAXPCM+2*GUARD+8], out[2*MAXPCM+2*GUARD+8];
+  const int wpp = kwords(k);
+  const int nb = rnd() % 4 ? rnd() % 80 : rnd() % MAXPCM;
+  const int so = rnd() & 7, doff = rnd() & 7;
+  const int inplace = wpp == 1 && !(rnd() & 3);
+  const int total = wpp*nb + 2*GUARD + doff;
+  u32 * s;
+  args_t a;
+  int i;
+
+  a.sign_r = signs[rnd() & 3];
+  a.sign_w = k == K_FILL ? rnd_pcm() : signs[rnd() & 3];
+  a.f1 = k == K_BLEND ? rnd_factor(0, 65536) : rnd_factor(-65536, 65536);
+  a.f2 = rnd_factor(-65536, 65536);
+  a.norm = (rnd() & 1) ? 1.0f : (rnd() & 1) ? 0.5f : 32768.0f;
+
+  for (i = 0; i < nb + so; ++i)
+    src[i] = rnd_pcm();
+  for (i = 0; i < total; ++i)
+    ref[i] = rnd();
+  memcpy(out, ref, total * sizeof(*out));
+
+  /* Reference (C) */
+  s = src + so;
+  if (inplace)
+    s = memcpy(ref + GUARD + doff, s, nb * sizeof(*s));
+  mixer68_simd(MIXER68_SIMD_NONE);
+  call(k, ref + GUARD + doff, s, nb, &a);
+
+  /* Tested set */
+  s = src + so;
+  if (inplace)
+    s = memcpy(out + GUARD + doff, s, nb * sizeof(*s));
+  mixer68_simd(simd);
+  call(k, out + GUARD + doff, s, nb, &a);
+
+  if (!memcmp(ref, out, total * sizeof(*out)))
+    return 0;
+
+  for (i = 0; i < total && ref[i] == out[i]; ++i)
+    ;
+  fprintf(stderr,
+          "mixtest68: %s/%s mismatch -- nb=%d src+%d dst+%d%s"
+          " sign=%08x/%08x f=%d/%d norm=%g"
+          " word %d: %08x != %08x (C)\n",
+          knames[k], mixer68_simd_name(simd),
+          nb, so, doff, inplace ? " in-place" : "",
+          (unsigned) a.sign_r, (unsigned) a.sign_w, a.f1, a.f2,
+          (double) a.norm, i - GUARD - doff,
+          (unsigned) out[i], (unsigned) ref[i]);
+  return -1;
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1E-9;
+}
+
+/* Time kernel k with the current set (GB/s written). */
+static double bench(int k)
+{
+  static u32 src[BENCH], dst[2*BENCH];
+  args_t a;
+  double t, dt;
+  long n, calls = 256;
+  int i;
+
+  for (i = 0; i < BENCH; ++i)
+    src[i] = rnd_pcm();
+  a.sign_r = MIXER68_SAME_SIGN;
+  a.sign_w = MIXER68_CHANGE_SIGN;
+  a.f1 = 40000;
+  a.f2 = -20000;
+  a.norm = 1.0f;
+
+  do {
+    t = now();
+    for (n = 0; n < calls; ++n)
+      call(k, dst, src, BENCH, &a);
+    dt = now() - t;
+    calls <<= 1;
+  } while (dt < 0.1);
+  calls >>= 1;
+
+  return (double) calls * BENCH * 4 * kwords(k) / dt * 1E-9;
+}
+
+int main(int argc, char ** argv)
+{
+  int i, k, simd, best, dobench = 0, err = 0;
+
+  /* parse options */
+  for (i = 1; i < argc; ++i) {
+    const char * arg = argv[i];
+    if (!strcmp(arg, "-b"))
+      dobench = 1;
+    else if (!strcmp(arg, "-v"))
+      ++verbose;
+    else if (!strcmp(arg, "-q"))
+      --verbose;
+    else if (!strcmp(arg, "-n") && i+1 < argc && atoi(argv[i+1]) > 0)
+      iters = atoi(argv[++i]);
+    else if (!strcmp(arg, "-s") && i+1 < argc)
+      seed = strtoul(argv[++i], 0, 0) | 1;
+    else {
+      fprintf(stderr,
+              "usage: mixtest68 [-b] [-v] [-q] [-n iterations] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  best = mixer68_simd(MIXER68_SIMD_AUTO);
+
+  if (dobench) {
+    printf("kernel");
+    for (simd = MIXER68_SIMD_NONE; simd <= best; ++simd)
+      printf(",%s", mixer68_simd_name(simd));
+    printf("\n");
+    for (k = 0; k < K_MAX; ++k) {
+      printf("%s", knames[k]);
+      for (simd = MIXER68_SIMD_NONE; simd <= best; ++simd) {
+        mixer68_simd(simd);
+        printf(",%.2f", bench(k));
+        fflush(stdout);
+      }
+      printf("\n");
+    }
+    return 0;
+  }
+
+  if (best == MIXER68_SIMD_NONE && verbose > 0)
+    fprintf(stderr, "mixtest68: no SIMD kernel set on this CPU\n");
+
+  for (simd = MIXER68_SIMD_NONE + 1; simd <= best; ++simd)
+    for (k = 0; k < K_MAX; ++k) {
+      int n;
+      for (n = 0; n < iters && !test(k, simd); ++n)
+        ;
+      if (n < iters)
+        err = 1;
+      if (verbose > 0)
+        fprintf(stderr, "mixtest68: %-12s %-4s %s\n",
+                knames[k], mixer68_simd_name(simd),
+                n < iters ? "FAILED" : "ok");
+    }
+  return err;
+}
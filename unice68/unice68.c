@@ -42,6 +42,7 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
 #ifdef HAVE_LIBGEN_H
 #include <libgen.h>
 #endif
@@ -155,6 +156,7 @@ static int print_usage(void)
       "  -p --pack      Pack mode\n"
       "  -P --pack-old  Force pack with deprecated 'Ice!' identifier\n"
       "  -s --stress    Pack and unpack <input> for testing\n"
+      "  -b --bench     Benchmark packer and depacker with <input>\n"
       "\n"
       " If no mode is given the default is to pack an unpacked file\n"
       " and to unpack a packed one.\n"
@@ -339,8 +341,103 @@ enum {
   ERR_PACKER_SIZE_MISMATCH,
   ERR_PACKER_OVERFLOW,
   ERR_PACKER_STRESS,
+  ERR_PACKER_BENCH,
 };
 
+/* Elapsed processor time in seconds. */
+static double elapsed(clock_t t0)
+{
+  return (double) (clock() - t0) / CLOCKS_PER_SEC;
+}
+
+static double mbps(int len, int runs, double sec)
+{
+  return sec > 0 ? (double) len * runs / (sec * (1<<20)) : 0;
+}
+
+/* Pack and depack repeatedly for about a second each and compare
+ * with the reference packer and depacker.
+ */
+static int bench(const char * name, const char * ibuffer, int ilen)
+{
+  const double mintime = 1.0;
+  const int olen = ilen + (ilen>>1) + 1000;
+  char * obuffer = 0, * rbuffer = 0, * dbuffer = 0;
+  int err = ERR_OUTPUT, runs, csize, rsize;
+  double sec = 0, fast;
+  clock_t t0;
+
+  if (!(obuffer = myalloc(0, olen, "output"))
+      || !(rbuffer = myalloc(0, olen, "reference"))
+      || !(dbuffer = myalloc(0, ilen, "depack")))
+    goto error;
+
+  message(N, "ice bench \"%s\" (%d bytes) ...\n", name, ilen);
+
+  /* Packer */
+  err = ERR_PACKER;
+  t0 = clock(); runs = 0;
+  do {
+    csize = unice68_packer(obuffer, olen, ibuffer, ilen);
+    ++runs;
+  } while (csize > 0 && (sec = elapsed(t0)) < mintime);
+  if (csize <= 0)
+    goto error;
+  fast = mbps(ilen, runs, sec);
+  message(N, "pack       : %9.3f MB/s %9.3f ms (%d runs)\n",
+          fast, sec * 1000.0 / runs, runs);
+
+  t0 = clock();
+  rsize = unice68_packer_ref(rbuffer, olen, ibuffer, ilen);
+  sec = elapsed(t0);
+  message(N, "pack-ref   : %9.3f MB/s %9.3f ms (x%.1f)\n",
+          mbps(ilen, 1, sec), sec * 1000.0,
+          sec > 0 ? fast / mbps(ilen, 1, sec) : 0);
+
+  err = ERR_PACKER_BENCH;
+  if (rsize != csize || memcmp(obuffer, rbuffer, csize)) {
+    error("packer and reference packer outputs differ\n");
+    goto error;
+  }
+
+  /* Depacker */
+  t0 = clock(); runs = 0;
+  do {
+    if (unice68_depacker(dbuffer, obuffer))
+      goto error;
+    ++runs;
+  } while ((sec = elapsed(t0)) < mintime);
+  fast = mbps(ilen, runs, sec);
+  message(N, "depack     : %9.3f MB/s %9.3f ms (%d runs)\n",
+          fast, sec * 1000.0 / runs, runs);
+  if (memcmp(dbuffer, ibuffer, ilen)) {
+    error("depacked data differ\n");
+    goto error;
+  }
+
+  memset(dbuffer, 0, ilen);
+  t0 = clock(); runs = 0;
+  do {
+    if (unice68_depacker_ref(dbuffer, obuffer))
+      goto error;
+    ++runs;
+  } while ((sec = elapsed(t0)) < mintime);
+  message(N, "depack-ref : %9.3f MB/s %9.3f ms (x%.1f)\n",
+          mbps(ilen, runs, sec), sec * 1000.0 / runs,
+          sec > 0 ? fast / mbps(ilen, runs, sec) : 0);
+  if (memcmp(dbuffer, ibuffer, ilen)) {
+    error("reference depacked data differ\n");
+    goto error;
+  }
+  err = ERR_OK;
+
+error:
+  free(obuffer);
+  free(rbuffer);
+  free(dbuffer);
+  return err;
+}
+
 int main(int argc, char *argv[])
 {
   int err = ERR_UNDEFINED;
@@ -399,6 +496,8 @@ int main(int argc, char *argv[])
         c = 'P';
       } else if (!strcmp(arg,"stress")) {
         c = 's';
+      } else if (!strcmp(arg,"bench")) {
+        c = 'b';
       } else if (!strcmp(arg,"no-limit")) {
         c = 'n';
       } else {
@@ -421,13 +520,13 @@ int main(int argc, char *argv[])
         sens = 'd';
       case 'P':
         oldid = 1;
-      case 'p': case 's':
+      case 'p': case 's': case 'b':
         if (!sens) sens = 'p';
         if (mode != 0) {
           error("only one mode can be specified.\n");
           return ERR_CLI;
         }
-        oneop = !!strchr("tTs", c);
+        oneop = !!strchr("tTsb", c);
         mode = c;
         break;
       default:
@@ -591,6 +690,10 @@ int main(int argc, char *argv[])
    **********************************************************************/
   switch (sens) {
   case 'p':
+    if (mode == 'b') {
+      err = bench(finp, ibuffer, ilen);
+      break;
+    }
     message(V, "ice packing \"%s\" (%d bytes) ...\n", finp, ilen);
     err = unice68_packer(obuffer, olen, ibuffer, ilen);
     message(D, "packing returns with %d\n", err);
@@ -688,7 +791,7 @@ error:
   free(ibuffer);
   free(obuffer);
 
-  if (!err) {
+  if (!err && mode != 'b') {
     message(N,"ICE! compressed:%d uncompressed:%d ratio:%d%%%s\n",
             csize, dsize, dsize?(csize+50)*100/dsize:-1,
             verified ? " (verified)" : "");
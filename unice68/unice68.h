@@ -128,6 +128,19 @@ UNICE68_API
  */
 int unice68_depacker(void * dst, const void * src);
 
+UNICE68_API
+/**
+ *  Depack an ICE buffer with the reference depacker.
+ *
+ *    The unice68_depacker_ref() function is a bit by bit translation
+ *    of the original 68000 depacker. It produces the same output than
+ *    unice68_depacker() but it is much slower. It is only meant for
+ *    testing and benchmarking.
+ *
+ * @see unice68_depacker()
+ */
+int unice68_depacker_ref(void * dst, const void * src);
+
 UNICE68_API
 /**
  *  Pack a buffer with ice packer.
@@ -145,6 +158,19 @@ UNICE68_API
  */
 int unice68_packer(void * dst, int max, const void * src, int len);
 
+UNICE68_API
+/**
+ *  Pack a buffer with the reference ice packer.
+ *
+ *    The unice68_packer_ref() function produces the same output than
+ *    unice68_packer() but it uses the original exhaustive string
+ *    search. It is much slower and is only meant for testing and
+ *    benchmarking.
+ *
+ * @see unice68_packer()
+ */
+int unice68_packer_ref(void * dst, int max, const void * src, int len);
+
 /**
  * @}
  */
@@ -35,6 +35,7 @@
 #ifdef HAVE_ASSERT_H
 # include <assert.h>
 #endif
+#include <stdlib.h>
 
 typedef uint8_t * areg_t;
 typedef     int   dreg_t;
@@ -45,6 +46,7 @@ typedef struct {
   areg_t srcbuf,srcend,dstbuf,dstend;
   int srclen, dstlen, dstmax;
   int error, optimize, maxlength, maxgleich, maxoffset;
+  int * next;          /* string search chains (0:reference search) */
 } all_regs_t;
 
 #define ICE_MAGIC 0x49636521 /* 'Ice!' */
@@ -81,6 +83,7 @@ static void longword_store(all_regs_t *R);
 static void put_bits(all_regs_t * R);
 static void make_stringlength(all_regs_t * R);
 static void make_normal_bytes(all_regs_t * R);
+static void chain_search(all_regs_t * R);
 
 /* Store d7.l
  */
@@ -266,6 +269,12 @@ offset_ende:
 
   /* moveq      #1,d4 */
   R->d4 = 1;
+
+  if (R->next) {
+    chain_search(R);
+    BRA(string_suche_fertig);
+  }
+
   /* lea        2(a0),a4 */
   R->a4 = R->a0 + 2;
 
@@ -547,7 +556,83 @@ kleiner:
   put_bits(R);
 }
 
-int unice68_packer(void * dst, int dstsz, const void * src, int srcsz)
+/* Build string search chains.
+ *
+ *   next[i] is the position of the next occurrence of the byte pair
+ *   at position i (-1 if none). The original search compares every
+ *   position in the search range with the first two bytes. Walking
+ *   the chain visits the very same candidates in the very same order
+ *   but skips all the others.
+ */
+static int * chain_build(const uint8_t * src, int len)
+{
+  int * next, * head, i;
+
+  if (len < 2)
+    return 0;
+  next = malloc(sizeof(*next) * len);
+  head = malloc(sizeof(*head) * 0x10000);
+  if (next && head) {
+    for (i = 0; i < 0x10000; ++i)
+      head[i] = -1;
+    next[len-1] = -1;
+    for (i = len-2; i >= 0; --i) {
+      const int key = (src[i] << 8) | src[i+1];
+      next[i]   = head[key];
+      head[key] = i;
+    }
+  } else {
+    free(next);
+    next = 0;
+  }
+  free(head);
+  return next;
+}
+
+/* Search string with the greatest possible length and a small offset.
+ *
+ *   Same result as the original search (section 2 of ice_crunch()):
+ *   the first (smallest offset) of the longest strings starting in
+ *   [a0+2,a3) wins. Matching length is limited by the string itself
+ *   (no overlap), by the search end and by the maximum length $409.
+ *
+ * a0 : current position
+ * a3 : search end
+ * d4 : best length (1:not found)
+ */
+static void chain_search(all_regs_t * R)
+{
+  const uint8_t * const s = R->srcbuf;
+  const int a0 = R->a0 - s, a3 = R->a3 - s;
+  int p, best = 1;
+
+  for (p = R->next[a0]; p >= 0 && p < a3; p = R->next[p]) {
+    int l, lim, d = p - a0;
+
+    if (d < 2)
+      continue;
+    lim = a3 - p - 1;
+    if (lim > d)
+      lim = d;
+    if (lim > 0x409)
+      lim = 0x409;
+    /* Can not be longer or does not match the best length. */
+    if (lim <= best || s[a0+best] != s[p+best])
+      continue;
+    for (l = 2; l < lim && s[a0+l] == s[p+l]; ++l)
+      ;
+    if (l <= best || (l > 2 && d - l + 1 > 0x111f))
+      continue;
+    R->maxlength = best = l;
+    R->maxoffset = d - l + 1;
+    if (best == 0x409)
+      break;
+  }
+  R->d4 = best;
+}
+
+static int ice_pack(void * dst, int dstsz, const void * src, int srcsz,
+                    int ref)
 {
   all_regs_t allregs, *R = &allregs;
 
@@ -574,6 +659,7 @@ int unice68_packer(void * dst, int dstsz, const void * src, int srcsz)
   R->maxlength = 0;
   R->maxgleich = 0;
   R->maxoffset = 0;
+  R->next      = ref ? 0 : chain_build(R->srcbuf, R->srclen);
 
   /***********************************************************************
    * Store header
@@ -606,9 +692,20 @@ int unice68_packer(void * dst, int dstsz, const void * src, int srcsz)
 
   /* Main loop */
   ice_crunch(R);
+  free(R->next);
 
   if (R->error)
     R->d0 = -1;
 
   return R->d0;
 }
+
+int unice68_packer(void * dst, int dstsz, const void * src, int srcsz)
+{
+  return ice_pack(dst, dstsz, src, srcsz, 0);
+}
+
+int unice68_packer_ref(void * dst, int dstsz, const void * src, int srcsz)
+{
+  return ice_pack(dst, dstsz, src, srcsz, 1);
+}
@@ -32,6 +32,7 @@
 #ifdef HAVE_STDINT_H
 # include <stdint.h>
 #endif
+#include <string.h>
 
 typedef uint8_t u8;
 typedef  int8_t s8;
@@ -95,6 +96,7 @@ static void dump_regs(const char * label)
 
 static void strings(all_regs_t *);
 static void normal_bytes(all_regs_t *);
+static void fast_bytes(all_regs_t *);
 static int get_d0_bits(all_regs_t *, int d0);
 
 static inline int chk_dst_range(all_regs_t *R, const areg_t a, const areg_t b)
@@ -139,9 +141,8 @@ static inline int get_1_bit(all_regs_t *R)
   r = (R->d7 & 255) << 1;
   B_CC(r & 255, bitfound);
 
-  chk_src_range(R,R->a5-1,R->a5-1);
-
-  r = (r>>8) + (*(--R->a5) << 1);
+  /* Past the packed data reads zero bits. */
+  r = (r>>8) + (chk_src_range(R,R->a5-1,R->a5-1) ? 0 : *(--R->a5) << 1);
 bitfound:
   R->d7 = (R->d7 & ~0xFF) | (r & 0xFF);
   return r >> 8;
@@ -159,7 +160,7 @@ bitfound:
  *  a4 : depack buffer top, used to detect end of depacking.
  */
 
-static int ice_decrunch(all_regs_t *R)
+static int ice_decrunch(all_regs_t *R, int ref)
 {
   int id;
   int csize;
@@ -195,7 +196,15 @@ static int ice_decrunch(all_regs_t *R)
   R->dstend = R->a3 = R->a6;
 
   R->d7 = *(--R->a5);
-  normal_bytes(R);
+
+  /* The fast depacker expects a valid end of stream marker. */
+  if (ref || csize < 12 || !(R->d7 & 255)) {
+    normal_bytes(R);
+  } else {
+    fast_bytes(R);
+    if (R->overflow)
+      goto not_packed;
+  }
 
 /*      move.l  a3,a6 */
 /*      bsr     get_1_bit */
@@ -232,6 +241,9 @@ static int ice_decrunch(all_regs_t *R)
 ice_00:
   R->d6 = 3;
 ice_01:
+  if (chk_dst_range(R, R->a3-2, R->a3-1)) {
+    goto not_packed;
+  }
   R->a3 -= 2;
   R->d4 = (R->a3[0]<<8) | R->a3[1];
   R->d5 = 3;
@@ -255,7 +267,7 @@ ice_02:
   DBF(R->d5,ice_02);
   DBF(R->d6,ice_01);
 
-  if (chk_src_range(R, R->a3, R->a3+7)) {
+  if (chk_dst_range(R, R->a3, R->a3+7)) {
     goto not_packed;
   }
 
@@ -339,6 +351,8 @@ static void normal_bytes(all_regs_t *R)
       break;
     }
     strings(R);
+    if (R->overflow)
+      break;
   }
 }
 
@@ -370,9 +384,7 @@ hole_bit_loop:
   r7 = (r7 & 255) << 1;
   B_CC(r7 & 255, on_d0);
 
-  chk_src_range(R,R->a5-1,R->a5-1);
-
-  r7 = (*(--R->a5) << 1) + (r7>>8);
+  r7 = (chk_src_range(R,R->a5-1,R->a5-1) ? 0 : *(--R->a5) << 1) + (r7>>8);
 on_d0:
   r1 += r1 + (r7>>8);
   DBF(r0,hole_bit_loop);
@@ -477,13 +489,227 @@ less_40:
 
 depack_bytes:
   R->a1 = R->a6 + 2 + (s16)R->d4 + (s16)R->d1;
-  chk_dst_range(R, R->a6 - DBF_COUNT(R->d4) - 1, R->a6-1);
+  if (chk_dst_range(R, R->a6 - DBF_COUNT(R->d4) - 1, R->a6-1) |
+      chk_dst_range(R, R->a1 - DBF_COUNT(R->d4) - 1, R->a1-1))
+    return;
   if (R->a6>R->a4) *(--R->a6) = *(--R->a1);
 dep_b:
   if (R->a6>R->a4) *(--R->a6) = *(--R->a1);
   DBF(R->d4,dep_b);
 }
 
+/* ----------------------------------------------------------------------
+ * Fast depacker
+ *
+ *  Same as normal_bytes() and strings() above but with a 64-bit bit
+ *  buffer and tables for the length and offset codes.
+ *
+ *  Packed data are read backward. The first byte has an end of stream
+ *  marker (its lowest set bit); all the others have 8 data bits read
+ *  from the msb. Literal bytes are read from the same stream so whole
+ *  bytes read ahead are given back before copying them.
+ * ----------------------------------------------------------------------
+ */
+
+typedef struct {
+  uint64_t bb;                        /* bit buffer (next bit is msb) */
+  int cnt;                            /* valid bits in bb             */
+  int fake;                           /* zero bits past source start  */
+  const u8 * a5;                      /* next packed byte (backward)  */
+  const u8 * lo;                      /* source start                 */
+  int * overflow;
+} bits_t;
+
+typedef struct {
+  u8  used;                             /* code bits    */
+  u8  extra;                            /* value bits   */
+  s16 base;                             /* value offset */
+} code_t;
+
+/* String length indexed by the next 4 bits. */
+static const code_t len_code[16] = {
+  {1,0,0},{1,0,0},{1,0,0},{1,0,0},      /* 0xxx                 */
+  {1,0,0},{1,0,0},{1,0,0},{1,0,0},
+  {2,0,1},{2,0,1},{2,0,1},{2,0,1},      /* 10xx                 */
+  {3,1,2},{3,1,2},                      /* 110x + 1 bit         */
+  {4,2,4},                              /* 1110 + 2 bits        */
+  {4,10,8}                              /* 1111 + 10 bits       */
+};
+
+/* String offset indexed by the next 2 bits. */
+static const code_t off_code[4] = {
+  {1,8,0x1f},{1,8,0x1f},                /* 0x + 8 bits          */
+  {2,5,-1},                             /* 10 + 5 bits          */
+  {2,12,0x11f}                          /* 11 + 12 bits         */
+};
+
+/* 2 bytes string offset indexed by the next bit. */
+static const code_t off2_code[2] = {
+  {1,6,-1}, {1,9,0x3f}
+};
+
+static inline void bits_fill(bits_t * b)
+{
+  while (b->cnt <= 56) {
+    if (b->cnt <= 32 && b->a5 - b->lo >= 4) {
+      const u8 * const p = b->a5 -= 4;
+      const uint32_t v =
+        ((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+      b->bb  |= (uint64_t) v << (32 - b->cnt);
+      b->cnt += 32;
+    } else {
+      uint64_t v = 0;
+      if (b->a5 > b->lo)
+        v = *(--b->a5);
+      else
+        b->fake += 8;
+      b->bb  |= v << (56 - b->cnt);
+      b->cnt += 8;
+    }
+  }
+}
+
+/* Peek 1 to 32 bits. */
+static inline int bits_peek(const bits_t * b, int n)
+{
+  return (int) (b->bb >> (64 - n));
+}
+
+static inline void bits_skip(bits_t * b, int n)
+{
+  b->bb <<= n;
+  b->cnt -= n;
+  if (b->cnt < b->fake) {
+    *b->overflow |= 1 << 2;             /* as chk_src_range() */
+    b->fake = b->cnt;
+  }
+}
+
+static inline int bits_get(bits_t * b, int n)
+{
+  const int v = bits_peek(b, n);
+  bits_skip(b, n);
+  return v;
+}
+
+static inline int bits_code(bits_t * b, const code_t * code, int idxbits)
+{
+  const code_t * const c = code + bits_peek(b, idxbits);
+  const int n = c->used + c->extra;
+  const int v = c->base + (bits_peek(b, n) & ((1 << c->extra) - 1));
+  bits_skip(b, n);
+  return v;
+}
+
+/* Give back whole bytes read ahead. */
+static inline void bits_sync(bits_t * b)
+{
+  int k = b->cnt >> 3, f = b->fake >> 3;
+
+  if (f > k)
+    f = k;
+  b->fake -= f << 3;
+  b->a5   += k - f;
+  b->cnt  &= 7;
+  b->bb   &= b->cnt ? ~(uint64_t)0 << (64 - b->cnt) : 0;
+}
+
+static void fast_bytes(all_regs_t *R)
+{
+  bits_t b;
+  areg_t a6 = R->a6;
+  const areg_t a4 = R->a4;
+  const int d7 = R->d7 & 255, lsb = d7 & -d7;
+  int t;
+
+  /* Data bits of the first byte are above the marker. */
+  b.bb = (uint64_t) (d7 ^ lsb) << 56;
+  for (b.cnt = 7, t = lsb; t > 1; t >>= 1)
+    --b.cnt;
+  b.fake = 0;
+  b.a5 = R->a5;
+  b.lo = R->srcbuf;
+  b.overflow = &R->overflow;
+
+  for (;;) {
+    int d1, d4;
+
+    bits_fill(&b);
+    if (bits_get(&b, 1)) {
+      /* normal_bytes: literal bytes */
+      d1 = 0;
+      if (bits_get(&b, 1)) {
+        const int * tab = direkt_tab + (20>>2);
+        int d3 = 4;
+        do {
+          const int d0 = *(--tab);
+          d1 = bits_get(&b, (d0 & 0xF) + 1);
+          if (d1 != (d0 >> 16))
+            break;
+        } while (--d3 >= 0);
+        d1 += tab[(20>>2)];
+      }
+      d1 = DBF_COUNT(d1);
+      bits_sync(&b);
+      if (chk_dst_range(R, a6-d1, a6-1) |
+          chk_src_range(R, (areg_t)b.a5-d1, (areg_t)b.a5-1))
+        break;
+      if (a6-d1 >= b.a5 || a6 <= b.a5-d1) {
+        a6   -= d1;
+        b.a5 -= d1;
+        memcpy(a6, b.a5, d1);
+      } else {
+        do {
+          *(--a6) = *(--b.a5);
+        } while (--d1);
+      }
+    }
+
+    /* test_if_end */
+    if (a6 <= a4) {
+      if (a6 < a4)
+        chk_dst_range(R, a6, a6);
+      break;
+    }
+
+    /* strings */
+    bits_fill(&b);
+    d4 = bits_code(&b, len_code, 4);
+    if (!d4) {
+      d1 = bits_code(&b, off2_code, 1);
+    } else {
+      d1 = bits_code(&b, off_code, 2);
+      if (d1 < 0)
+        d1 -= d4;
+    }
+
+    /* depack_bytes */
+    {
+      const u8 * a1 = a6 + 2 + d4 + d1;
+      int n = d4 + 2;
+
+      if (chk_dst_range(R, a6 - n, a6-1) |
+          chk_dst_range(R, (areg_t)a1 - n, (areg_t)a1-1))
+        break;
+      if (n > a6 - a4)
+        n = a6 - a4;
+      if (d1 >= 0) {
+        a6 -= n;
+        memcpy(a6, a1 - n, n);
+      } else {
+        while (n--)
+          *(--a6) = *(--a1);
+      }
+    }
+  }
+
+  /* Back to the original registers. */
+  bits_sync(&b);
+  R->a6 = a6;
+  R->a5 = (areg_t) b.a5;
+  R->d7 = (R->d7 & ~0xFF) | (int) (b.bb >> 56) | (0x80 >> b.cnt);
+}
+
 int unice68_depacked_size(const void * buffer, int * p_csize)
 {
   int id, csize, dsize;
@@ -514,7 +740,7 @@ int unice68_depacked_size(const void * buffer, int * p_csize)
   return dsize;
 }
 
-int unice68_depacker(void * dest, const void * src)
+static int ice_depack(void * dest, const void * src, int ref)
 {
   all_regs_t allregs;
 
@@ -538,5 +764,15 @@ int unice68_depacker(void * dest, const void * src)
   allregs.a1 = dest;
   allregs.overflow = 0;
 
-  return ice_decrunch(&allregs);
+  return ice_decrunch(&allregs, ref);
+}
+
+int unice68_depacker(void * dest, const void * src)
+{
+  return ice_depack(dest, src, 0);
+}
+
+int unice68_depacker_ref(void * dest, const void * src)
+{
+  return ice_depack(dest, src, 1);
 }